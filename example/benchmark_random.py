@@ -0,0 +1,35 @@
+import sys
+import time
+
+from linac import Linac, Simulation
+from linac import g4
+
+
+engines = ["ranlux64", "ranlux", "james", "ranecu", "mtwist", "mixmax", "xoshiro"]
+
+numbers = int(1e7)
+histories = int(sys.argv[1]) if len(sys.argv) > 1 else int(1e4)
+
+linac = Linac("machine/example.yaml")
+
+# The same seed for every engine, each runs the same events.
+sim = Simulation("benchmark", linac, seed=1)
+
+# Physics tables are built on the first run, keep them out of the timings.
+sim.beam_on(100)
+
+print "%-10s %16s %16s" % ("engine", "numbers/s", "histories/s")
+
+for engine in engines:
+    rate = g4.BenchmarkRandomEngine(engine, numbers)
+    if rate < 0:
+        print "%-10s %16s %16s" % (engine, "unavailable", "-")
+        continue
+
+    sim.set_random_engine(engine)
+
+    start = time.time()
+    sim.beam_on(histories)
+    elapsed = time.time() - start
+
+    print "%-10s %16.3g %16.3g" % (engine, rate, histories/elapsed)
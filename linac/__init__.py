@@ -1,5 +1,5 @@
-from geometry import Volume, Linac
-from simulation import Simulation
-
+# Before anything imports Geant4, so the run manager can be multithreaded.
 from g4 import ShowGUI
 
+from geometry import Volume, Linac
+from simulation import Simulation
@@ -18,5 +18,7 @@
 
 
 from libg4 import DetectorConstruction, PhysicsList, \
-    PrimaryGeneratorAction, EventAction, SteppingAction, ShowGUI
+    PrimaryGeneratorAction, EventAction, SteppingAction, RunAction, ShowGUI, \
+    MergePhasespaceShards, GetRunManager, IsMultithreaded, GetNumberOfThreads, \
+    SetActionInitialization, SetChunkTime, UseRandomEngine, BenchmarkRandomEngine
 
@@ -0,0 +1,50 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef ActionInitialization_h
+#define ActionInitialization_h 1
+
+#ifdef G4MULTITHREADED
+
+#include "G4VUserActionInitialization.hh"
+
+class PrimaryGeneratorAction;
+
+
+// Builds the user actions of each worker thread. Python only ever sees
+// and configures `primary_generator`, the generators of the workers copy
+// its settings at the start of every run.
+class ActionInitialization : public G4VUserActionInitialization
+{
+  public:
+    ActionInitialization(PrimaryGeneratorAction* primary_generator);
+    virtual ~ActionInitialization();
+
+    virtual void BuildForMaster() const;
+    virtual void Build() const;
+
+  private:
+    PrimaryGeneratorAction* primary_generator;
+};
+
+#endif // G4MULTITHREADED
+
+#endif
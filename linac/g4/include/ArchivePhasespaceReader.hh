@@ -0,0 +1,59 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef ARCHIVEPHASESPACEREADER_HH
+#define ARCHIVEPHASESPACEREADER_HH
+
+#include "PhasespaceReader.hh"
+
+#include "boost/archive/binary_iarchive.hpp"
+
+#include <fstream>
+
+
+// Legacy boost::serialization phasespace files, these can only be
+// streamed front to back.
+class ArchivePhasespaceReader : public PhasespaceReader {
+  public:
+    ArchivePhasespaceReader(G4String filename);
+    virtual ~ArchivePhasespaceReader();
+
+    G4bool Read(PhasespaceRecord& record);
+    G4bool Seek(int64_t index);
+
+    // Only known if the archive has been given a sidecar index.
+    int64_t GetRecordCount() {
+        return phasespace_index ? phasespace_index->GetRecordCount() : -1;
+    };
+
+  private:
+    void Rewind();
+
+  private:
+    G4String filename;
+
+    std::ifstream* input_file_stream;
+    boost::archive::binary_iarchive* phasespace_archive;
+
+    int64_t current_record;
+};
+
+#endif /* ARCHIVEPHASESPACEREADER_HH */
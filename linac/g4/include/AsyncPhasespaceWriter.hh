@@ -0,0 +1,82 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef ASYNCPHASESPACEWRITER_HH
+#define ASYNCPHASESPACEWRITER_HH
+
+#include "PhasespaceWriter.hh"
+
+#include "boost/thread.hpp"
+
+#include <sys/types.h>
+
+#include <deque>
+#include <vector>
+
+
+// Collects records into blocks on the tracking thread and hands full
+// blocks to a background thread that passes them on to `writer`. At most
+// queue_depth + 1 blocks exist at once, so when the disk falls behind
+// tracking waits for a free block rather than growing without bound.
+// The records still queued in a copy inherited by a forked child are the
+// parent's to write, in the child it is only closed or deleted, which
+// leaves the file alone.
+class AsyncPhasespaceWriter : public PhasespaceWriter {
+  public:
+    AsyncPhasespaceWriter(PhasespaceWriter* writer,
+            G4int block_size=65536, G4int queue_depth=1);
+    virtual ~AsyncPhasespaceWriter();
+
+    void Write(const PhasespaceRecord& record);
+    void Close();
+
+    void SetOriginalHistories(int64_t histories) {
+        writer->SetOriginalHistories(histories);
+    };
+
+    int64_t GetRecordCount() {
+        return record_count;
+    };
+
+  private:
+    void Submit();
+    void Run();
+
+  private:
+    PhasespaceWriter* writer;
+
+    G4int block_size;
+    std::vector<PhasespaceRecord>* current_block;
+    std::deque<std::vector<PhasespaceRecord>*> free_blocks;
+    std::deque<std::vector<PhasespaceRecord>*> full_blocks;
+
+    boost::thread writer_thread;
+    pid_t owner;
+    boost::mutex mutex;
+    boost::condition_variable block_full;
+    boost::condition_variable block_free;
+
+    G4bool closing;
+    G4bool closed;
+    int64_t record_count;
+};
+
+#endif /* ASYNCPHASESPACEWRITER_HH */
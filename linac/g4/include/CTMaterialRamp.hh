@@ -0,0 +1,51 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef CTMATERIALRAMP_HH
+#define CTMATERIALRAMP_HH
+
+#include "globals.hh"
+#include "G4Material.hh"
+
+#include <stdint.h>
+#include <map>
+
+
+// The material of each CT number: clipped to [lower, upper], rounded
+// down to a multiple of `rounding`, then the closest point of the ramp
+// at or below. Particles are transported through, and dose divided by
+// the mass of, whatever this gives, so the two cannot disagree.
+class CTMaterialRamp {
+  public:
+    CTMaterialRamp(const std::map<int16_t, G4Material*>& materials,
+            G4int rounding, G4int lower, G4int upper);
+
+    G4int Round(G4int value) const;
+    G4Material* GetMaterial(G4int value) const;
+
+  private:
+    std::map<int16_t, G4Material*> materials;
+    G4int rounding;
+    G4int lower;
+    G4int upper;
+};
+
+#endif /* CTMATERIALRAMP_HH */
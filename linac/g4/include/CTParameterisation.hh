@@ -0,0 +1,52 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef CTPARAMETERISATION_HH
+#define CTPARAMETERISATION_HH
+
+#include "CTMaterialRamp.hh"
+
+#include "G4VoxelArray.hh"
+#include "G4VoxelDataParameterisation.hh"
+
+
+// The CT voxels, with each voxel's material taken from `ramp` instead of
+// the lookup inside G4VoxelDataParameterisation, so the voxel masses used
+// for scoring come from the very same lookup.
+class CTParameterisation : public G4VoxelDataParameterisation<int16_t> {
+  public:
+    CTParameterisation(G4VoxelArray<int16_t>* array,
+            std::map<int16_t, G4Material*> materials,
+            G4VPhysicalVolume* mother, const CTMaterialRamp& ramp);
+
+    G4Material* ComputeMaterial(G4VPhysicalVolume* volume, const G4int copy,
+            const G4VTouchable* parent=0);
+
+    const CTMaterialRamp& GetRamp() {
+        return ramp;
+    };
+
+  private:
+    G4VoxelArray<int16_t>* array;
+    CTMaterialRamp ramp;
+};
+
+#endif /* CTPARAMETERISATION_HH */
@@ -0,0 +1,85 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef COMPRESSEDPHASESPACEREADER_HH
+#define COMPRESSEDPHASESPACEREADER_HH
+
+#include "PhasespaceReader.hh"
+#include "PhasespaceFormat.hh"
+#include "PhasespaceBlockCodec.hh"
+
+#include <fstream>
+#include <vector>
+
+
+class CompressedPhasespaceReader : public PhasespaceReader {
+  public:
+    CompressedPhasespaceReader(G4String filename);
+    virtual ~CompressedPhasespaceReader();
+
+    G4bool Read(PhasespaceRecord& record);
+    G4bool Seek(int64_t index);
+
+    int64_t GetRecordCount() {
+        return header.record_count;
+    };
+
+    G4int GetNumberOfBlocks() {
+        return block_index.size();
+    };
+
+    const CompressedBlockIndex& GetBlockIndex(G4int block) {
+        return block_index[block];
+    };
+
+    const PhasespaceHeader& GetHeader() {
+        return header;
+    };
+
+    const CompressedPhasespaceHeader& GetCompressedHeader() {
+        return compressed_header;
+    };
+
+    // Decode one block, opens its own stream so several threads can
+    // each work through different blocks of the same file.
+    G4bool ReadBlock(G4int block, std::vector<PackedPhasespaceRecord>& records);
+
+    // A record from ReadBlock in GEANT4 units.
+    PhasespaceRecord Unpack(const PackedPhasespaceRecord& packed);
+
+  private:
+    G4bool LoadBlock(G4int block);
+
+  private:
+    G4String filename;
+
+    PhasespaceHeader header;
+    CompressedPhasespaceHeader compressed_header;
+    std::vector<CompressedBlockIndex> block_index;
+
+    PhasespaceBlockCodec* codec;
+
+    std::vector<PackedPhasespaceRecord> current_records;
+    G4int current_block;
+    G4int position_in_block;
+};
+
+#endif /* COMPRESSEDPHASESPACEREADER_HH */
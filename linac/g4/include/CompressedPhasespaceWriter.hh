@@ -0,0 +1,75 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef COMPRESSEDPHASESPACEWRITER_HH
+#define COMPRESSEDPHASESPACEWRITER_HH
+
+#include "PhasespaceWriter.hh"
+#include "PhasespaceFormat.hh"
+#include "PhasespaceBlockCodec.hh"
+
+#include "G4Timer.hh"
+
+#include <fstream>
+#include <vector>
+
+
+// Writes records in blocks of `block_size`, each compressed on its own
+// and listed in an index at the end of the file. A step of zero keeps
+// that field exactly.
+class CompressedPhasespaceWriter : public PhasespaceWriter {
+  public:
+    CompressedPhasespaceWriter(G4String filename, G4int level=3, G4bool delta=true,
+            G4double position_step=0, G4double direction_step=0, G4double energy_step=0,
+            G4int block_size=65536);
+    virtual ~CompressedPhasespaceWriter();
+
+    void Write(const PhasespaceRecord& record);
+    void WriteBlock(const std::vector<PhasespaceRecord>& block);
+    void Close();
+
+    int64_t GetRecordCount() {
+        return header.record_count + packed_block.size();
+    };
+
+  private:
+    void WriteHeader();
+    void FlushBlock();
+
+  private:
+    G4String filename;
+    std::ofstream* output_file_stream;
+
+    PhasespaceHeader header;
+    CompressedPhasespaceHeader compressed_header;
+    std::vector<CompressedBlockIndex> index;
+
+    PhasespaceBlockCodec* codec;
+    G4int block_size;
+    std::vector<PackedPhasespaceRecord> packed_block;
+    std::vector<char> compressed_block;
+
+    uint64_t offset;
+    G4Timer timer;
+    G4double encode_time;
+};
+
+#endif /* COMPRESSEDPHASESPACEWRITER_HH */
@@ -50,11 +50,15 @@
 #include "G4VoxelData.hh"
 #include "G4VoxelArray.hh"
 #include "G4VoxelDataParameterisation.hh"
+#include "CTParameterisation.hh"
 #include "DicomDataIO.hh"
 #include "NumpyDataIO.hh"
 
 // BOOST/PYTHON //
 #include "boost/python.hpp"
+#include "boost/thread.hpp"
+
+#include <ctime>
 //#include "pyublas/numpy.hpp"
 
 
@@ -81,12 +85,24 @@ class DetectorConstruction : public G4VUserDetectorConstruction
     ~DetectorConstruction();
 
     G4VPhysicalVolume* Construct();
+#ifdef G4MULTITHREADED
+    // Gives each worker thread a detector of its own on the volumes the
+    // master detector is attached to, scoring into the master histograms.
+    void ConstructSDandField();
+
+    // Remake the detector of the calling worker if the master detector
+    // changed since, and attach it to the current volumes. Called by
+    // each worker before every run.
+    void AttachWorkerDetector();
+#endif
   
   public:
     G4VPhysicalVolume* FindVolume(G4String name, G4VPhysicalVolume * mother); 
     
     void AddMaterial(G4String name, G4double density, boost::python::object move);
 
+    SensitiveDetector* MakeDetector(G4String name);
+
     void SetupPhantom();
     void SetupCADPhantom(char* filename, G4ThreeVector offset);
 
@@ -147,6 +163,12 @@ class DetectorConstruction : public G4VUserDetectorConstruction
         }
     
         phasespaces.clear();
+
+        // The phasespaces in use are owned by the parallel world.
+        if (GetNumberOfParallelWorld() == 1) {
+            ParallelDetectorConstruction* pw = (ParallelDetectorConstruction*) GetParallelWorld(0);
+            pw->ClosePhasespaces();
+        }
     };
 
     void UsePhantom(G4bool use) {
@@ -222,24 +244,164 @@ class DetectorConstruction : public G4VUserDetectorConstruction
         this->array->Crop(xmin, xmax, ymin, ymax, zmin, zmax);
     }
 
-    pyublas::numpy_vector<float> GetEnergyHistogram() {
+    pyublas::numpy_vector<G4double> GetEnergyHistogram() {
         return detector->GetEnergyHistogram();
     }
 
-    pyublas::numpy_vector<float> GetEnergySqHistogram() {
+    pyublas::numpy_vector<G4double> GetEnergySqHistogram() {
         return detector->GetEnergySqHistogram();
     }
 
-    pyublas::numpy_vector<float> GetCountsHistogram() {
+    pyublas::numpy_vector<G4double> GetCountsHistogram() {
         return detector->GetCountsHistogram();
     }
 
+    // Relative standard error of the dose in each voxel, from the
+    // history by history energy squared.
+    pyublas::numpy_vector<G4double> GetUncertaintyHistogram() {
+        return detector->GetUncertaintyHistogram();
+    }
+
+    // Mean relative uncertainty of the voxels above `threshold` times
+    // the maximum dose, what an automatic stop looks at between runs.
+    G4double GetRegionUncertainty(G4double threshold) {
+        return detector->GetRegionUncertainty(threshold);
+    }
+
+    // The scored voxels only, as flat indices into the histograms with
+    // their energy, energy squared and counts.
+    boost::python::tuple GetSparseHistograms() {
+        return detector->GetSparseHistograms();
+    }
+
+    int64_t GetHistories() {
+        return detector->GetDoseGrid()->GetHistories();
+    }
+
+    // What the detector scores, see SensitiveDetector::Create. Must be set
+    // before the phantom or CT is set up.
+    void SetScoringQuantity(G4String quantity) {
+        this->scoring_quantity = quantity;
+    }
+
+    G4int GetHistogramCount() {
+        return detector->GetHistogramCount();
+    }
+
+    G4String GetHistogramName(G4int i) {
+        return detector->GetHistogramName(i);
+    }
+
+    pyublas::numpy_vector<G4double> GetHistogram(G4int i) {
+        return detector->GetHistogram(i);
+    }
+
+    DoseGrid* GetDoseGrid(G4int i) {
+        return detector->dose_grids[i];
+    }
+
+    // Mass energy absorption coefficients against photon energy, for
+    // scoring kerma.
+    void SetMassEnergyAbsorption(pyublas::numpy_vector<G4double> energies,
+            pyublas::numpy_vector<G4double> coefficients) {
+        absorption_energies.assign(energies.begin(), energies.end());
+        absorption_coefficients.assign(coefficients.begin(), coefficients.end());
+
+        if (detector)
+            detector->SetMassEnergyAbsorption(absorption_energies, absorption_coefficients);
+    }
+
+    // Score only the voxels with a non zero label in `labels`, a uint8
+    // volume shaped like the CT or phantom grid, see
+    // SensitiveDetector::SetScoringMask. Must be set before the first event.
+    void SetScoringMask(pyublas::numpy_vector<uint8_t> labels) {
+        scoring_mask.assign(labels.begin(), labels.end());
+
+        if (detector)
+            detector->SetScoringMask(scoring_mask);
+    }
+
+    // Labels of the structures GetDoseStatistics looks at, a uint8 volume
+    // shaped like the grid. Without any, the labels of the scoring mask.
+    void SetStructures(pyublas::numpy_vector<uint8_t> labels) {
+        structures.assign(labels.begin(), labels.end());
+    }
+
+    // Dose volume histograms and statistics of the structure labelled
+    // `label`, computed from the histograms with a thread per core: the
+    // voxel count and volume, mean, minimum and maximum dose, `bins` bin
+    // edges up to `maximum` (zero for the largest dose) with the
+    // differential and cumulative histograms, the dose to each fraction
+    // in `volumes` as "D" and the fraction getting each of `doses` as "V".
+    boost::python::dict GetDoseStatistics(G4int label, G4int bins, G4double maximum,
+            pyublas::numpy_vector<G4double> volumes, pyublas::numpy_vector<G4double> doses);
+
     void ZeroHistograms() {
-        std::fill(detector->energy_histogram.begin(), detector->energy_histogram.end(), 0.0);
-        std::fill(detector->energysq_histogram.begin(), detector->energysq_histogram.end(), 0.0);
-        std::fill(detector->counts_histogram.begin(), detector->counts_histogram.end(), 0.0);
+        if (detector)
+            detector->Zero();
+
+        if (GetNumberOfParallelWorld() == 1) {
+            ParallelDetectorConstruction* pw = (ParallelDetectorConstruction*) GetParallelWorld(0);
+            pw->ZeroScoringMeshes();
+        }
+    }
+
+    // Sum what each worker has scored into the histograms, called at the
+    // end of every run unless turned off with SetReduceEachRun.
+    void ReduceHistograms() {
+        if (detector)
+            detector->Reduce();
+
+        if (GetNumberOfParallelWorld() == 1) {
+            ParallelDetectorConstruction* pw = (ParallelDetectorConstruction*) GetParallelWorld(0);
+            pw->ReduceScoringMeshes();
+        }
     }
 
+    // Whether the end of every run sums the histograms. Off for many short
+    // runs whose dose is only read once they are all done, which must then
+    // call ReduceHistograms themselves.
+    void SetReduceEachRun(G4bool reduce) {
+        this->reduce_each_run = reduce;
+    }
+
+    G4bool GetReduceEachRun() {
+        return this->reduce_each_run;
+    }
+
+    // Have every worker add into the one set of histograms atomically,
+    // rather than keep its own copy until the end of the run.
+    void SetAtomicScoring(G4bool atomic) {
+        this->atomic_scoring = atomic;
+        if (detector)
+            detector->SetAtomic(atomic);
+    }
+
+    // Keep the histograms in 8x8x8 bricks allocated as dose arrives, for
+    // grids too large to hold densely.
+    void SetTiledScoring(G4bool tiled) {
+        this->tiled_scoring = tiled;
+        if (detector)
+            detector->SetTiled(tiled);
+    }
+
+    // Keep the histograms in memory mapped .npy files starting with
+    // `prefix`, brought up to date every `events` events or `seconds`
+    // seconds, whichever comes first, and at the end of every run. Zero
+    // for either turns that trigger off. Files already there from the
+    // same grid are carried on from.
+    void SetCheckpoint(G4String prefix, G4int events, G4double seconds) {
+        this->checkpoint_prefix = prefix;
+        this->checkpoint_events = events;
+        this->checkpoint_seconds = seconds;
+        this->last_checkpoint = std::time(NULL);
+
+        if (detector)
+            detector->SetCheckpoint(prefix);
+    }
+
+    void CheckpointIfDue();
+
     void SetVerbosity(G4int verbose) {
         this->verbose = verbose;
     }
@@ -265,6 +427,71 @@ class DetectorConstruction : public G4VUserDetectorConstruction
         return 0;
     }
 
+    void SetPhasespaceCompression(char* name, G4int level, G4bool delta,
+            G4double position_step, G4double direction_step, G4double energy_step) {
+        if (GetNumberOfParallelWorld() == 1) {
+            ParallelDetectorConstruction* pw = (ParallelDetectorConstruction*) GetParallelWorld(0);
+            Phasespace* phasespace = pw->GetPhasespace(name);
+            if (phasespace)
+                phasespace->SetCompression(level, delta, position_step, direction_step, energy_step);
+        }
+    }
+
+    // Write the phasespace to shard `shard` of its file, for runs split
+    // over several processes.
+    void SetPhasespaceShard(char* name, G4int shard) {
+        if (GetNumberOfParallelWorld() == 1) {
+            ParallelDetectorConstruction* pw = (ParallelDetectorConstruction*) GetParallelWorld(0);
+            Phasespace* phasespace = pw->GetPhasespace(name);
+            if (phasespace)
+                phasespace->SetShard(shard);
+        }
+    }
+
+    // A tally of its own, independent of the phantom or CT. The shape is
+    // "box" or "cylinder", the quantity "dose" or "energy".
+    G4VPhysicalVolume* AddScoringMesh(char* name, G4String shape, G4ThreeVector size,
+            G4int x_bins, G4int y_bins, G4int z_bins,
+            G4ThreeVector translation, G4ThreeVector rotation, G4String quantity) {
+        if (GetNumberOfParallelWorld() == 1) {
+            ParallelDetectorConstruction* pw = (ParallelDetectorConstruction*) GetParallelWorld(0);
+
+            ScoringMesh::Shape mesh_shape = ScoringMesh::kBox;
+            if (shape == "cylinder")
+                mesh_shape = ScoringMesh::kCylinder;
+
+            G4VPhysicalVolume* physical = pw->AddScoringMesh(name, mesh_shape, size,
+                    x_bins, y_bins, z_bins, translation, rotation);
+            if (physical == NULL)
+                return 0;
+
+            ScoringMesh* mesh = pw->GetScoringMesh(name);
+            mesh->GetDoseGrid()->SetAtomic(atomic_scoring);
+            if (quantity == "energy")
+                mesh->SetQuantity(ScoringMesh::kEnergyDeposit);
+
+            return physical;
+        }
+
+        return 0;
+    }
+
+    ScoringMesh* GetScoringMesh(char* name) {
+        if (GetNumberOfParallelWorld() == 1) {
+            ParallelDetectorConstruction* pw = (ParallelDetectorConstruction*) GetParallelWorld(0);
+            return pw->GetScoringMesh(name);
+        }
+
+        return NULL;
+    }
+
+    void RemoveScoringMesh(char* name) {
+        if (GetNumberOfParallelWorld() == 1) {
+            ParallelDetectorConstruction* pw = (ParallelDetectorConstruction*) GetParallelWorld(0);
+            pw->RemoveScoringMesh(name);
+        }
+    }
+
     void RemovePhasespace(char* name) {
         if (GetNumberOfParallelWorld() == 1) {
             ParallelDetectorConstruction* pw = (ParallelDetectorConstruction*) GetParallelWorld(0);
@@ -289,6 +516,22 @@ class DetectorConstruction : public G4VUserDetectorConstruction
     G4VPhysicalVolume* phantom_physical;
 
     SensitiveDetector* detector;
+    std::vector<G4LogicalVolume*> detector_volumes;
+    G4bool atomic_scoring;
+    G4bool tiled_scoring;
+    G4bool reduce_each_run;
+    G4String scoring_quantity;
+    std::vector<uint8_t> scoring_mask;
+    std::vector<uint8_t> structures;
+
+    G4String checkpoint_prefix;
+    G4int checkpoint_events;
+    G4double checkpoint_seconds;
+    G4int events_since_checkpoint;
+    std::time_t last_checkpoint;
+    boost::mutex checkpoint_mutex;
+    std::vector<G4double> absorption_energies;
+    std::vector<G4double> absorption_coefficients;
     //Phasespace* phasespace_sensitive_detector;
     std::vector<Phasespace*> phasespaces;
 
@@ -332,10 +575,16 @@ class DetectorConstruction : public G4VUserDetectorConstruction
 
     G4VoxelData* data;
     G4VoxelArray<int16_t>* array;
-    G4VoxelDataParameterisation<int16_t>* voxeldata_param;
+    CTParameterisation* voxeldata_param;
     std::map<int16_t, G4Material*> materials;
     std::vector<Hounsfield> hounsfield;
 
+    // How CT numbers are rounded and clipped before looking up their
+    // material, see CTMaterialRamp.
+    G4int ct_rounding;
+    G4int ct_lower;
+    G4int ct_upper;
+
     G4int verbose;
 };
 
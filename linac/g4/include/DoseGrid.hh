@@ -0,0 +1,408 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef DOSEGRID_HH
+#define DOSEGRID_HH
+
+#include "MappedHistogram.hh"
+
+#include "globals.hh"
+
+#include "boost/thread.hpp"
+#include "boost/unordered_map.hpp"
+#include "boost/python.hpp"
+#include "pyublas/numpy.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+
+
+// An 8x8x8 block of voxels of a tiled grid, with everything scored in
+// them kept together. Only the sums the grid keeps are allocated, the
+// others are NULL.
+struct DoseBrick {
+    DoseBrick(G4bool with_energysq, G4bool with_counts, G4bool with_history) {
+        energy = new G4double[512];
+        energysq = with_energysq ? new G4double[512] : NULL;
+        counts = with_counts ? new G4double[512] : NULL;
+        history_energy = with_history ? new G4double[512] : NULL;
+        last_history = with_history ? new int64_t[512] : NULL;
+
+        std::fill(energy, energy + 512, 0.0);
+        if (energysq)
+            std::fill(energysq, energysq + 512, 0.0);
+        if (counts)
+            std::fill(counts, counts + 512, 0.0);
+        if (history_energy) {
+            std::fill(history_energy, history_energy + 512, 0.0);
+            std::fill(last_history, last_history + 512, -1);
+        }
+    };
+
+    ~DoseBrick() {
+        delete [] energy;
+        delete [] energysq;
+        delete [] counts;
+        delete [] history_energy;
+        delete [] last_history;
+    };
+
+    G4double* energy;
+    G4double* energysq;
+    G4double* counts;
+    G4double* history_energy;
+    int64_t* last_history;
+
+  private:
+    DoseBrick(const DoseBrick&);
+    DoseBrick& operator=(const DoseBrick&);
+};
+
+
+// Where one worker accumulates its hits.
+struct DoseGridBuffer {
+    // Sums over histories of the dose, the squared dose of each history,
+    // and the track weight.
+    G4double* energy;
+    G4double* energysq;
+    G4double* counts;
+
+    // With a tiled grid, the sums live in bricks instead, NULL until a
+    // voxel in the brick is first touched.
+    DoseBrick** bricks;
+
+    // False if the sums are the master histograms themselves.
+    G4bool owned;
+
+    // The dose of the last history to touch each voxel, squared and
+    // added to `energysq` only once a later history touches the voxel,
+    // so finishing a history costs nothing.
+    G4double* history_energy;
+    int64_t* last_history;
+
+    // With atomic scoring, the voxels touched by the current history.
+    boost::unordered_map<G4int, G4double> touched;
+
+    int64_t history;
+    int64_t histories;
+};
+
+
+// The energy, energy squared and counts histograms for one scoring
+// volume. Each worker gets its own buffer to score into without locks,
+// the buffers are summed into the master histograms at the end of run.
+// Energy squared is accumulated history by history, so the histograms
+// give the statistical uncertainty of the dose in each voxel directly.
+//
+// A tiled grid only allocates the 8x8x8 bricks that see dose, so large
+// grids cost memory in proportion to the irradiated volume. It is made
+// dense only when the histograms are asked for.
+//
+// Energy squared and counts can be left out when they are not wanted,
+// the grid then never allocates or touches them.
+class DoseGrid {
+  public:
+    DoseGrid(G4int x_dim, G4int y_dim, G4int z_dim, G4bool tiled=false,
+            G4bool energysq=true, G4bool counts=true);
+    ~DoseGrid();
+
+    // Called once by every worker, before its first hit.
+    DoseGridBuffer* GetLocalBuffer();
+
+    // Where voxel x, y, z is kept, for passing to `Add`.
+    G4int GetIndex(G4int x, G4int y, G4int z) {
+        if (!tiled)
+            return (x*y_dim + y)*z_dim + z;
+
+        G4int brick = ((x >> 3)*y_bricks + (y >> 3))*z_bricks + (z >> 3);
+        return (brick << 9) | ((x & 7) << 6) | ((y & 7) << 3) | (z & 7);
+    };
+
+    void BeginHistory(DoseGridBuffer* buffer) {
+        buffer->history++;
+        buffer->histories++;
+    };
+
+    void Add(DoseGridBuffer* buffer, G4int index, G4double energy, G4double counts) {
+        Add<true, true>(buffer, index, energy, counts);
+    };
+
+    // Add with only the sums the grid was made with compiled in.
+    template <G4bool with_energysq, G4bool with_counts>
+    void Add(DoseGridBuffer* buffer, G4int index, G4double energy, G4double counts) {
+        if (atomic) {
+            if (with_energysq)
+                buffer->touched[index] += energy;
+            else
+                AtomicAdd(EnergyAt(buffer, index), energy);
+
+            if (with_counts)
+                AtomicAdd(CountsAt(buffer, index), counts);
+            return;
+        }
+
+        if (tiled) {
+            DoseBrick* brick = BrickAt(buffer, index);
+
+            Accumulate<with_energysq, with_counts>(buffer, brick->energy,
+                    brick->energysq, brick->counts, brick->history_energy,
+                    brick->last_history, index & 511, energy, counts);
+        } else {
+            Accumulate<with_energysq, with_counts>(buffer, buffer->energy,
+                    buffer->energysq, buffer->counts, buffer->history_energy,
+                    buffer->last_history, index, energy, counts);
+        }
+    };
+
+    void EndHistory(DoseGridBuffer* buffer);
+
+    // Sum every worker buffer into the master histograms and clear them,
+    // spread over `threads` threads, zero for one per core.
+    void Reduce(G4int threads=0);
+    void Zero();
+
+    // Add histograms shaped like those from GetEnergy, GetEnergySq and
+    // GetCounts, and the histories behind them, to the master histograms.
+    // For summing grids scored in other processes.
+    void Merge(pyublas::numpy_vector<G4double> energy,
+            pyublas::numpy_vector<G4double> energysq,
+            pyublas::numpy_vector<G4double> counts, int64_t histories);
+
+    // The master histograms, dense and shaped like the grid. A tiled grid
+    // is copied out into new arrays on every call.
+    pyublas::numpy_vector<G4double> GetEnergy();
+    pyublas::numpy_vector<G4double> GetEnergySq();
+    pyublas::numpy_vector<G4double> GetCounts();
+
+    // The master sum at `index` from GetIndex, zero in a brick that was
+    // never scored in. Read only, safe to call from many threads between
+    // runs.
+    G4double GetEnergyAt(G4int index) {
+        if (!tiled)
+            return master.energy[index];
+
+        DoseBrick* brick = master.bricks[index >> 9];
+        return brick ? brick->energy[index & 511] : 0;
+    };
+
+    // Relative standard error of the mean dose in each voxel.
+    pyublas::numpy_vector<G4double> GetUncertainty();
+
+    // Mean relative standard error over the scored voxels with at least
+    // `threshold` times the largest dose, read straight from the master
+    // histograms. Negative if energy squared is not kept or nothing has
+    // been scored yet.
+    G4double GetRegionUncertainty(G4double threshold);
+
+    // Only the voxels that were scored in, in coordinate form: a tuple of
+    // the flat index of each voxel in the dense histograms, followed by
+    // its energy, energy squared and counts.
+    boost::python::tuple GetSparse();
+
+    // Score every worker straight into the master histograms with atomic
+    // adds instead of keeping a copy of the grid per worker. Must be set
+    // before any worker asks for its buffer.
+    void SetAtomic(G4bool atomic) {
+        this->atomic = atomic;
+    };
+
+    G4bool IsAtomic() {
+        return atomic;
+    };
+
+    // Switch between dense and tiled storage, dropping anything scored.
+    // Must be set before any worker asks for its buffer.
+    void SetTiled(G4bool tiled);
+
+    G4bool IsTiled() {
+        return tiled;
+    };
+
+    G4bool HasEnergySq() {
+        return keep_energysq;
+    };
+
+    G4bool HasCounts() {
+        return keep_counts;
+    };
+
+    G4int GetSize() {
+        return size;
+    };
+
+    int64_t GetHistories() {
+        return histories;
+    };
+
+    // Number of bricks allocated for the master histograms.
+    G4int GetBrickCount();
+
+    // Keep the master histograms in `<prefix>_energy.npy`, `_energy2.npy`,
+    // `_counts.npy` and the number of histories in `_histories.npy`,
+    // mapped into memory. Files left by an earlier run of the same grid
+    // are carried on from. Dense grids only, before the first event.
+    G4bool Map(G4String prefix);
+
+    G4bool IsMapped() {
+        return mapped_energy != NULL;
+    };
+
+    // Bring the mapped files up to date with everything scored so far,
+    // called between events. Worker buffers are reduced first, unless
+    // scoring is atomic and the master histograms are always current.
+    void Checkpoint();
+
+  private:
+    static G4double RelativeError(G4double sum, G4double sumsq, G4double n) {
+        if (sum <= 0 || n < 2)
+            return 0;
+
+        // Variance of the mean from the per-history sums.
+        G4double mean = sum / n;
+        G4double variance = (sumsq/n - mean*mean) / (n - 1);
+
+        return variance > 0 ? std::sqrt(variance) / mean : 0;
+    };
+
+    void Allocate();
+    void Free();
+
+    // Zero, with the mutex already held.
+    void ZeroLocked();
+
+    void ReduceBlocks(G4int first, G4int stride);
+    void ReduceBricks(G4int first, G4int stride);
+
+    pyublas::numpy_vector<G4double> Densify(G4double* DoseBrick::* field);
+
+    // A zeroed brick put in place in `buffer`. Bricks only ever reduced
+    // into need no per history sums.
+    DoseBrick* NewBrick(DoseGridBuffer* buffer, G4int brick, G4bool scored=true);
+
+    // Whether voxel `j` of brick `brick` is inside the grid, the bricks
+    // along the far sides hang over its edges.
+    G4bool InGrid(G4int brick, G4int j) {
+        return (brick / (y_bricks*z_bricks))*8 + (j >> 6) < x_dim
+            && ((brick / z_bricks) % y_bricks)*8 + ((j >> 3) & 7) < y_dim
+            && (brick % z_bricks)*8 + (j & 7) < z_dim;
+    };
+
+    DoseBrick* BrickAt(DoseGridBuffer* buffer, G4int index) {
+        DoseBrick* brick = buffer->bricks[index >> 9];
+        if (brick == NULL)
+            brick = NewBrick(buffer, index >> 9);
+        return brick;
+    };
+
+    G4double* EnergyAt(DoseGridBuffer* buffer, G4int index) {
+        if (!tiled)
+            return buffer->energy + index;
+        return BrickAt(buffer, index)->energy + (index & 511);
+    };
+
+    G4double* EnergySqAt(DoseGridBuffer* buffer, G4int index) {
+        if (!tiled)
+            return buffer->energysq + index;
+        return BrickAt(buffer, index)->energysq + (index & 511);
+    };
+
+    G4double* CountsAt(DoseGridBuffer* buffer, G4int index) {
+        if (!tiled)
+            return buffer->counts + index;
+        return BrickAt(buffer, index)->counts + (index & 511);
+    };
+
+    template <G4bool with_energysq, G4bool with_counts>
+    static void Accumulate(DoseGridBuffer* buffer, G4double* energy,
+            G4double* energysq, G4double* counts, G4double* history_energy,
+            int64_t* last_history, G4int i, G4double value, G4double weight) {
+        if (with_energysq) {
+            if (last_history[i] != buffer->history) {
+                energysq[i] += history_energy[i]*history_energy[i];
+                history_energy[i] = 0;
+                last_history[i] = buffer->history;
+            }
+            history_energy[i] += value;
+        }
+
+        energy[i] += value;
+
+        if (with_counts)
+            counts[i] += weight;
+    };
+
+    pyublas::numpy_vector<G4double> Zeros();
+    pyublas::numpy_vector<G4double> Copy(G4double* histogram);
+    void Sync();
+
+    static void AtomicAdd(G4double* target, G4double value) {
+        volatile int64_t* bits = (volatile int64_t*) target;
+        union { G4double d; int64_t i; } old_value, new_value;
+
+        old_value.i = *bits;
+        while (true) {
+            new_value.d = old_value.d + value;
+
+            int64_t seen = __sync_val_compare_and_swap(bits, old_value.i, new_value.i);
+            if (seen == old_value.i)
+                return;
+            old_value.i = seen;
+        }
+    };
+
+  public:
+    // Dense grids only, empty when tiled or not kept.
+    pyublas::numpy_vector<G4double> energy_histogram;
+    pyublas::numpy_vector<G4double> energysq_histogram;
+    pyublas::numpy_vector<G4double> counts_histogram;
+
+  private:
+    G4int x_dim;
+    G4int y_dim;
+    G4int z_dim;
+    G4int size;
+    G4int block_size;
+    G4bool atomic;
+
+    G4bool keep_energysq;
+    G4bool keep_counts;
+
+    G4bool tiled;
+    G4int x_bricks;
+    G4int y_bricks;
+    G4int z_bricks;
+    G4int brick_count;
+
+    int64_t histories;
+
+    MappedHistogram* mapped_energy;
+    MappedHistogram* mapped_energysq;
+    MappedHistogram* mapped_counts;
+    MappedHistogram* mapped_histories;
+
+    DoseGridBuffer master;
+    std::vector<DoseGridBuffer*> buffers;
+    boost::mutex mutex;
+};
+
+#endif /* DOSEGRID_HH */
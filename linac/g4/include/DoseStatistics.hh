@@ -0,0 +1,89 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef DOSESTATISTICS_HH
+#define DOSESTATISTICS_HH
+
+#include "globals.hh"
+
+#include "pyublas/numpy.hpp"
+
+#include <stdint.h>
+#include <vector>
+
+class SensitiveDetector;
+
+
+// The dose of one labelled structure gathered from the histograms of a
+// detector, for dose volume histograms and summary statistics. Doses are
+// in the units of the histograms, volumes are fractions of the structure.
+class DoseStatistics {
+  public:
+    // Every voxel of `detector` labelled `label` in `labels`, a volume
+    // shaped like its grid, read with `threads` threads, zero for one per
+    // core. Without labels the whole grid is the structure. Voxels outside
+    // the scoring mask of the detector were never scored, and are left out.
+    // Throws std::invalid_argument if the detector does not score dose or
+    // the labels are not shaped like its grid.
+    DoseStatistics(SensitiveDetector* detector, const std::vector<uint8_t>& labels,
+            G4int label, G4int threads=0);
+
+    G4int GetVoxelCount() {
+        return doses.size();
+    };
+
+    G4double GetMean();
+    G4double GetMinimum();
+    G4double GetMaximum();
+
+    // Fraction of the structure in each of `bins` bins from zero to
+    // `maximum`, the largest dose in the structure if not positive. Doses
+    // above `maximum` go into the last bin.
+    pyublas::numpy_vector<G4double> GetDifferential(G4int bins, G4double maximum);
+
+    // Fraction of the structure getting at least the lower edge of each
+    // bin of the differential histogram.
+    pyublas::numpy_vector<G4double> GetCumulative(G4int bins, G4double maximum);
+
+    // The smallest dose to the hottest `volume` fraction of the structure,
+    // D98 is GetDose(0.98).
+    G4double GetDose(G4double volume);
+
+    // Fraction of the structure getting at least `dose`.
+    G4double GetVolume(G4double dose);
+
+  private:
+    void Gather(G4int first, G4int stride, std::vector<G4double>* part);
+
+    SensitiveDetector* detector;
+    const std::vector<uint8_t>& labels;
+    G4int label;
+
+    G4int x_dim;
+    G4int y_dim;
+    G4int z_dim;
+
+    // Every dose in the structure, smallest first.
+    std::vector<G4double> doses;
+    G4double sum;
+};
+
+#endif // DOSESTATISTICS_HH
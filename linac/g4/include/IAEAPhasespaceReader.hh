@@ -0,0 +1,109 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef IAEAPHASESPACEREADER_HH
+#define IAEAPHASESPACEREADER_HH
+
+#include "PhasespaceReader.hh"
+#include "PhasespaceFormat.hh"
+
+#include <fstream>
+#include <map>
+#include <vector>
+
+
+// Reads IAEA phase-space files, as written by us or any other code that
+// follows the IAEA format. Particles other than photons, electrons and
+// positrons are skipped, but still count as records for Seek and
+// GetRecordCount.
+class IAEAPhasespaceReader : public PhasespaceReader {
+  public:
+    IAEAPhasespaceReader(G4String filename);
+    virtual ~IAEAPhasespaceReader();
+
+    // The common stem of a .IAEAheader/.IAEAphsp pair
+    static G4String GetStem(G4String filename);
+
+    G4bool Read(PhasespaceRecord& record);
+    G4bool Seek(int64_t index);
+
+    int64_t GetRecordCount() {
+        return record_count;
+    };
+
+    int64_t GetSkippedCount() {
+        return skipped_records;
+    };
+
+    int64_t GetOriginalHistories() {
+        return original_histories;
+    };
+
+    // Count listed in the header for $PHOTONS, $ELECTRONS, ...
+    int64_t GetParticleCount(G4String section) {
+        return particle_counts.count(section) ? particle_counts[section] : 0;
+    };
+
+    // Extras of the record last returned by Read.
+    const std::vector<float>& GetExtraFloats() {
+        return extra_floats;
+    };
+
+    const std::vector<int32_t>& GetExtraLongs() {
+        return extra_longs;
+    };
+
+    const std::vector<G4int>& GetExtraFloatTypes() {
+        return extra_float_types;
+    };
+
+    const std::vector<G4int>& GetExtraLongTypes() {
+        return extra_long_types;
+    };
+
+  private:
+    G4bool ReadHeader(G4String filename);
+    void Parse(const char* buffer, PhasespaceRecord& record);
+
+  private:
+    std::ifstream* input_file_stream;
+
+    int64_t record_count;
+    int64_t original_histories;
+    int64_t current_record;
+    int64_t skipped_records;
+    std::map<G4String, int64_t> particle_counts;
+
+    // x, y, z, u, v, w, weight
+    G4bool stored[7];
+    G4double constant[7];
+
+    std::vector<G4int> extra_float_types;
+    std::vector<G4int> extra_long_types;
+    std::vector<float> extra_floats;
+    std::vector<int32_t> extra_longs;
+
+    G4int record_length;
+    G4bool swap_bytes;
+    std::vector<char> buffer;
+};
+
+#endif /* IAEAPHASESPACEREADER_HH */
@@ -0,0 +1,82 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef IAEAPHASESPACEWRITER_HH
+#define IAEAPHASESPACEWRITER_HH
+
+#include "PhasespaceWriter.hh"
+#include "PhasespaceFormat.hh"
+
+#include <fstream>
+#include <map>
+
+
+// Writes an IAEA phase-space pair, `filename` names either file (or the
+// common stem) and the other is found by swapping the extension. Every
+// record stores x, y, z, u, v and the weight, plus the incremental history
+// number as an extra long: the number of original histories since the
+// previous record, so the increments add up to $ORIG_HISTORIES less any
+// histories after the last record.
+class IAEAPhasespaceWriter : public PhasespaceWriter {
+  public:
+    IAEAPhasespaceWriter(G4String filename);
+    virtual ~IAEAPhasespaceWriter();
+
+    void Write(const PhasespaceRecord& record);
+    void Close();
+
+    void SetOriginalHistories(int64_t histories) {
+        original_histories = histories;
+    };
+
+    int64_t GetRecordCount() {
+        return record_count;
+    };
+
+  private:
+    void WriteHeader();
+
+  private:
+    // Running totals for $STATISTICAL_INFORMATION_PARTICLES
+    struct Statistics {
+        int64_t count;
+        G4double weight;
+        G4double weight_min;
+        G4double weight_max;
+        G4double energy;
+        G4double energy_min;
+        G4double energy_max;
+    };
+
+  private:
+    G4String stem;
+    std::ofstream* output_file_stream;
+
+    int64_t record_count;
+    int64_t original_histories;
+    int64_t last_history;
+
+    std::map<G4int, Statistics> statistics;
+    G4double position_min[3];
+    G4double position_max[3];
+};
+
+#endif /* IAEAPHASESPACEWRITER_HH */
@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef INDEXINGPHASESPACEWRITER_HH
+#define INDEXINGPHASESPACEWRITER_HH
+
+#include "PhasespaceWriter.hh"
+#include "PhasespaceIndex.hh"
+
+
+// Passes records through to another writer and saves a sidecar index
+// of them next to the file on Close.
+class IndexingPhasespaceWriter : public PhasespaceWriter {
+  public:
+    IndexingPhasespaceWriter(PhasespaceWriter* writer, G4String filename);
+    virtual ~IndexingPhasespaceWriter();
+
+    void Write(const PhasespaceRecord& record);
+    void WriteBlock(const std::vector<PhasespaceRecord>& block);
+    void Close();
+
+    void SetOriginalHistories(int64_t histories) {
+        index.SetOriginalHistories(histories);
+        writer->SetOriginalHistories(histories);
+    };
+
+    int64_t GetRecordCount() {
+        return writer->GetRecordCount();
+    };
+
+  private:
+    PhasespaceWriter* writer;
+    G4String filename;
+
+    PhasespaceIndex index;
+    G4bool closed;
+};
+
+#endif /* INDEXINGPHASESPACEWRITER_HH */
@@ -0,0 +1,67 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef MAPPEDHISTOGRAM_HH
+#define MAPPEDHISTOGRAM_HH
+
+#include "globals.hh"
+
+#include <stdint.h>
+#include <vector>
+
+
+// A .npy file mapped into memory and shared with the file, so whatever is
+// written into it can be read by another process while the run goes on,
+// or picked up again after a crash.
+class MappedHistogram {
+  public:
+    MappedHistogram();
+    ~MappedHistogram();
+
+    // Map `filename` as an array of `shape` holding `descr` ("<f8" or
+    // "<i8"), creating it zeroed if it does not exist. An existing file of
+    // the same shape and type is kept as is, any other is left alone and
+    // the open fails.
+    G4bool Open(G4String filename, G4String descr, const std::vector<int64_t>& shape);
+
+    // Write the mapped pages out to the file.
+    void Sync();
+
+    void* GetData() {
+        return data;
+    };
+
+    // True if the file was already there, with the same shape, when it
+    // was opened.
+    G4bool Existed() {
+        return existed;
+    };
+
+  private:
+    static std::string MakeHeader(G4String descr, const std::vector<int64_t>& shape);
+
+    void* mapping;
+    size_t mapping_size;
+    void* data;
+    G4bool existed;
+};
+
+#endif /* MAPPEDHISTOGRAM_HH */
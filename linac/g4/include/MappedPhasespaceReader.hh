@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef MAPPEDPHASESPACEREADER_HH
+#define MAPPEDPHASESPACEREADER_HH
+
+#include "PhasespaceReader.hh"
+#include "PhasespaceFormat.hh"
+
+#include "G4Timer.hh"
+
+
+// Maps a fixed width phasespace file into memory and hands out pointers
+// straight into the mapping. The mapping is shared and read only, so
+// every process reading the same file on a node uses the same page cache.
+class MappedPhasespaceReader : public PhasespaceReader {
+  public:
+    MappedPhasespaceReader(G4String filename, G4bool sequential=true);
+    virtual ~MappedPhasespaceReader();
+
+    G4bool IsMapped() {
+        return records != NULL;
+    };
+
+    // The next record in the file, or NULL once it is exhausted.
+    const PackedPhasespaceRecord* Next() {
+        if (current_record >= end_record)
+            return NULL;
+
+        if (!timing) {
+            timer.Start();
+            timing = true;
+            first_timed_record = current_record;
+        }
+
+        return (const PackedPhasespaceRecord*) (records + (current_record++)*record_size);
+    };
+
+    G4bool Read(PhasespaceRecord& record);
+    G4bool Seek(int64_t index);
+
+    // Only hand out records [begin, end), starting at `begin`. Seek and
+    // GetRecordCount are then relative to the range, as they are for a
+    // PartitionedPhasespaceReader.
+    G4bool SetRange(int64_t begin, int64_t end);
+
+    int64_t GetRecordCount() {
+        return end_record - begin_record;
+    };
+
+    G4double GetRecordsPerSecond();
+    void PrintStatistics();
+
+  private:
+    G4String filename;
+
+    void* mapping;
+    size_t mapping_size;
+
+    const char* records;
+    size_t record_size;
+    int64_t record_count;
+    int64_t current_record;
+    int64_t begin_record;
+    int64_t end_record;
+
+    G4Timer timer;
+    G4bool timing;
+    int64_t first_timed_record;
+};
+
+#endif /* MAPPEDPHASESPACEREADER_HH */
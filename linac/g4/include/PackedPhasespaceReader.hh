@@ -0,0 +1,54 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef PACKEDPHASESPACEREADER_HH
+#define PACKEDPHASESPACEREADER_HH
+
+#include "PhasespaceReader.hh"
+#include "PhasespaceFormat.hh"
+
+#include <fstream>
+
+
+class PackedPhasespaceReader : public PhasespaceReader {
+  public:
+    PackedPhasespaceReader(G4String filename);
+    virtual ~PackedPhasespaceReader();
+
+    G4bool Read(PhasespaceRecord& record);
+    G4bool Seek(int64_t index);
+
+    int64_t GetRecordCount() {
+        return header.record_count;
+    };
+
+    const PhasespaceHeader& GetHeader() {
+        return header;
+    };
+
+  private:
+    std::ifstream* input_file_stream;
+    PhasespaceHeader header;
+
+    int64_t current_record;
+};
+
+#endif /* PACKEDPHASESPACEREADER_HH */
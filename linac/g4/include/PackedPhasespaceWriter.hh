@@ -0,0 +1,54 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef PACKEDPHASESPACEWRITER_HH
+#define PACKEDPHASESPACEWRITER_HH
+
+#include "PhasespaceWriter.hh"
+#include "PhasespaceFormat.hh"
+
+#include <fstream>
+
+
+class PackedPhasespaceWriter : public PhasespaceWriter {
+  public:
+    PackedPhasespaceWriter(G4String filename);
+    virtual ~PackedPhasespaceWriter();
+
+    void Write(const PhasespaceRecord& record);
+    void WriteBlock(const std::vector<PhasespaceRecord>& block);
+    void Close();
+
+    int64_t GetRecordCount() {
+        return header.record_count;
+    };
+
+  private:
+    void WriteHeader();
+
+  private:
+    std::ofstream* output_file_stream;
+    PhasespaceHeader header;
+
+    std::vector<PackedPhasespaceRecord> packed_block;
+};
+
+#endif /* PACKEDPHASESPACEWRITER_HH */
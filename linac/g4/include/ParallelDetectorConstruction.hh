@@ -24,6 +24,7 @@
 
 // USER //
 #include "Phasespace.hh"
+#include "ScoringMesh.hh"
 
 // GEANT4 //
 #include "G4VUserParallelWorld.hh"
@@ -37,14 +38,36 @@ class ParallelDetectorConstruction : public G4VUserParallelWorld
     ~ParallelDetectorConstruction();
 
     void Construct();
+#ifdef G4MULTITHREADED
+    void ConstructSD();
+#endif
     G4VPhysicalVolume* AddPhasespace(char* name, double radius, double z_position, bool kill);
     void RemovePhasespace(char* name);
+    void ClosePhasespaces();
+    Phasespace* GetPhasespace(G4String name);
+
+    G4VPhysicalVolume* AddScoringMesh(char* name, ScoringMesh::Shape shape,
+            G4ThreeVector size, G4int x_bins, G4int y_bins, G4int z_bins,
+            G4ThreeVector translation, G4ThreeVector rotation);
+    void RemoveScoringMesh(char* name);
+    ScoringMesh* GetScoringMesh(G4String name);
+    void ReduceScoringMeshes();
+    void ZeroScoringMeshes();
   
   private:
+#ifdef G4MULTITHREADED
+    template<class Detector>
+    void AttachWorker(G4String name, Detector* master);
+#endif
+
     G4LogicalVolume* world_logical;
     G4VPhysicalVolume* world_physical;
 
-    std::map<char*, Phasespace*> phasespaces;
+    std::map<G4String, Phasespace*> phasespaces;
+    std::map<G4String, ScoringMesh*> meshes;
+
+    // The volume each phasespace and mesh is attached to, for the workers.
+    std::map<G4String, G4LogicalVolume*> volumes;
 
     G4int verbose;
 };
@@ -0,0 +1,55 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef PARTITIONEDPHASESPACEREADER_HH
+#define PARTITIONEDPHASESPACEREADER_HH
+
+#include "PhasespaceReader.hh"
+
+
+// Restricts another reader to the records [begin, end), record indices
+// seen through this reader are relative to `begin`.
+class PartitionedPhasespaceReader : public PhasespaceReader {
+  public:
+    PartitionedPhasespaceReader(PhasespaceReader* reader,
+            int64_t begin, int64_t end);
+    virtual ~PartitionedPhasespaceReader();
+
+    G4bool Read(PhasespaceRecord& record);
+    G4bool Seek(int64_t index);
+
+    int64_t GetRecordCount() {
+        return end - begin;
+    };
+
+    int64_t GetSkippedCount() {
+        return reader->GetSkippedCount();
+    };
+
+  private:
+    PhasespaceReader* reader;
+
+    int64_t begin;
+    int64_t end;
+    int64_t current_record;
+};
+
+#endif /* PARTITIONEDPHASESPACEREADER_HH */
@@ -23,18 +23,18 @@
 #define	_PHASESPACE_HH
 
 #include "PhasespaceRecord.hh"
+#include "PhasespaceWriter.hh"
 
 #include "G4VSensitiveDetector.hh"
 #include "G4VUserDetectorConstruction.hh"
 #include "globals.hh"
 
-//#include "boost/python.hpp"
-//#include "pyublas/numpy.hpp"
+#include "boost/thread.hpp"
 
-#include "boost/archive/binary_iarchive.hpp"
-#include "boost/archive/binary_oarchive.hpp"
+#include <vector>
 
-#include <fstream>
+//#include "boost/python.hpp"
+//#include "pyublas/numpy.hpp"
 
 
 class G4Step;
@@ -54,8 +54,32 @@ class Phasespace : public G4VSensitiveDetector {
     void PrintAll();
 
   public:
+    void Open();
     void Close();
 
+    // A copy of this phasespace for a worker thread, writing its own
+    // shard of the file and closed along with this one.
+    Phasespace* MakeWorker();
+
+    // Write a block compressed file instead of a fixed width one, must be
+    // set before the first event.
+    void SetCompression(G4int level, G4bool delta, G4double position_step,
+            G4double direction_step, G4double energy_step) {
+        this->compressed = true;
+        this->compression_level = level;
+        this->delta = delta;
+        this->position_step = position_step;
+        this->direction_step = direction_step;
+        this->energy_step = energy_step;
+    };
+
+    // Write to shard `shard` of the file instead of the file itself, so
+    // several processes can record the same phasespace. Worker threads
+    // always write their own shard.
+    void SetShard(G4int shard) {
+        this->shard = shard;
+    };
+
     void SetKillAtPlane(G4bool kill) {
         this->kill = kill;
     };
@@ -71,13 +95,25 @@ class Phasespace : public G4VSensitiveDetector {
   private: 
     DetectorConstruction* detector_construction;
 
-    std::ofstream* output_file_stream;
-    boost::archive::binary_oarchive* phasespace_archive;
+    PhasespaceWriter* writer;
 
     G4String name;
+    G4int shard;
     G4double radius;
     G4int record_count;
     G4bool kill;
+    G4bool new_history;
+    int64_t history_count;
+
+    G4bool compressed;
+    G4int compression_level;
+    G4bool delta;
+    G4double position_step;
+    G4double direction_step;
+    G4double energy_step;
+
+    std::vector<Phasespace*> workers;
+    boost::mutex workers_mutex;
 };
 
 
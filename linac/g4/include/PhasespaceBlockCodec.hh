@@ -0,0 +1,51 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef PHASESPACEBLOCKCODEC_HH
+#define PHASESPACEBLOCKCODEC_HH
+
+#include "PhasespaceFormat.hh"
+
+#include <vector>
+
+
+// Turns a block of packed records into a compressed buffer and back,
+// following the encoding options in the file header. Encode and Decode
+// keep no state, so blocks can be handled from several threads at once.
+class PhasespaceBlockCodec {
+  public:
+    PhasespaceBlockCodec(const CompressedPhasespaceHeader& header, int level=3);
+    ~PhasespaceBlockCodec();
+
+    void Encode(const std::vector<PackedPhasespaceRecord>& records,
+            std::vector<char>& compressed) const;
+    bool Decode(const std::vector<char>& compressed, unsigned int record_count,
+            std::vector<PackedPhasespaceRecord>& records) const;
+
+  private:
+    float GetStep(int column) const;
+
+  private:
+    CompressedPhasespaceHeader header;
+    int level;
+};
+
+#endif /* PHASESPACEBLOCKCODEC_HH */
@@ -0,0 +1,121 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef PHASESPACEFORMAT_HH
+#define PHASESPACEFORMAT_HH
+
+#include <stdint.h>
+
+#include "boost/static_assert.hpp"
+
+
+// Fixed width phasespace files are a single PhasespaceHeader followed by
+// record_count PackedPhasespaceRecords, so record i always lives at
+// sizeof(PhasespaceHeader) + i*record_size. All structures are written
+// in host (little endian) byte order.
+//
+// Compressed phasespace files are a PhasespaceHeader (with its own magic)
+// and a CompressedPhasespaceHeader, followed by independently compressed
+// blocks of records and finally a CompressedBlockIndex per block.
+
+static const char PHASESPACE_MAGIC[8] = {'L', 'I', 'N', 'A', 'C', 'P', 'H', 'S'};
+static const char COMPRESSED_PHASESPACE_MAGIC[8] = {'L', 'I', 'N', 'A', 'C', 'P', 'H', 'Z'};
+static const uint32_t PHASESPACE_VERSION = 1;
+
+// PackedPhasespaceRecord::flags
+static const uint8_t PHASESPACE_NEW_HISTORY = 0x01;
+
+// CompressedPhasespaceHeader::codec
+static const uint32_t PHASESPACE_CODEC_ZSTD = 1;
+
+// CompressedPhasespaceHeader::encoding, blocks are always stored as
+// columns (all x, then all y, ...) before compression.
+static const uint32_t PHASESPACE_ENCODING_DELTA = 0x01;      // lossless
+static const uint32_t PHASESPACE_ENCODING_QUANTIZED = 0x02;  // bounded error
+
+
+// IAEA phase-space files (.IAEAheader + .IAEAphsp), see the IAEA report
+// INDC(NDS)-0484. Lengths in cm, energies in MeV, little endian.
+static const int IAEA_PHOTON = 1;
+static const int IAEA_ELECTRON = 2;
+static const int IAEA_POSITRON = 3;
+
+// Extra long type for the incremental history number
+static const int IAEA_NEW_HISTORY_NUMBER = 1;
+
+
+struct PhasespaceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t record_count;
+
+    // Size of the length and energy units in the file, in internal
+    // GEANT4 units (mm, MeV).
+    double length_unit;
+    double energy_unit;
+
+    char reserved[24];
+};
+
+
+struct PackedPhasespaceRecord {
+    float position[3];
+    float direction[3];
+    float kinetic_energy;
+    float weight;
+
+    // -1 e-, 0 gamma, 1 e+ (as PhasespaceRecord::particle_type)
+    int8_t particle_type;
+    uint8_t flags;
+    uint16_t reserved;
+};
+
+
+struct CompressedPhasespaceHeader {
+    uint64_t index_offset;
+    uint32_t block_count;
+    uint32_t codec;
+    uint32_t encoding;
+
+    // Quantisation steps for PHASESPACE_ENCODING_QUANTIZED, values are
+    // stored to within half a step. Values more than 2^31 steps from zero
+    // are clamped.
+    float position_step;
+    float direction_step;
+    float energy_step;
+};
+
+
+struct CompressedBlockIndex {
+    uint64_t offset;
+    uint64_t first_record;
+    uint32_t record_count;
+    uint32_t compressed_size;
+};
+
+
+BOOST_STATIC_ASSERT(sizeof(PhasespaceHeader) == 64);
+BOOST_STATIC_ASSERT(sizeof(PackedPhasespaceRecord) == 36);
+BOOST_STATIC_ASSERT(sizeof(CompressedPhasespaceHeader) == 32);
+BOOST_STATIC_ASSERT(sizeof(CompressedBlockIndex) == 24);
+
+#endif /* PHASESPACEFORMAT_HH */
@@ -0,0 +1,156 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef PHASESPACEINDEX_HH
+#define PHASESPACEINDEX_HH
+
+#include "PhasespaceRecord.hh"
+
+#include "globals.hh"
+
+#include "boost/serialization/vector.hpp"
+
+#include <stdint.h>
+#include <vector>
+
+class PhasespaceReader;
+
+
+// Fields with a minimum and maximum kept in the index.
+enum PhasespaceIndexField {
+    INDEX_POSITION_X,
+    INDEX_POSITION_Y,
+    INDEX_POSITION_Z,
+    INDEX_DIRECTION_X,
+    INDEX_DIRECTION_Y,
+    INDEX_DIRECTION_Z,
+    INDEX_KINETIC_ENERGY,
+    INDEX_WEIGHT,
+    INDEX_FIELDS
+};
+
+// Particle types are -1, 0 and 1 for electrons, photons and positrons.
+const G4int INDEX_PARTICLE_TYPES = 3;
+
+
+// A run of consecutive records and how many of each particle type it
+// holds, so readers can seek past blocks they have no interest in.
+struct PhasespaceIndexBlock {
+    int64_t first_record;
+    int64_t record_count;
+    int64_t particle_count[INDEX_PARTICLE_TYPES];
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int) {
+        ar & first_record;
+        ar & record_count;
+        ar & particle_count;
+    };
+};
+
+
+// Summary of a phasespace file, kept next to it as `<filename>.index`
+// so the file does not have to be read to know what is in it.
+class PhasespaceIndex {
+  public:
+    PhasespaceIndex(G4int block_size=65536);
+
+    void Add(const PhasespaceRecord& record);
+
+    // Append the index of a file that follows this one, as when shards
+    // are read or merged one after another.
+    void Append(const PhasespaceIndex& other);
+
+    void SetOriginalHistories(int64_t histories) {
+        original_histories = histories;
+    };
+
+    G4bool Save(G4String filename);
+
+    // The index for the phasespace file `filename`, or NULL if it has none.
+    static PhasespaceIndex* Load(G4String filename);
+    static G4String GetIndexFilename(G4String filename);
+
+    // Read through a phasespace that has no index and build one.
+    static PhasespaceIndex* Build(PhasespaceReader* reader, G4int block_size=65536);
+
+    int64_t GetRecordCount() {
+        return record_count;
+    };
+
+    int64_t GetOriginalHistories() {
+        return original_histories;
+    };
+
+    int64_t GetParticleCount(G4int particle_type) {
+        return particle_count[particle_type + 1];
+    };
+
+    G4double GetWeightSum(G4int particle_type) {
+        return weight_sum[particle_type + 1];
+    };
+
+    G4double GetMinimum(PhasespaceIndexField field) {
+        return minimum[field];
+    };
+
+    G4double GetMaximum(PhasespaceIndexField field) {
+        return maximum[field];
+    };
+
+    G4int GetNumberOfBlocks() {
+        return blocks.size();
+    };
+
+    const PhasespaceIndexBlock& GetBlock(G4int block) {
+        return blocks[block];
+    };
+
+    void Print();
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int) {
+        ar & block_size;
+        ar & record_count;
+        ar & original_histories;
+        ar & particle_count;
+        ar & weight_sum;
+        ar & minimum;
+        ar & maximum;
+        ar & blocks;
+    };
+
+  private:
+    G4int block_size;
+
+    int64_t record_count;
+    int64_t original_histories;
+
+    int64_t particle_count[INDEX_PARTICLE_TYPES];
+    G4double weight_sum[INDEX_PARTICLE_TYPES];
+
+    G4double minimum[INDEX_FIELDS];
+    G4double maximum[INDEX_FIELDS];
+
+    std::vector<PhasespaceIndexBlock> blocks;
+};
+
+#endif /* PHASESPACEINDEX_HH */
@@ -0,0 +1,86 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef PHASESPACEREADER_HH
+#define PHASESPACEREADER_HH
+
+#include "PhasespaceRecord.hh"
+#include "PhasespaceIndex.hh"
+
+#include "globals.hh"
+
+#include <stdint.h>
+
+
+// Common interface for reading phasespace files back, regardless of the
+// format they were written in.
+class PhasespaceReader {
+  public:
+    PhasespaceReader();
+    virtual ~PhasespaceReader();
+
+    // Pick the right reader for `filename` by looking at its contents,
+    // returns NULL if the file cannot be opened. The sidecar index is
+    // loaded along with it if there is one.
+    static PhasespaceReader* Open(G4String filename);
+
+    // The sidecar index of the file, or NULL if it has none.
+    PhasespaceIndex* GetIndex() {
+        return phasespace_index;
+    };
+
+    // Read the next record, returns false once the file is exhausted.
+    virtual G4bool Read(PhasespaceRecord& record) = 0;
+
+    // Position the reader so the next Read returns record `index`.
+    virtual G4bool Seek(int64_t index) = 0;
+
+    // Total number of records, or -1 if the format does not know it
+    // without reading the whole file.
+    virtual int64_t GetRecordCount() = 0;
+
+    // Records Read has passed over so far without returning them, for
+    // formats that hold particles we cannot replay. Still counted by
+    // Seek and GetRecordCount.
+    virtual int64_t GetSkippedCount() {
+        return 0;
+    };
+
+    // The first record at or after `index` that starts a new history,
+    // or the record count if there is none.
+    int64_t FindHistoryStart(int64_t index);
+
+    // Split the file into `count` contiguous record ranges and give back
+    // [begin, end) for partition `index`. With `align_histories` the
+    // ranges only break at the start of a history, so particles from one
+    // history always end up in the same partition. Leaves the reader at
+    // an arbitrary record, returns false if the file has no record count.
+    G4bool GetPartition(int64_t index, int64_t count, G4bool align_histories,
+            int64_t& begin, int64_t& end);
+
+  private:
+    static PhasespaceReader* OpenFile(G4String filename);
+
+  protected:
+    PhasespaceIndex* phasespace_index;
+};
+
+#endif /* PHASESPACEREADER_HH */
@@ -22,6 +22,8 @@
 #ifndef PHASESPACERECORD_HH
 #define PHASESPACERECORD_HH
 
+#include "PhasespaceFormat.hh"
+
 #include "globals.hh"
 
 #include "G4Step.hh"
@@ -35,8 +37,14 @@ class PhasespaceRecord {
   public:
     PhasespaceRecord();
     PhasespaceRecord(G4Step* step);
+    // A packed record in GEANT4 units, from a file storing lengths and
+    // energies in units of `length_unit` and `energy_unit`.
+    PhasespaceRecord(const PackedPhasespaceRecord& packed,
+            G4double length_unit=1, G4double energy_unit=1);
     virtual ~PhasespaceRecord();
 
+    PackedPhasespaceRecord Pack() const;
+
   private:
     friend class boost::serialization::access;
     template<class Archive>
@@ -60,11 +68,15 @@ class PhasespaceRecord {
   public:
     G4bool CheckIt(G4double xlow, G4double xhigh, G4double ylow,
             G4double yhigh, G4double zlow, G4double zhigh);
+    static G4bool CheckPosition(G4double x, G4double y, G4double z,
+            G4double xlow, G4double xhigh, G4double ylow,
+            G4double yhigh, G4double zlow, G4double zhigh);
     G4ThreeVector GetPosition();
     G4ThreeVector GetMomentum();
     G4double GetKineticEnergy();
     G4int GetParticleType();
     G4double GetWeight();
+    G4bool IsNewHistory();
     
   public:
     double position_x;
@@ -81,6 +93,14 @@ class PhasespaceRecord {
 
     int particle_type;
 
+    // First record written for a primary history, not part of the
+    // legacy archive.
+    bool new_history;
+
+    // Number of the primary history that wrote the record, counted from
+    // one, or 0 if not known. Only kept in memory, for formats that
+    // store history increments.
+    int64_t history;
 };
 
 #endif /* PHASESPACERECORD_HH */
@@ -0,0 +1,54 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef PHASESPACEWRITER_HH
+#define PHASESPACEWRITER_HH
+
+#include "PhasespaceRecord.hh"
+
+#include "globals.hh"
+
+#include <stdint.h>
+#include <vector>
+
+
+// Common interface for everything that can store phasespace records,
+// the Phasespace sensitive detector only talks to this.
+class PhasespaceWriter {
+  public:
+    virtual ~PhasespaceWriter() {};
+
+    virtual void Write(const PhasespaceRecord& record) = 0;
+
+    virtual void WriteBlock(const std::vector<PhasespaceRecord>& block) {
+        for (unsigned int i=0; i<block.size(); i++)
+            Write(block[i]);
+    };
+    virtual void Close() = 0;
+
+    // Number of primary histories simulated while writing, for formats
+    // that record it.
+    virtual void SetOriginalHistories(int64_t) {};
+
+    virtual int64_t GetRecordCount() = 0;
+};
+
+#endif /* PHASESPACEWRITER_HH */
@@ -0,0 +1,79 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef PREFETCHPHASESPACEREADER_HH
+#define PREFETCHPHASESPACEREADER_HH
+
+#include "PhasespaceReader.hh"
+
+#include "boost/atomic.hpp"
+#include "boost/thread.hpp"
+#include "boost/lockfree/spsc_queue.hpp"
+
+#include <sys/types.h>
+
+
+// Reads records ahead of the event loop on a background thread. The
+// records are handed over in a lock-free single producer, single
+// consumer ring buffer, so the generator only blocks on the disk if the
+// buffer runs dry. A copy inherited by a forked child has no thread of
+// its own, the child may only delete it.
+class PrefetchPhasespaceReader : public PhasespaceReader {
+  public:
+    PrefetchPhasespaceReader(PhasespaceReader* reader, G4int depth=65536);
+    virtual ~PrefetchPhasespaceReader();
+
+    G4bool Read(PhasespaceRecord& record);
+    G4bool Seek(int64_t index);
+
+    int64_t GetRecordCount() {
+        return reader->GetRecordCount();
+    };
+
+    // True once every record has been handed to the consumer.
+    G4bool IsExhausted() {
+        return exhausted;
+    };
+
+    // Number of reads that found the buffer empty and had to wait.
+    int64_t GetStalls() {
+        return stalls;
+    };
+
+  private:
+    void Start();
+    void Stop();
+    void Run();
+
+  private:
+    PhasespaceReader* reader;
+    boost::lockfree::spsc_queue<PhasespaceRecord>* ring;
+
+    boost::thread prefetch_thread;
+    pid_t owner;
+    boost::atomic<bool> stopping;
+    boost::atomic<bool> finished;
+
+    G4bool exhausted;
+    int64_t stalls;
+};
+
+#endif /* PREFETCHPHASESPACEREADER_HH */
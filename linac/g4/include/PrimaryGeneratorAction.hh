@@ -23,13 +23,19 @@
 #define PrimaryGeneratorAction_h 1
 
 #include "PhasespaceRecord.hh"
+#include "PhasespaceReader.hh"
+#include "MappedPhasespaceReader.hh"
+#include "PrefetchPhasespaceReader.hh"
+#include "PartitionedPhasespaceReader.hh"
 
 #include "G4VUserPrimaryGeneratorAction.hh"
+#include "G4RotationMatrix.hh"
 #include "G4GeneralParticleSource.hh"
 #include "G4ParticleGun.hh"
 
-#include "boost/archive/binary_iarchive.hpp"
-#include "boost/archive/binary_oarchive.hpp"
+#include "boost/thread.hpp"
+
+#include <vector>
 
 class G4GeneralParticleSource;
 class G4Event;
@@ -70,58 +76,133 @@ class PhasespaceRecordStream {
 class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction
 {
     public:
-        PrimaryGeneratorAction();
+        // A worker generator takes its settings from `master` at the start
+        // of every run, and reads the phasespace source the master opened.
+        PrimaryGeneratorAction(PrimaryGeneratorAction* master=NULL);
         ~PrimaryGeneratorAction();
 
         void Reset();
 
         void SetPosition(G4ThreeVector position) {
+            gun_position = position;
             particle_gun->GetCurrentSource()->GetPosDist()->SetCentreCoords(position);
         };
 
         void SetDirection(G4ThreeVector direction) {
+            gun_direction = direction;
             particle_gun->GetCurrentSource()->GetAngDist()->
                 SetParticleMomentumDirection(direction);
         };
 
         void SetEnergy(G4double energy) {
+            gun_energy = energy;
             particle_gun->GetCurrentSource()->GetEneDist()->SetMonoEnergy(energy*MeV);
         };
 
         void SetFWHM(G4double fwhm) {
+            gun_fwhm = fwhm;
             particle_gun->GetCurrentSource()->GetPosDist()->SetBeamSigmaInR(fwhm*mm); 
         };
 
+        // Copy the settings of the master generator, called on each worker
+        // before every run.
+        void Synchronise();
+
+        // Reseed the random engine at the start of every event from the
+        // simulation `seed`, the `run` and the number of the event alone,
+        // so an event draws the same numbers whichever thread or process
+        // generates it. Events are numbered on from `first_event`, for
+        // runs that carry on from another.
+        void SetEventSeeding(int64_t seed, G4int run, int64_t first_event) {
+            event_seeding = true;
+            event_seed = seed;
+            seed_run = run;
+            this->first_event = first_event;
+        };
+
+        void DisableEventSeeding() {
+            event_seeding = false;
+        };
+
         void SetRecyclingNumber(G4int number) {
             recycling_number = number;
+            copy_rotations.clear();
         }
 
         void SetRedistribute(G4bool flag) {
             redistribute = flag;
+            copy_rotations.clear();
             G4cout << "setting redistribute flag to " << redistribute << G4endl;
         }   
 
         void SetGantryRotation(G4ThreeVector rotation) {
             G4cout << "Setting gantry rotation: " << rotation << G4endl;
             this->rotation = rotation;
+            copy_rotations.clear();
         };
 
-        void SetSource(char* phasespace) {
-            if (phasespace == NULL) {
-                G4cout << "Not using phasespace file as particle source, running from GPS" << G4endl;
-                from_phasespace = false;
-            } else {
-                from_phasespace = true;
-                G4cout << "Using phasespace file as particle source: " << phasespace << G4endl;
-                
-                input_file_stream = new std::ifstream(phasespace, std::ios::binary);
-                phasespace_archive = new boost::archive::binary_iarchive(*input_file_stream);
-
-                particle_gun->GetCurrentSource()->GetPosDist()->SetPosDisType("Point");
-                phasespace_record_repeat = -1;
-            }
-        }
+        // Put every recycled copy of a phasespace particle into the one
+        // event as its own primary vertex, rather than one copy per event.
+        void SetBatchRecycling(G4bool batch) {
+            batch_recycling = batch;
+        };
+
+        void SetSource(char* phasespace);
     
+        // Replay only partition `index` of `count` equal slices of the
+        // phasespace, split on history boundaries. Takes effect on the
+        // next SetSource.
+        void SetPartition(G4int index, G4int count) {
+            partition_index = index;
+            partition_count = count;
+        };
+
+        // Replay only records [begin, end), an `end` of -1 runs to the end
+        // of the file. Takes effect on the next SetSource.
+        void SetRecordRange(int64_t begin, int64_t end) {
+            range_begin = begin;
+            range_end = end;
+        };
+
+        // Read fixed width phasespace files through a shared memory
+        // mapping, takes effect on the next SetSource.
+        void SetMemoryMapped(G4bool mapped) {
+            memory_mapped = mapped;
+        };
+
+        // Number of records to read ahead of the event loop, zero reads
+        // on demand. Takes effect on the next SetSource.
+        void SetPrefetchDepth(G4int depth) {
+            prefetch_depth = depth;
+        };
+
+        // Number of records this generator will replay from the
+        // phasespace, or -1 if that is not known without reading it.
+        int64_t GetSourceRecordCount() {
+            if (!from_phasespace)
+                return -1;
+            return phasespace_reader->GetRecordCount();
+        };
+
+        // The sidecar index of the phasespace source, or NULL.
+        PhasespaceIndex* GetSourceIndex() {
+            return source_index;
+        };
+
+        // True once the phasespace has run out of records.
+        G4bool IsSourceExhausted() {
+            boost::mutex::scoped_lock lock(source_mutex);
+            return source_exhausted;
+        };
+
+        void PrintSourceStatistics() {
+            if (mapped_reader)
+                mapped_reader->PrintStatistics();
+            if (prefetch_reader)
+                G4cout << "Prefetch buffer ran dry " << prefetch_reader->GetStalls()
+                       << " times" << G4endl;
+        };
+
         void SetPhasespaceLimits(G4double xlow, G4double xhigh,
                 G4double ylow, G4double yhigh, G4double zlow, G4double zhigh) {
             this->xlow = xlow;
@@ -135,18 +216,60 @@ class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction
     public:
         void GeneratePrimaries(G4Event* event);
         void GeneratePhasespacePrimaries(G4Event* event);
+        void GenerateBatchedPhasespacePrimaries(G4Event* event);
+
+    private:
+        G4bool RestrictSource();
+        G4bool ReadPhasespaceRecord();
+        G4bool ReadPhasespaceRecord(MappedPhasespaceReader* mapped, PhasespaceReader* reader);
+        void SourceExhausted();
+        void SeedEvent(G4int event_id);
+
+        // The SplitMix64 finaliser, spreads a counter over all 64 bits.
+        static uint64_t Mix(uint64_t x) {
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        };
+        void PrepareCopyRotations(G4int copies);
         
     private:
+        PrimaryGeneratorAction* master;
+
         G4ParticleGun* phasespace_particle_gun;
         G4GeneralParticleSource* particle_gun;
 
+        // What the gun was last set to, for the workers to copy.
+        G4ThreeVector gun_position;
+        G4ThreeVector gun_direction;
+        G4double gun_energy;
+        G4double gun_fwhm;
+
         G4ThreeVector rotation;
 
         G4bool from_phasespace;
 
         // Not in the constructor, so we need pointers.
-        std::ifstream* input_file_stream;
-        boost::archive::binary_iarchive* phasespace_archive;
+        PhasespaceReader* phasespace_reader;
+        MappedPhasespaceReader* mapped_reader;
+        G4bool memory_mapped;
+        PrefetchPhasespaceReader* prefetch_reader;
+        PhasespaceIndex* source_index;
+        G4int prefetch_depth;
+        G4bool source_exhausted;
+
+        G4bool event_seeding;
+        int64_t event_seed;
+        G4int seed_run;
+        int64_t first_event;
+
+        // Held by a worker while it reads a record from the master source.
+        boost::mutex source_mutex;
+
+        G4int partition_index;
+        G4int partition_count;
+        int64_t range_begin;
+        int64_t range_end;
     
         G4ParticleDefinition* electron;
         G4ParticleDefinition* gamma;
@@ -154,10 +277,20 @@ class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction
 
         G4int recycling_number;
         G4bool redistribute;
+        G4bool batch_recycling;
+
+        // Gantry and redistribution rotation of each batched copy.
+        std::vector<G4RotationMatrix> copy_rotations;
 
         PhasespaceRecord phasespace_record;
         G4int phasespace_record_repeat;
 
+        // The record being replayed, however it was read.
+        G4ThreeVector record_position;
+        G4ThreeVector record_direction;
+        G4double record_weight;
+        G4bool record_valid;
+
         G4int count;
 
         G4double xlow;
@@ -0,0 +1,58 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef RANDOMENGINE_HH
+#define RANDOMENGINE_HH
+
+#include "globals.hh"
+
+#include "CLHEP/Random/RandomEngine.h"
+
+
+// Picks the random engine by name: "ranlux64", "ranlux", "james",
+// "ranecu", "mtwist", "mixmax" (Geant4 10.3 and later) or "xoshiro".
+// Worker threads make their own engine of the same kind at the start of
+// every run, Geant4 only knows how to copy its own engines to them.
+class RandomEngine {
+  public:
+    // A new engine, or NULL if the name is not known.
+    static CLHEP::HepRandomEngine* Create(G4String name);
+
+    // Make `name` the engine of this thread and of the workers from the
+    // next run on. False if the name is not known.
+    static G4bool Use(G4String name);
+
+    // Called by each worker before a run, swaps in a new engine if the
+    // choice changed since the last.
+    static void UseOnWorker();
+
+    // Random numbers per second `name` draws, over `count` numbers.
+    // Negative if the name is not known.
+    static G4double Benchmark(G4String name, G4int count);
+
+  private:
+    static G4String engine_name;
+    static G4int generation;
+
+    static CLHEP::HepRandomEngine* master_engine;
+};
+
+#endif /* RANDOMENGINE_HH */
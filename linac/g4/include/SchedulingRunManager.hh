@@ -0,0 +1,87 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef SchedulingRunManager_h
+#define SchedulingRunManager_h 1
+
+#ifdef G4MULTITHREADED
+
+#include "G4MTRunManager.hh"
+#include "G4Timer.hh"
+
+#include "boost/thread.hpp"
+
+#include <vector>
+
+
+// Hands events to the workers from the shared event counter in chunks
+// sized to the measured cost of an event, instead of the fixed chunk
+// Geant4 picks at the start of the run. Chunks aim to take `chunk_time`
+// of one worker, and are never more than half the events left shared
+// over the workers, so the chunks shrink as the run ends and the last
+// worker finishes soon after the first falls idle.
+class SchedulingRunManager : public G4MTRunManager
+{
+  public:
+    SchedulingRunManager();
+    virtual ~SchedulingRunManager();
+
+    virtual void InitializeEventLoop(G4int n_event, const char* macroFile=0,
+            G4int n_select=-1);
+
+    // Called by each worker as it runs out of events.
+    virtual G4int SetUpNEvents(G4Event* event, G4SeedsQueue* seeds_queue,
+            G4bool reseed_required=true);
+
+    void SetChunkTime(G4double seconds) {
+        chunk_time = seconds;
+    };
+
+    void SetMaximumChunk(G4int events) {
+        maximum_chunk = events;
+    };
+
+    // Wall time of one event on one worker, averaged over recent chunks.
+    G4double GetEventCost() {
+        return event_cost;
+    };
+
+  private:
+    G4int ChunkSize(G4int remaining);
+
+    G4double chunk_time;
+    G4int maximum_chunk;
+
+    // Running average over chunks, zero until the first one is back.
+    G4double event_cost;
+
+    // When each worker took its last chunk, negative if it has none, and
+    // how many events there were in it.
+    std::vector<G4double> chunk_start;
+    std::vector<G4int> chunk_events;
+
+    G4Timer timer;
+    boost::mutex mutex;
+};
+
+#endif // G4MULTITHREADED
+
+#endif
@@ -0,0 +1,65 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef SCORINGDETECTOR_HH
+#define SCORINGDETECTOR_HH
+
+#include "SensitiveDetector.hh"
+#include "ScoringQuantities.hh"
+
+
+// A voxel detector with its quantity compiled in, so ProcessHits is the
+// voxel lookup and the adds the quantity needs, nothing else.
+template <class Quantity>
+class ScoringDetector : public SensitiveDetector {
+  public:
+    ScoringDetector(const G4String& name, G4bool tiled=false,
+            SensitiveDetector* master=NULL)
+        : SensitiveDetector(name, Quantity::grids, Quantity::energysq,
+                Quantity::counts, tiled, master) {
+    };
+
+    G4bool ProcessHits(G4Step* step, G4TouchableHistory*) {
+        if (!Quantity::Accept(step))
+            return false;
+
+        if (debug)
+            PrintHit(step);
+
+        G4int index;
+        G4double inverse_mass;
+        if (!Locate(step, index, inverse_mass))
+            return false;
+
+        Quantity::Score(this, step, index, inverse_mass);
+        return true;
+    };
+
+    G4String GetHistogramName(G4int i) {
+        return Quantity::Name(i);
+    };
+
+    G4bool ScoresDose() {
+        return Quantity::dose;
+    };
+};
+
+#endif /* SCORINGDETECTOR_HH */
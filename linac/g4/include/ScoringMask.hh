@@ -0,0 +1,89 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef SCORINGMASK_HH
+#define SCORINGMASK_HH
+
+#include "globals.hh"
+
+#include "pyublas/numpy.hpp"
+
+#include <stdint.h>
+#include <vector>
+
+
+// Which voxels of a grid are scored, from a label volume of the same
+// shape: zero is outside, any other label is scored. The scored voxels
+// are numbered in order, so a grid can hold them alone.
+class ScoringMask {
+  public:
+    ScoringMask(G4int x, G4int y, G4int z, const std::vector<uint8_t>& labels);
+
+    // One bit per voxel with a running count every 64, so whether a voxel
+    // is scored and where it goes come from the same word.
+    G4bool Contains(G4int index) {
+        return (bits[index >> 6] >> (index & 63)) & 1;
+    };
+
+    G4int GetCompactIndex(G4int index) {
+        uint64_t below = bits[index >> 6] & ((((uint64_t) 1) << (index & 63)) - 1);
+        return ranks[index >> 6] + __builtin_popcountll(below);
+    };
+
+    // Flat index into the full grid of each scored voxel.
+    const std::vector<G4int>& GetVoxels() {
+        return voxels;
+    };
+
+    G4int GetVoxelCount() {
+        return voxels.size();
+    };
+
+    G4int GetSize() {
+        return labels.size();
+    };
+
+    uint8_t GetLabel(G4int index) {
+        return labels[index];
+    };
+
+    // A histogram of the scored voxels spread back out to the shape of
+    // the grid, zero outside the mask.
+    pyublas::numpy_vector<G4double> Expand(pyublas::numpy_vector<G4double> compact);
+
+    // Flat indices into the scored voxels turned into flat indices into
+    // the full grid, in place.
+    void ExpandIndices(pyublas::numpy_vector<int64_t> indices);
+
+    pyublas::numpy_vector<uint8_t> GetLabels();
+
+  private:
+    G4int x_dim;
+    G4int y_dim;
+    G4int z_dim;
+
+    std::vector<uint8_t> labels;
+    std::vector<uint64_t> bits;
+    std::vector<G4int> ranks;
+    std::vector<G4int> voxels;
+};
+
+#endif // SCORINGMASK_HH
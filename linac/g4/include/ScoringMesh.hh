@@ -0,0 +1,139 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef _SCORINGMESH_HH
+#define	_SCORINGMESH_HH
+
+#include "DoseGrid.hh"
+
+#include "G4VSensitiveDetector.hh"
+#include "G4ThreeVector.hh"
+#include "globals.hh"
+
+#include "boost/python.hpp"
+#include "pyublas/numpy.hpp"
+
+#include <vector>
+
+class G4Step;
+class G4TouchableHistory;
+class G4HCofThisEvent;
+
+
+// A tally placed in the parallel world, binned independently of the mass
+// geometry underneath it. A box is binned in x, y and z, so a plane is a
+// thin box with one bin in z and a line a narrow box with one bin in x
+// and y. A cylinder is binned in r, phi and z.
+class ScoringMesh : public G4VSensitiveDetector {
+  public:
+    enum Shape {
+        kBox,
+        kCylinder
+    };
+
+    enum Quantity {
+        kDose,
+        kEnergyDeposit
+    };
+
+    // The size is the full side lengths of a box, or the radius, unused,
+    // and length of a cylinder.
+    ScoringMesh(const G4String& name, Shape shape, G4ThreeVector size,
+            G4int x_bins, G4int y_bins, G4int z_bins,
+            DoseGrid* dose_grid=NULL);
+    virtual ~ScoringMesh();
+
+    void Initialize(G4HCofThisEvent*);
+    G4bool ProcessHits(G4Step*, G4TouchableHistory*);
+    void EndOfEvent(G4HCofThisEvent*);
+    void clear();
+    void PrintAll();
+
+  public:
+    // A mesh for a worker thread, scoring into the grid of this one.
+    ScoringMesh* MakeWorker();
+
+    void SetQuantity(Quantity quantity) {
+        this->quantity = quantity;
+    };
+
+    Shape GetShape() {
+        return shape;
+    };
+
+    G4ThreeVector GetSize() {
+        return size;
+    };
+
+    pyublas::numpy_vector<G4double> GetEnergyHistogram() {
+        return this->dose_grid->GetEnergy();
+    }
+
+    pyublas::numpy_vector<G4double> GetEnergySqHistogram() {
+        return this->dose_grid->GetEnergySq();
+    }
+
+    pyublas::numpy_vector<G4double> GetCountsHistogram() {
+        return this->dose_grid->GetCounts();
+    }
+
+    pyublas::numpy_vector<G4double> GetUncertaintyHistogram() {
+        return this->dose_grid->GetUncertainty();
+    }
+
+    int64_t GetHistories() {
+        return this->dose_grid->GetHistories();
+    }
+
+    DoseGrid* GetDoseGrid() {
+        return this->dose_grid;
+    }
+
+  private:
+    // The bin `position` falls in, false if it is outside the mesh.
+    G4bool Locate(const G4ThreeVector& position, G4int& x_index, G4int& index);
+
+    // Pieces to cut a step from `pre` to `post` into so each lies in
+    // about one bin, at most a quarter of a bin each.
+    G4int GetSegments(const G4ThreeVector& pre, const G4ThreeVector& post);
+
+  private:
+    Shape shape;
+    Quantity quantity;
+    G4ThreeVector size;
+
+    G4int x_bins;
+    G4int y_bins;
+    G4int z_bins;
+
+    // Bins per mm along each axis, or per mm of radius, per radian and
+    // per mm for a cylinder.
+    G4ThreeVector bin_density;
+
+    // One over the volume of a bin, only ever varying with the radius.
+    std::vector<G4double> inverse_volumes;
+
+    DoseGrid* dose_grid;
+    DoseGridBuffer* dose_buffer;
+    G4bool owns_dose_grid;
+};
+
+#endif	/* _SCORINGMESH_HH */
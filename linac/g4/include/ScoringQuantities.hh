@@ -0,0 +1,202 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef SCORINGQUANTITIES_HH
+#define SCORINGQUANTITIES_HH
+
+#include "SensitiveDetector.hh"
+
+#include "G4Step.hh"
+#include "G4StepPoint.hh"
+#include "G4Track.hh"
+#include "G4ParticleDefinition.hh"
+#include "globals.hh"
+
+
+// What a ScoringDetector scores, one struct per quantity. `Accept` turns
+// steps away before their voxel is looked up, `Score` adds one step to
+// the voxel at `index` of each grid the quantity uses. The flags say
+// which sums those grids keep besides the plain sum, the rest are never
+// allocated or touched, and whether the grids add up to the dose.
+
+// Dose alone, all most runs need.
+struct DoseQuantity {
+    static const G4int grids = 1;
+    static const G4bool energysq = false;
+    static const G4bool counts = false;
+    static const G4bool dose = true;
+
+    static G4String Name(G4int) {
+        return "dose";
+    };
+
+    static G4bool Accept(const G4Step* step) {
+        return step->GetTotalEnergyDeposit() > 0;
+    };
+
+    static void Score(SensitiveDetector* detector, const G4Step* step,
+            G4int index, G4double inverse_mass) {
+        detector->dose_grid->Add<false, false>(detector->dose_buffers[0], index,
+                step->GetTotalEnergyDeposit()*inverse_mass, 0);
+    };
+};
+
+
+// Dose with the history by history energy squared for its uncertainty,
+// and the summed track weight.
+struct DoseUncertaintyQuantity {
+    static const G4int grids = 1;
+    static const G4bool energysq = true;
+    static const G4bool counts = true;
+    static const G4bool dose = true;
+
+    static G4String Name(G4int) {
+        return "dose";
+    };
+
+    static G4bool Accept(const G4Step* step) {
+        return step->GetTotalEnergyDeposit() > 0;
+    };
+
+    static void Score(SensitiveDetector* detector, const G4Step* step,
+            G4int index, G4double inverse_mass) {
+        detector->dose_grid->Add<true, true>(detector->dose_buffers[0], index,
+                step->GetTotalEnergyDeposit()*inverse_mass,
+                step->GetTrack()->GetWeight());
+    };
+};
+
+
+// Track length fluence of every particle. The whole step goes to the
+// voxel it ends in, exact for the CT where every voxel is a volume, and
+// an approximation on the phantom where they are not.
+struct FluenceQuantity {
+    static const G4int grids = 1;
+    static const G4bool energysq = false;
+    static const G4bool counts = false;
+    static const G4bool dose = false;
+
+    static G4String Name(G4int) {
+        return "fluence";
+    };
+
+    static G4bool Accept(const G4Step* step) {
+        return step->GetStepLength() > 0;
+    };
+
+    static void Score(SensitiveDetector* detector, const G4Step* step,
+            G4int index, G4double) {
+        detector->dose_grid->Add<false, false>(detector->dose_buffers[0], index,
+                step->GetStepLength()*detector->inverse_volume, 0);
+    };
+};
+
+
+// Track length estimate of the collision kerma of photons, from the mass
+// energy absorption coefficients given to the detector.
+struct KermaQuantity {
+    static const G4int grids = 1;
+    static const G4bool energysq = false;
+    static const G4bool counts = false;
+    static const G4bool dose = false;
+
+    static G4String Name(G4int) {
+        return "kerma";
+    };
+
+    static G4bool Accept(const G4Step* step) {
+        return step->GetTrack()->GetDefinition()->GetPDGEncoding() == 22
+            && step->GetStepLength() > 0;
+    };
+
+    static void Score(SensitiveDetector* detector, const G4Step* step,
+            G4int index, G4double) {
+        G4double energy = step->GetPreStepPoint()->GetKineticEnergy();
+
+        detector->dose_grid->Add<false, false>(detector->dose_buffers[0], index,
+                step->GetStepLength()*detector->inverse_volume
+                    *energy*detector->GetMassEnergyAbsorption(energy), 0);
+    };
+};
+
+
+// Dose split by the particle depositing it.
+struct ParticleDoseQuantity {
+    static const G4int grids = 4;
+    static const G4bool energysq = false;
+    static const G4bool counts = false;
+    static const G4bool dose = true;
+
+    static G4String Name(G4int i) {
+        const char* names[] = {"dose_gamma", "dose_electron", "dose_positron", "dose_other"};
+        return names[i];
+    };
+
+    static G4bool Accept(const G4Step* step) {
+        return step->GetTotalEnergyDeposit() > 0;
+    };
+
+    static void Score(SensitiveDetector* detector, const G4Step* step,
+            G4int index, G4double inverse_mass) {
+        G4int grid;
+        switch (step->GetTrack()->GetDefinition()->GetPDGEncoding()) {
+            case 22: grid = 0; break;
+            case 11: grid = 1; break;
+            case -11: grid = 2; break;
+            default: grid = 3;
+        }
+
+        detector->dose_grids[grid]->Add<false, false>(detector->dose_buffers[grid],
+                index, step->GetTotalEnergyDeposit()*inverse_mass, 0);
+    };
+};
+
+
+// Dose averaged LET of charged particles. The first grid sums the energy
+// deposited times the LET of the step, the second the energy deposited,
+// their ratio is the dose averaged LET.
+struct LETQuantity {
+    static const G4int grids = 2;
+    static const G4bool energysq = false;
+    static const G4bool counts = false;
+    static const G4bool dose = false;
+
+    static G4String Name(G4int i) {
+        return i == 0 ? "let_weighted" : "energy";
+    };
+
+    static G4bool Accept(const G4Step* step) {
+        return step->GetTotalEnergyDeposit() > 0 && step->GetStepLength() > 0
+            && step->GetTrack()->GetDefinition()->GetPDGCharge() != 0;
+    };
+
+    static void Score(SensitiveDetector* detector, const G4Step* step,
+            G4int index, G4double) {
+        G4double energy_deposit = step->GetTotalEnergyDeposit();
+
+        detector->dose_grids[0]->Add<false, false>(detector->dose_buffers[0], index,
+                energy_deposit*energy_deposit/step->GetStepLength(), 0);
+        detector->dose_grids[1]->Add<false, false>(detector->dose_buffers[1], index,
+                energy_deposit, 0);
+    };
+};
+
+#endif /* SCORINGQUANTITIES_HH */
@@ -23,13 +23,22 @@
 #define	_SensitiveDETECTOR_HH
 
 
+#include "DoseGrid.hh"
+#include "ScoringMask.hh"
+
 #include "G4VSensitiveDetector.hh"
 #include "G4VUserDetectorConstruction.hh"
+#include "G4Step.hh"
+#include "G4StepPoint.hh"
+#include "G4Track.hh"
+#include "G4VTouchable.hh"
+#include "G4Material.hh"
 #include "globals.hh"
 
 #include "boost/python.hpp"
 #include "pyublas/numpy.hpp"
 
+#include <stdint.h>
 #include <vector>
 
 class G4Step;
@@ -37,13 +46,20 @@ class G4TouchableHistory;
 class G4HCofThisEvent;
 class DetectorConstruction;
 
+// Finds the voxel of each step and keeps the dose grids it is scored
+// into. What is scored is up to the ScoringDetector made by `Create`.
 class SensitiveDetector : public G4VSensitiveDetector {
 public:
-    SensitiveDetector(const G4String& name);
+    // A detector scoring `quantity`, one of "dose", "dose_uncertainty",
+    // "fluence", "kerma", "particle_dose" or "let". Worker detectors
+    // score into the grids of `master`, without one the detector makes
+    // its own, tiled if asked.
+    static SensitiveDetector* Create(const G4String& name, const G4String& quantity,
+            G4bool tiled=false, SensitiveDetector* master=NULL);
+
     virtual ~SensitiveDetector();
 
     void Initialize(G4HCofThisEvent*);
-    G4bool ProcessHits(G4Step*, G4TouchableHistory*);
     void EndOfEvent(G4HCofThisEvent*);
     void clear();
     void PrintAll();
@@ -74,30 +90,202 @@ public:
         z_res = z;
 
         volume = x * y * z;
+        inverse_volume = 1. / volume;
+    };
+
+    // Score on a voxel data parameterisation: the voxel comes from the
+    // replica numbers of the touchable, and its mass from the inverse
+    // mass table computed when the geometry was built, indexed like the
+    // voxel data rather than the grid. The grid takes the shape of the
+    // voxel data, so this must be set before the first event.
+    void SetVoxelData(G4int x, G4int y, G4int z,
+            const std::vector<G4double>& inverse_masses);
+
+    // Depths in the touchable history of the x, y and z replicas, by
+    // default the nested layout of G4VoxelDataParameterisation.
+    void SetReplicaDepths(G4int x, G4int y, G4int z) {
+        x_depth = x;
+        y_depth = y;
+        z_depth = z;
+    };
+
+    // Score only the voxels with a non zero label, `labels` shaped like
+    // the grid. The grids then hold the scored voxels alone, and are
+    // spread back out to the full shape when read. Empty to score every
+    // voxel again. Must be set before the first event.
+    void SetScoringMask(const std::vector<uint8_t>& labels);
+
+    ScoringMask* GetScoringMask() {
+        return this->mask;
+    };
+
+    // Photon mass energy absorption coefficients against energy, for
+    // kerma. Interpolated log-log, in Geant4 units.
+    void SetMassEnergyAbsorption(const std::vector<G4double>& energies,
+            const std::vector<G4double>& coefficients);
+
+    G4double GetMassEnergyAbsorption(G4double energy);
+
+    void SetAtomic(G4bool atomic);
+    void SetTiled(G4bool tiled);
+    void Reduce();
+    void Zero();
+
+    // Keep the histograms in .npy files starting with `prefix`, see
+    // DoseGrid::Map. Mapped at the first event, once the grid has its
+    // final shape.
+    void SetCheckpoint(G4String prefix) {
+        if (!dose_buffers.empty() && prefix != "") {
+            G4cout << "SensitiveDetector::SetCheckpoint: already scoring, "
+                   << "the histograms stay in memory." << G4endl;
+        }
+        this->checkpoint_prefix = prefix;
     };
 
-    pyublas::numpy_vector<float> GetEnergyHistogram() {
-        return this->energy_histogram;
+    void Checkpoint();
+
+    pyublas::numpy_vector<G4double> GetEnergyHistogram() {
+        return Expanded(this->dose_grid->GetEnergy());
     }
 
-    pyublas::numpy_vector<float> GetEnergySqHistogram() {
-        return this->energysq_histogram;
+    pyublas::numpy_vector<G4double> GetEnergySqHistogram() {
+        return Expanded(this->dose_grid->GetEnergySq());
     }
 
-    pyublas::numpy_vector<float> GetCountsHistogram() {
-        return this->counts_histogram;
+    pyublas::numpy_vector<G4double> GetCountsHistogram() {
+        return Expanded(this->dose_grid->GetCounts());
     }
 
-public:
+    pyublas::numpy_vector<G4double> GetUncertaintyHistogram() {
+        return Expanded(this->dose_grid->GetUncertainty());
+    }
+
+    G4double GetRegionUncertainty(G4double threshold) {
+        return this->dose_grid->GetRegionUncertainty(threshold);
+    }
+
+    boost::python::tuple GetSparseHistograms() {
+        boost::python::tuple sparse = this->dose_grid->GetSparse();
+        if (mask)
+            mask->ExpandIndices(boost::python::extract<pyublas::numpy_vector<int64_t> >(sparse[0]));
+
+        return sparse;
+    }
+
+    // Quantities scored into more than one grid, dose by particle type
+    // for example, have a histogram and a name for each.
+    G4int GetHistogramCount() {
+        return this->dose_grids.size();
+    }
+
+    pyublas::numpy_vector<G4double> GetHistogram(G4int i) {
+        return Expanded(this->dose_grids[i]->GetEnergy());
+    }
+
+    virtual G4String GetHistogramName(G4int i) = 0;
+
+    // True if the histograms are parts of the dose that add up to it.
+    virtual G4bool ScoresDose() = 0;
+
+    DoseGrid* GetDoseGrid() {
+        return this->dose_grid;
+    }
+
+protected:
+    SensitiveDetector(const G4String& name, G4int grids, G4bool energysq,
+            G4bool counts, G4bool tiled, SensitiveDetector* master);
+
+    // The grid index and inverse mass of the voxel the step scores in,
+    // false if it is outside the grid.
+    G4bool Locate(const G4Step* step, G4int& index, G4double& inverse_mass) {
+        if (use_replica_numbers) {
+            // The pre step point is in the voxel the energy went into,
+            // its replica numbers index the grid directly wherever the
+            // voxel data has been placed.
+            const G4VTouchable* voxel = step->GetPreStepPoint()->GetTouchable();
+            G4int x_index = voxel->GetReplicaNumber(x_depth);
+            G4int y_index = voxel->GetReplicaNumber(y_depth);
+            G4int z_index = voxel->GetReplicaNumber(z_depth);
+            G4int flat = (x_index*y_dim + y_index)*z_dim + z_index;
+
+            if (mask) {
+                if (!mask->Contains(flat))
+                    return false;
+                index = mask->GetCompactIndex(flat);
+            } else {
+                index = dose_grid->GetIndex(x_index, y_index, z_index);
+            }
+
+            // The masses are laid out like the voxel data, `index` is
+            // tiled or compacted and only good for the grids.
+            inverse_mass = inverse_masses[flat];
+            return true;
+        }
+
+        const G4Track* track = step->GetTrack();
+        G4ThreeVector position = track->GetPosition();
+
+        G4int x_index = (G4int) std::floor((position.x() + (x_dim/2. * x_res)) / x_res);
+        G4int y_index = (G4int) std::floor((position.y() + (y_dim/2. * y_res)) / y_res);
+        G4int z_index = (G4int) std::floor((position.z() + (z_dim/2. * z_res)) / z_res);
+
+        if (x_index < x_min || x_index >= x_max)
+            return false;
+        if (y_index < y_min || y_index >= y_max)
+            return false;
+        if (z_index < z_min || z_index >= z_max)
+            return false;
 
-    pyublas::numpy_vector<float> energy_histogram;
-    pyublas::numpy_vector<float> energysq_histogram;
-    pyublas::numpy_vector<float> counts_histogram;
+        x_index -= x_min;
+        y_index -= y_min;
+        z_index -= z_min;
+
+        if (mask) {
+            G4int flat = (x_index*(y_max - y_min) + y_index)*(z_max - z_min) + z_index;
+            if (!mask->Contains(flat))
+                return false;
+            index = mask->GetCompactIndex(flat);
+        } else {
+            index = dose_grid->GetIndex(x_index, y_index, z_index);
+        }
+        inverse_mass = inverse_volume / track->GetMaterial()->GetDensity();
+        return true;
+    };
+
+    // Everything known about a step, kept out of ProcessHits.
+    void PrintHit(const G4Step* step);
+
+    // Remake the grids this detector owns for its current shape and mask,
+    // keeping their scoring flags.
+    void ResizeGrids();
+
+    pyublas::numpy_vector<G4double> Expanded(pyublas::numpy_vector<G4double> histogram) {
+        return mask ? mask->Expand(histogram) : histogram;
+    };
+
+public:
+    DoseGrid* dose_grid;
+    std::vector<DoseGrid*> dose_grids;
+    std::vector<DoseGridBuffer*> dose_buffers;
+    G4bool owns_dose_grid;
 
     //G4double voxel_mass;
     G4double volume;
+    G4double inverse_volume;
     G4bool debug;
 
+    G4bool use_replica_numbers;
+    G4int x_depth;
+    G4int y_depth;
+    G4int z_depth;
+    std::vector<G4double> inverse_masses;
+    ScoringMask* mask;
+
+    G4String checkpoint_prefix;
+
+    std::vector<G4double> log_energies;
+    std::vector<G4double> log_coefficients;
+
     G4int x_dim;
     G4int y_dim;
     G4int z_dim;
@@ -116,4 +304,3 @@ public:
 
 
 #endif	/* _SensitiveDETECTOR_HH */
-
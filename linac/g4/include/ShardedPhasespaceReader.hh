@@ -0,0 +1,63 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef SHARDEDPHASESPACEREADER_HH
+#define SHARDEDPHASESPACEREADER_HH
+
+#include "PhasespaceReader.hh"
+
+#include <vector>
+
+
+// Reads the shards written by each worker for one phasespace as if they
+// were a single file, one shard after another.
+class ShardedPhasespaceReader : public PhasespaceReader {
+  public:
+    ShardedPhasespaceReader(std::vector<G4String> shards);
+    virtual ~ShardedPhasespaceReader();
+
+    G4bool Read(PhasespaceRecord& record);
+    G4bool Seek(int64_t index);
+    int64_t GetRecordCount();
+    int64_t GetSkippedCount();
+
+    // The file worker `shard` writes for the phasespace `filename`, the
+    // shard number goes in front of the extension so the format can
+    // still be told from the name.
+    static G4String GetShardFilename(G4String filename, G4int shard);
+
+    // Shards of `filename` on disk, numbered from zero without gaps. If
+    // one is missing and later ones are there, reports the gap and
+    // returns none of them.
+    static std::vector<G4String> FindShards(G4String filename);
+
+    // Concatenate the shards of `filename` into `filename` itself, with
+    // a combined header and index. Compressed shards are merged into a
+    // compressed file with their encoding, at the default level. Removes
+    // the shards if asked to.
+    static G4bool Merge(G4String filename, G4bool remove_shards=false);
+
+  private:
+    std::vector<PhasespaceReader*> readers;
+    unsigned int current_reader;
+};
+
+#endif /* SHARDEDPHASESPACEREADER_HH */
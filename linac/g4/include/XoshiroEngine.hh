@@ -0,0 +1,94 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef XOSHIROENGINE_HH
+#define XOSHIROENGINE_HH
+
+#include "CLHEP/Random/RandomEngine.h"
+
+#include <stdint.h>
+#include <string>
+
+
+// The xoshiro256** generator as a CLHEP engine: four words of state and
+// a handful of shifts and adds per number, many times cheaper than
+// Ranlux. Seeded through SplitMix64, so the small, neighbouring seeds
+// each event is given still start far apart.
+class XoshiroEngine : public CLHEP::HepRandomEngine {
+  public:
+    XoshiroEngine(long seed=19780503);
+    virtual ~XoshiroEngine();
+
+    // The top 53 bits, in (0, 1) like the other engines.
+    virtual double flat() {
+        uint64_t x;
+        do {
+            x = Next() >> 11;
+        } while (x == 0);
+
+        return x * (1.0 / 9007199254740992.0);
+    };
+
+    virtual void flatArray(const int size, double* vect);
+
+    virtual void setSeed(long seed, int);
+
+    // Every seed up to a zero, the second argument is ignored.
+    virtual void setSeeds(const long* seeds, int);
+
+    virtual void saveStatus(const char filename[]="Xoshiro.conf") const;
+    virtual void restoreStatus(const char filename[]="Xoshiro.conf");
+    virtual void showStatus() const;
+
+    virtual std::string name() const {
+        return "XoshiroEngine";
+    };
+
+  private:
+    uint64_t Next() {
+        uint64_t result = Rotate(state[1]*5, 7)*9;
+        uint64_t t = state[1] << 17;
+
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = Rotate(state[3], 45);
+
+        return result;
+    };
+
+    static uint64_t Rotate(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    };
+
+    static uint64_t SplitMix(uint64_t& x) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    };
+
+    uint64_t state[4];
+};
+
+#endif /* XOSHIROENGINE_HH */
@@ -23,22 +23,36 @@
 #include "PhysicsList.hh"
 #include "SteppingAction.hh"
 #include "EventAction.hh"
+#include "RunAction.hh"
 #include "PrimaryGeneratorAction.hh"
+#include "ActionInitialization.hh"
+#include "SchedulingRunManager.hh"
 
 #include "Phasespace.hh"
 #include "PhasespaceRecord.hh"
+#include "ShardedPhasespaceReader.hh"
+#include "ScoringMesh.hh"
+#include "DoseGrid.hh"
+#include "RandomEngine.hh"
 
 // GEANT4 //
 #include "G4LogicalVolume.hh"
+#include "G4RunManager.hh"
 #include "G4UImanager.hh"
 #include "G4VisManager.hh"
 #include "G4UIExecutive.hh"
 #include "G4VisExecutive.hh"
 
+#ifdef G4MULTITHREADED
+#include "G4MTRunManager.hh"
+#endif
+
 // BOOST/PYTHON //
 #include "boost/python.hpp"
 #include "pyublas/numpy.hpp"
 
+#include <cstdlib>
+
 
 void ShowGUI(char* macro)
 {
@@ -58,6 +72,99 @@ void ShowGUI(char* macro)
 };
 
 
+bool MergePhasespaceShards(char* filename, bool remove_shards)
+{
+    return ShardedPhasespaceReader::Merge(filename, remove_shards);
+};
+
+
+void CreateRunManager()
+{
+    // Importing Geant4 makes a sequential run manager unless there is one
+    // already, and there can only ever be one. This runs first, as this
+    // module is imported, so LINAC_THREADS above one gets a multithreaded
+    // run manager.
+    if (G4RunManager::GetRunManager())
+        return;
+
+    const char* threads = std::getenv("LINAC_THREADS");
+#ifdef G4MULTITHREADED
+    if (threads && std::atoi(threads) > 1) {
+        G4MTRunManager* mt_run_manager = new SchedulingRunManager();
+        mt_run_manager->SetNumberOfThreads(std::atoi(threads));
+        return;
+    }
+#else
+    if (threads && std::atoi(threads) > 1)
+        G4cout << "Geant4 was built without multithreading, LINAC_THREADS ignored." << G4endl;
+#endif
+
+    new G4RunManager();
+};
+
+
+G4bool IsMultithreaded()
+{
+#ifdef G4MULTITHREADED
+    return dynamic_cast<G4MTRunManager*>(G4RunManager::GetRunManager()) != NULL;
+#else
+    return false;
+#endif
+};
+
+
+G4RunManager* GetRunManager(G4int threads)
+{
+    // A multithreaded run manager can still change its number of threads
+    // until the first run, a sequential one is left as it is.
+#ifdef G4MULTITHREADED
+    G4MTRunManager* mt_run_manager =
+        dynamic_cast<G4MTRunManager*>(G4RunManager::GetRunManager());
+    if (mt_run_manager)
+        mt_run_manager->SetNumberOfThreads(threads);
+#endif
+
+    return G4RunManager::GetRunManager();
+};
+
+
+G4int GetNumberOfThreads()
+{
+#ifdef G4MULTITHREADED
+    G4MTRunManager* mt_run_manager =
+        dynamic_cast<G4MTRunManager*>(G4RunManager::GetRunManager());
+    if (mt_run_manager)
+        return mt_run_manager->GetNumberOfThreads();
+#endif
+
+    return 1;
+};
+
+
+// False if the run manager does not hand out events in chunks.
+G4bool SetChunkTime(G4double seconds)
+{
+#ifdef G4MULTITHREADED
+    SchedulingRunManager* run_manager =
+        dynamic_cast<SchedulingRunManager*>(G4RunManager::GetRunManager());
+    if (run_manager) {
+        run_manager->SetChunkTime(seconds);
+        return true;
+    }
+#endif
+    return false;
+};
+
+
+void SetActionInitialization(PrimaryGeneratorAction* primary_generator)
+{
+#ifdef G4MULTITHREADED
+    G4RunManager::GetRunManager()->SetUserInitialization(
+            new ActionInitialization(primary_generator));
+#endif
+};
+
+
 using namespace boost::python;
 
 
@@ -69,7 +176,19 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(_SetupHead,
 
 
 BOOST_PYTHON_MODULE(libg4) {
+    // Before Geant4 is imported, which the base classes below need.
+    CreateRunManager();
+    import("Geant4");
+
     def("ShowGUI", ShowGUI);
+    def("MergePhasespaceShards", MergePhasespaceShards);
+    def("UseRandomEngine", RandomEngine::Use);
+    def("BenchmarkRandomEngine", RandomEngine::Benchmark);
+    def("GetRunManager", GetRunManager, return_value_policy<reference_existing_object>());
+    def("IsMultithreaded", IsMultithreaded);
+    def("GetNumberOfThreads", GetNumberOfThreads);
+    def("SetChunkTime", SetChunkTime);
+    def("SetActionInitialization", SetActionInitialization);
     
     class_<DetectorConstruction, DetectorConstruction*,
         bases<G4VUserDetectorConstruction>, boost::noncopyable>
@@ -78,6 +197,13 @@ BOOST_PYTHON_MODULE(libg4) {
         .def("AddPhasespace", &DetectorConstruction::AddPhasespace,
             return_internal_reference<>())
         .def("RemovePhasespace", &DetectorConstruction::RemovePhasespace)
+        .def("SetPhasespaceCompression", &DetectorConstruction::SetPhasespaceCompression)
+        .def("SetPhasespaceShard", &DetectorConstruction::SetPhasespaceShard)
+        .def("AddScoringMesh", &DetectorConstruction::AddScoringMesh,
+            return_internal_reference<>())
+        .def("GetScoringMesh", &DetectorConstruction::GetScoringMesh,
+            return_internal_reference<>())
+        .def("RemoveScoringMesh", &DetectorConstruction::RemoveScoringMesh)
         .def("AddCADComponent", &DetectorConstruction::AddCADComponent,
             return_internal_reference<>())
         .def("AddTube", &DetectorConstruction::AddTube,
@@ -90,8 +216,27 @@ BOOST_PYTHON_MODULE(libg4) {
         .def("GetEnergyHistogram", &DetectorConstruction::GetEnergyHistogram)
         .def("GetEnergySqHistogram", &DetectorConstruction::GetEnergySqHistogram)
         .def("GetCountsHistogram", &DetectorConstruction::GetCountsHistogram)
+        .def("GetUncertaintyHistogram", &DetectorConstruction::GetUncertaintyHistogram)
+        .def("GetRegionUncertainty", &DetectorConstruction::GetRegionUncertainty)
+        .def("GetHistories", &DetectorConstruction::GetHistories)
+        .def("GetSparseHistograms", &DetectorConstruction::GetSparseHistograms)
+        .def("SetScoringMask", &DetectorConstruction::SetScoringMask)
+        .def("SetStructures", &DetectorConstruction::SetStructures)
+        .def("GetDoseStatistics", &DetectorConstruction::GetDoseStatistics)
         .def("GetCTOrigin", &DetectorConstruction::GetCTOrigin)
         .def("ZeroHistograms", &DetectorConstruction::ZeroHistograms)
+        .def("ReduceHistograms", &DetectorConstruction::ReduceHistograms)
+        .def("SetReduceEachRun", &DetectorConstruction::SetReduceEachRun)
+        .def("SetAtomicScoring", &DetectorConstruction::SetAtomicScoring)
+        .def("SetTiledScoring", &DetectorConstruction::SetTiledScoring)
+        .def("SetScoringQuantity", &DetectorConstruction::SetScoringQuantity)
+        .def("SetCheckpoint", &DetectorConstruction::SetCheckpoint)
+        .def("SetMassEnergyAbsorption", &DetectorConstruction::SetMassEnergyAbsorption)
+        .def("GetHistogramCount", &DetectorConstruction::GetHistogramCount)
+        .def("GetHistogramName", &DetectorConstruction::GetHistogramName)
+        .def("GetHistogram", &DetectorConstruction::GetHistogram)
+        .def("GetDoseGrid", &DetectorConstruction::GetDoseGrid,
+            return_internal_reference<>())
         .def("UseCT", &DetectorConstruction::UseCT)
         .def("SetupCT", &DetectorConstruction::SetupCT)
         .def("UseArray", &DetectorConstruction::UseArray)
@@ -109,6 +254,27 @@ BOOST_PYTHON_MODULE(libg4) {
         .def("SetAsStopKillSheild", &DetectorConstruction::SetAsStopKillSheild)
         ;   // End DetectorConstruction
 
+    class_<ScoringMesh, ScoringMesh*, boost::noncopyable>
+        ("ScoringMesh", "scoring mesh", no_init)
+        .def("GetEnergyHistogram", &ScoringMesh::GetEnergyHistogram)
+        .def("GetEnergySqHistogram", &ScoringMesh::GetEnergySqHistogram)
+        .def("GetCountsHistogram", &ScoringMesh::GetCountsHistogram)
+        .def("GetUncertaintyHistogram", &ScoringMesh::GetUncertaintyHistogram)
+        .def("GetHistories", &ScoringMesh::GetHistories)
+        .def("GetDoseGrid", &ScoringMesh::GetDoseGrid,
+            return_internal_reference<>())
+        ;   // End ScoringMesh
+
+    class_<DoseGrid, DoseGrid*, boost::noncopyable>
+        ("DoseGrid", "dose grid", no_init)
+        .def("GetEnergy", &DoseGrid::GetEnergy)
+        .def("GetEnergySq", &DoseGrid::GetEnergySq)
+        .def("GetCounts", &DoseGrid::GetCounts)
+        .def("GetHistories", &DoseGrid::GetHistories)
+        .def("Merge", &DoseGrid::Merge)
+        .def("Zero", &DoseGrid::Zero)
+        ;   // End DoseGrid
+
     class_<PhysicsList, PhysicsList*,
         //bases<G4VModularPhysicsList> >
         bases<G4VUserPhysicsList> >
@@ -126,6 +292,11 @@ BOOST_PYTHON_MODULE(libg4) {
         ("EventAction", "EventAction")
         ;   // End EventAction
 
+    class_<RunAction, RunAction*,
+        bases<G4UserRunAction> >
+        ("RunAction", "RunAction")
+        ;   // End RunAction
+
     class_<PrimaryGeneratorAction, PrimaryGeneratorAction*,
         bases<G4VUserPrimaryGeneratorAction>, boost::noncopyable>
         ("PrimaryGeneratorAction", "PrimaryGeneratorAction")
@@ -139,6 +310,16 @@ BOOST_PYTHON_MODULE(libg4) {
         .def("SetRedistribute", &PrimaryGeneratorAction::SetRedistribute)
         .def("SetGantryRotation", &PrimaryGeneratorAction::SetGantryRotation)
         .def("SetPhasespaceLimits", &PrimaryGeneratorAction::SetPhasespaceLimits)
+        .def("SetMemoryMapped", &PrimaryGeneratorAction::SetMemoryMapped)
+        .def("PrintSourceStatistics", &PrimaryGeneratorAction::PrintSourceStatistics)
+        .def("SetPrefetchDepth", &PrimaryGeneratorAction::SetPrefetchDepth)
+        .def("SetPartition", &PrimaryGeneratorAction::SetPartition)
+        .def("SetRecordRange", &PrimaryGeneratorAction::SetRecordRange)
+        .def("SetBatchRecycling", &PrimaryGeneratorAction::SetBatchRecycling)
+        .def("IsSourceExhausted", &PrimaryGeneratorAction::IsSourceExhausted)
+        .def("GetSourceRecordCount", &PrimaryGeneratorAction::GetSourceRecordCount)
+        .def("SetEventSeeding", &PrimaryGeneratorAction::SetEventSeeding)
+        .def("DisableEventSeeding", &PrimaryGeneratorAction::DisableEventSeeding)
         ;   // End PrimaryGeneratorAction
 }
 
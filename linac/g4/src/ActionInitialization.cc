@@ -0,0 +1,54 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifdef G4MULTITHREADED
+
+#include "ActionInitialization.hh"
+#include "PrimaryGeneratorAction.hh"
+#include "EventAction.hh"
+#include "SteppingAction.hh"
+#include "RunAction.hh"
+
+
+ActionInitialization::ActionInitialization(PrimaryGeneratorAction* primary_generator)
+{
+    this->primary_generator = primary_generator;
+}
+
+ActionInitialization::~ActionInitialization()
+{
+}
+
+void ActionInitialization::BuildForMaster() const
+{
+    // Only sums the histograms of the workers at the end of each run.
+    SetUserAction(new RunAction());
+}
+
+void ActionInitialization::Build() const
+{
+    SetUserAction(new PrimaryGeneratorAction(primary_generator));
+    SetUserAction(new EventAction());
+    SetUserAction(new SteppingAction());
+    SetUserAction(new RunAction());
+}
+
+#endif // G4MULTITHREADED
@@ -0,0 +1,76 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "ArchivePhasespaceReader.hh"
+
+
+ArchivePhasespaceReader::ArchivePhasespaceReader(G4String filename) {
+    this->filename = filename;
+
+    input_file_stream = NULL;
+    phasespace_archive = NULL;
+
+    Rewind();
+}
+
+ArchivePhasespaceReader::~ArchivePhasespaceReader() {
+    delete phasespace_archive;
+    delete input_file_stream;
+}
+
+void ArchivePhasespaceReader::Rewind() {
+    delete phasespace_archive;
+    delete input_file_stream;
+
+    input_file_stream = new std::ifstream(filename.c_str(), std::ios::binary);
+    phasespace_archive = new boost::archive::binary_iarchive(*input_file_stream);
+    current_record = 0;
+}
+
+G4bool ArchivePhasespaceReader::Read(PhasespaceRecord& record) {
+    record = PhasespaceRecord();
+
+    if (input_file_stream->peek() == std::char_traits<char>::eof())
+        return false;
+
+    try {
+        *phasespace_archive >> record;
+    } catch (...) {
+        return false;
+    }
+
+    current_record++;
+    return true;
+}
+
+G4bool ArchivePhasespaceReader::Seek(int64_t index) {
+    if (index < current_record)
+        Rewind();
+
+    // No way to jump ahead in an archive, read through to the record.
+    PhasespaceRecord record;
+    while (current_record < index) {
+        if (!Read(record))
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,140 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "AsyncPhasespaceWriter.hh"
+
+#include <unistd.h>
+
+
+AsyncPhasespaceWriter::AsyncPhasespaceWriter(PhasespaceWriter* writer,
+        G4int block_size, G4int queue_depth) {
+    this->writer = writer;
+    this->block_size = block_size;
+
+    // One block being filled, the rest waiting for or being written.
+    for (int i=0; i<queue_depth + 1; i++) {
+        std::vector<PhasespaceRecord>* block = new std::vector<PhasespaceRecord>();
+        block->reserve(block_size);
+        free_blocks.push_back(block);
+    }
+
+    current_block = free_blocks.front();
+    free_blocks.pop_front();
+
+    closing = false;
+    closed = false;
+    record_count = 0;
+
+    writer_thread = boost::thread(&AsyncPhasespaceWriter::Run, this);
+    owner = getpid();
+}
+
+AsyncPhasespaceWriter::~AsyncPhasespaceWriter() {
+    Close();
+
+    delete current_block;
+    while (!free_blocks.empty()) {
+        delete free_blocks.front();
+        free_blocks.pop_front();
+    }
+
+    // In a forked child this would close, and so write to, the parent's file.
+    if (getpid() == owner)
+        delete writer;
+}
+
+void AsyncPhasespaceWriter::Write(const PhasespaceRecord& record) {
+    if (closed)
+        return;
+
+    current_block->push_back(record);
+    record_count++;
+
+    if ((G4int) current_block->size() >= block_size) {
+        Submit();
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (free_blocks.empty())
+            block_free.wait(lock);
+
+        current_block = free_blocks.front();
+        free_blocks.pop_front();
+    }
+}
+
+void AsyncPhasespaceWriter::Submit() {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    full_blocks.push_back(current_block);
+    current_block = NULL;
+
+    block_full.notify_one();
+}
+
+void AsyncPhasespaceWriter::Close() {
+    if (closed)
+        return;
+
+    // After a fork the thread and the file are left behind in the parent.
+    if (getpid() != owner) {
+        closed = true;
+        return;
+    }
+
+    // Hand over whatever is left, then wait for the writer to drain.
+    Submit();
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        closing = true;
+        block_full.notify_one();
+    }
+    writer_thread.join();
+
+    current_block = free_blocks.back();
+    free_blocks.pop_back();
+
+    writer->Close();
+    closed = true;
+}
+
+void AsyncPhasespaceWriter::Run() {
+    while (true) {
+        std::vector<PhasespaceRecord>* block;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (full_blocks.empty() && !closing)
+                block_full.wait(lock);
+
+            if (full_blocks.empty())
+                return;
+
+            block = full_blocks.front();
+            full_blocks.pop_front();
+        }
+
+        // The slow part, done without holding the lock.
+        writer->WriteBlock(*block);
+        block->clear();
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        free_blocks.push_back(block);
+        block_free.notify_one();
+    }
+}
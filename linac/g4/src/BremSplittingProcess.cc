@@ -42,6 +42,7 @@ G4bool BremSplittingProcess::fActive = true;
 BremSplittingProcess::BremSplittingProcess() {
 
     fNSplit = 10;//unless specified by UI command, will be 10 (ie no splitting
+    bremMessenger = 0;
 
 //    bremMessenger = new BremSplittingProcessMessenger(this);//instantiate messenger class for UI commands
 
@@ -63,7 +64,8 @@ G4VParticleChange* BremSplittingProcess::PostStepDoIt(const G4Track& track, cons
     particleChange = pRegProcess->PostStepDoIt(track, step);
     assert (0 != particleChange);
 
-    fNSecondaries += particleChange->GetNumberOfSecondaries();
+    // Shared by the process of every worker thread.
+    __sync_fetch_and_add(&fNSecondaries, particleChange->GetNumberOfSecondaries());
 
     return particleChange;
   }
@@ -110,7 +112,7 @@ G4VParticleChange* BremSplittingProcess::PostStepDoIt(const G4Track& track, cons
     iter++;
   }
 
-  fNSecondaries += secondaries.size();
+  __sync_fetch_and_add(&fNSecondaries, (G4int) secondaries.size());
 
   return particleChange;
 }
@@ -0,0 +1,50 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "CTMaterialRamp.hh"
+
+#include <cmath>
+
+
+CTMaterialRamp::CTMaterialRamp(const std::map<int16_t, G4Material*>& materials,
+        G4int rounding, G4int lower, G4int upper) {
+    this->materials = materials;
+    this->rounding = rounding;
+    this->lower = lower;
+    this->upper = upper;
+}
+
+G4int CTMaterialRamp::Round(G4int value) const {
+    if (value < lower)
+        value = lower;
+    if (value > upper)
+        value = upper;
+
+    return (G4int) std::floor(value / (G4double) rounding) * rounding;
+}
+
+G4Material* CTMaterialRamp::GetMaterial(G4int value) const {
+    std::map<int16_t, G4Material*>::const_iterator it = materials.upper_bound(Round(value));
+    if (it != materials.begin())
+        it--;
+
+    return it->second;
+}
@@ -0,0 +1,45 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "CTParameterisation.hh"
+
+#include "G4VTouchable.hh"
+
+
+CTParameterisation::CTParameterisation(G4VoxelArray<int16_t>* array,
+        std::map<int16_t, G4Material*> materials, G4VPhysicalVolume* mother,
+        const CTMaterialRamp& ramp)
+    : G4VoxelDataParameterisation<int16_t>(array, materials, mother), array(array), ramp(ramp) {
+}
+
+G4Material* CTParameterisation::ComputeMaterial(G4VPhysicalVolume* volume,
+        const G4int copy, const G4VTouchable* parent) {
+    // Without a voxel to look at, whatever the parameterisation gives.
+    if (parent == 0)
+        return G4VoxelDataParameterisation<int16_t>::ComputeMaterial(volume, copy, parent);
+
+    // Voxels are z replicas in y replicas in x replicas, as scored by
+    // SensitiveDetector by default, seen from one level up.
+    G4int x = parent->GetReplicaNumber(1);
+    G4int y = parent->GetReplicaNumber(0);
+
+    return ramp.GetMaterial(array->GetValue(x, y, copy));
+}
@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "CompressedPhasespaceReader.hh"
+
+#include <cstring>
+
+
+CompressedPhasespaceReader::CompressedPhasespaceReader(G4String filename) {
+    this->filename = filename;
+
+    std::memset(&header, 0, sizeof(header));
+    std::memset(&compressed_header, 0, sizeof(compressed_header));
+
+    std::ifstream input_file_stream(filename.c_str(), std::ios::binary);
+    input_file_stream.read((char*) &header, sizeof(header));
+    input_file_stream.read((char*) &compressed_header, sizeof(compressed_header));
+
+    if (std::memcmp(header.magic, COMPRESSED_PHASESPACE_MAGIC, sizeof(header.magic)) != 0) {
+        G4cout << "Not a compressed phasespace file: " << filename << G4endl;
+        header.record_count = 0;
+    } else if (header.version > PHASESPACE_VERSION ||
+            compressed_header.codec != PHASESPACE_CODEC_ZSTD) {
+        G4cout << "Unsupported phasespace version or codec in " << filename << G4endl;
+        header.record_count = 0;
+    } else {
+        block_index.resize(compressed_header.block_count);
+        input_file_stream.seekg(compressed_header.index_offset);
+        if (!block_index.empty()) {
+            input_file_stream.read((char*) &block_index[0],
+                    block_index.size()*sizeof(CompressedBlockIndex));
+        }
+
+        if (!input_file_stream.good()) {
+            G4cout << "Truncated compressed phasespace index: " << filename << G4endl;
+            block_index.clear();
+            header.record_count = 0;
+        }
+    }
+
+    codec = new PhasespaceBlockCodec(compressed_header);
+
+    current_block = -1;
+    position_in_block = 0;
+}
+
+CompressedPhasespaceReader::~CompressedPhasespaceReader() {
+    delete codec;
+}
+
+G4bool CompressedPhasespaceReader::ReadBlock(G4int block,
+        std::vector<PackedPhasespaceRecord>& records) {
+    if (block < 0 || block >= (G4int) block_index.size())
+        return false;
+
+    const CompressedBlockIndex& entry = block_index[block];
+    std::vector<char> compressed(entry.compressed_size);
+
+    std::ifstream input_file_stream(filename.c_str(), std::ios::binary);
+    input_file_stream.seekg(entry.offset);
+    input_file_stream.read(&compressed[0], compressed.size());
+
+    if (!input_file_stream.good())
+        return false;
+
+    return codec->Decode(compressed, entry.record_count, records);
+}
+
+G4bool CompressedPhasespaceReader::LoadBlock(G4int block) {
+    if (!ReadBlock(block, current_records)) {
+        current_records.clear();
+        return false;
+    }
+
+    current_block = block;
+    position_in_block = 0;
+    return true;
+}
+
+G4bool CompressedPhasespaceReader::Read(PhasespaceRecord& record) {
+    while (current_block < 0 || position_in_block >= (G4int) current_records.size()) {
+        if (!LoadBlock(current_block + 1))
+            return false;
+    }
+
+    record = Unpack(current_records[position_in_block]);
+
+    position_in_block++;
+    return true;
+}
+
+PhasespaceRecord CompressedPhasespaceReader::Unpack(const PackedPhasespaceRecord& packed) {
+    return PhasespaceRecord(packed, header.length_unit, header.energy_unit);
+}
+
+G4bool CompressedPhasespaceReader::Seek(int64_t index) {
+    if (index < 0 || index > (int64_t) header.record_count)
+        return false;
+
+    // Find the last block starting at or before `index`.
+    G4int low = 0;
+    G4int high = block_index.size();
+    while (high - low > 1) {
+        G4int middle = (low + high) / 2;
+        if ((int64_t) block_index[middle].first_record <= index) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (index == (int64_t) header.record_count) {
+        // Positioned at the end, the next Read returns false.
+        current_block = block_index.size();
+        current_records.clear();
+        position_in_block = 0;
+        return true;
+    }
+
+    if (low != current_block && !LoadBlock(low))
+        return false;
+
+    position_in_block = index - block_index[low].first_record;
+    return true;
+}
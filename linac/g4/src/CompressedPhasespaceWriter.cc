@@ -0,0 +1,139 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "CompressedPhasespaceWriter.hh"
+
+#include <cstring>
+
+
+CompressedPhasespaceWriter::CompressedPhasespaceWriter(G4String filename, G4int level,
+        G4bool delta, G4double position_step, G4double direction_step, G4double energy_step,
+        G4int block_size) {
+    this->filename = filename;
+    this->block_size = block_size;
+
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, COMPRESSED_PHASESPACE_MAGIC, sizeof(header.magic));
+    header.version = PHASESPACE_VERSION;
+    header.record_size = sizeof(PackedPhasespaceRecord);
+    header.record_count = 0;
+    header.length_unit = mm;
+    header.energy_unit = MeV;
+
+    std::memset(&compressed_header, 0, sizeof(compressed_header));
+    compressed_header.codec = PHASESPACE_CODEC_ZSTD;
+    compressed_header.encoding = delta ? PHASESPACE_ENCODING_DELTA : 0;
+    if (position_step > 0 || direction_step > 0 || energy_step > 0)
+        compressed_header.encoding |= PHASESPACE_ENCODING_QUANTIZED;
+    compressed_header.position_step = position_step;
+    compressed_header.direction_step = direction_step;
+    compressed_header.energy_step = energy_step;
+
+    codec = new PhasespaceBlockCodec(compressed_header, level);
+    packed_block.reserve(block_size);
+    encode_time = 0;
+
+    output_file_stream = new std::ofstream(filename.c_str(), std::ios::binary);
+    WriteHeader();
+    offset = sizeof(header) + sizeof(compressed_header);
+}
+
+CompressedPhasespaceWriter::~CompressedPhasespaceWriter() {
+    Close();
+    delete output_file_stream;
+    delete codec;
+}
+
+void CompressedPhasespaceWriter::Write(const PhasespaceRecord& record) {
+    packed_block.push_back(record.Pack());
+
+    if ((G4int) packed_block.size() >= block_size)
+        FlushBlock();
+}
+
+void CompressedPhasespaceWriter::WriteBlock(const std::vector<PhasespaceRecord>& block) {
+    for (unsigned int i=0; i<block.size(); i++) {
+        packed_block.push_back(block[i].Pack());
+
+        if ((G4int) packed_block.size() >= block_size)
+            FlushBlock();
+    }
+}
+
+void CompressedPhasespaceWriter::FlushBlock() {
+    if (packed_block.empty())
+        return;
+
+    timer.Start();
+    codec->Encode(packed_block, compressed_block);
+    timer.Stop();
+    encode_time += timer.GetRealElapsed();
+
+    output_file_stream->write(&compressed_block[0], compressed_block.size());
+
+    CompressedBlockIndex block_index;
+    block_index.offset = offset;
+    block_index.first_record = header.record_count;
+    block_index.record_count = packed_block.size();
+    block_index.compressed_size = compressed_block.size();
+    index.push_back(block_index);
+
+    offset += compressed_block.size();
+    header.record_count += packed_block.size();
+    packed_block.clear();
+}
+
+void CompressedPhasespaceWriter::Close() {
+    if (!output_file_stream->is_open())
+        return;
+
+    FlushBlock();
+
+    compressed_header.index_offset = offset;
+    compressed_header.block_count = index.size();
+    if (!index.empty()) {
+        output_file_stream->write((char*) &index[0],
+                index.size()*sizeof(CompressedBlockIndex));
+    }
+    G4double file_size = offset + index.size()*sizeof(CompressedBlockIndex);
+
+    output_file_stream->seekp(0);
+    WriteHeader();
+    output_file_stream->close();
+
+    G4double raw_size = header.record_count*sizeof(PackedPhasespaceRecord);
+    G4cout << "Closed compressed phasespace: " << filename << G4endl;
+    G4cout << "    Records:           " << header.record_count
+           << " in " << index.size() << " blocks" << G4endl;
+    if (header.record_count > 0) {
+        G4cout << "    Compression ratio: " << raw_size / file_size
+               << " (" << raw_size/1e6 << " MB packed, " << file_size/1e6 << " MB on disk)" << G4endl;
+    }
+    if (encode_time > 0) {
+        G4cout << "    Encode throughput: " << raw_size/1e6 / encode_time << " MB/s, "
+               << header.record_count / encode_time << " records/s" << G4endl;
+    }
+}
+
+void CompressedPhasespaceWriter::WriteHeader() {
+    output_file_stream->write((char*) &header, sizeof(header));
+    output_file_stream->write((char*) &compressed_header, sizeof(compressed_header));
+}
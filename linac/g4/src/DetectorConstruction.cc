@@ -21,6 +21,7 @@
 
 // USER //
 #include "DetectorConstruction.hh"
+#include "DoseStatistics.hh"
 
 // CADMesh //
 #include "CADMesh.hh"
@@ -36,6 +37,18 @@
 #include "G4SolidStore.hh"
 #include "G4RunManager.hh"
 
+#include <stdexcept>
+
+#ifdef G4MULTITHREADED
+#include "G4MTRunManager.hh"
+#include "G4Threading.hh"
+
+// The copy of the master detector on the calling worker thread, and the
+// master detector it was made for.
+static G4ThreadLocal SensitiveDetector* worker_detector = NULL;
+static G4ThreadLocal SensitiveDetector* worker_master = NULL;
+#endif
+
 
 DetectorConstruction::DetectorConstruction()
 {
@@ -52,6 +65,10 @@ DetectorConstruction::DetectorConstruction()
     hounsfield.push_back(Hounsfield(125,"G4_TISSUE_SOFT_ICRP", 1.101));
     hounsfield.push_back(Hounsfield(2500,"G4_BONE_CORTICAL_ICRP", 2.088));
 
+    ct_rounding = 25;
+    ct_lower = -1000;
+    ct_upper = 2000;
+
     world_size = G4ThreeVector(3*m, 3*m, 3*m);
 
     nist_manager = G4NistManager::Instance();
@@ -66,6 +83,15 @@ DetectorConstruction::DetectorConstruction()
     headless = false;
 
     detector = NULL;
+    atomic_scoring = false;
+    tiled_scoring = false;
+    reduce_each_run = true;
+    scoring_quantity = "dose_uncertainty";
+
+    checkpoint_events = 0;
+    checkpoint_seconds = 0;
+    events_since_checkpoint = 0;
+    last_checkpoint = std::time(NULL);
     voxeldata_param = NULL;
 
     RegisterParallelWorld(new ParallelDetectorConstruction("parallel_world"));
@@ -83,6 +109,7 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
     G4SolidStore::GetInstance()->Clean();
     G4LogicalVolumeStore::GetInstance()->Clean();
     G4PhysicalVolumeStore::GetInstance()->Clean();
+    detector_volumes.clear();
 
     G4NistManager* man = G4NistManager::Instance();
     man->SetVerbose(1);
@@ -133,6 +160,130 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
 }
 
 
+#ifdef G4MULTITHREADED
+void DetectorConstruction::ConstructSDandField()
+{
+    if (verbose >= 4)
+        G4cout << "DetectorConstruction::ConstructSDandField" << G4endl;
+
+    AttachWorkerDetector();
+}
+
+void DetectorConstruction::AttachWorkerDetector()
+{
+    // The master attached its detector when the phantom or CT was set up.
+    if (!detector || !G4Threading::IsWorkerThread())
+        return;
+
+    // A new phantom or CT comes with a new master detector and grids, the
+    // copy made for the old one would score into freed histograms.
+    if (worker_master != detector) {
+        if (worker_detector)
+            worker_detector->Activate(false);
+
+        worker_detector = SensitiveDetector::Create(detector->GetName(), scoring_quantity,
+                tiled_scoring, detector);
+        worker_master = detector;
+        G4SDManager::GetSDMpointer()->AddNewDetector(worker_detector);
+    }
+
+    // Replaces whatever the volume had on this thread, where attaching
+    // through the base class would add to it.
+    for (unsigned int i=0; i<detector_volumes.size(); i++)
+        detector_volumes[i]->SetSensitiveDetector(worker_detector);
+}
+#endif
+
+
+SensitiveDetector* DetectorConstruction::MakeDetector(G4String name)
+{
+    SensitiveDetector* detector = SensitiveDetector::Create(name, scoring_quantity,
+            tiled_scoring);
+    detector->SetAtomic(atomic_scoring);
+    detector->SetMassEnergyAbsorption(absorption_energies, absorption_coefficients);
+    detector->SetCheckpoint(checkpoint_prefix);
+
+    return detector;
+}
+
+
+void DetectorConstruction::CheckpointIfDue()
+{
+    if (!detector || checkpoint_prefix == "")
+        return;
+
+#ifdef G4MULTITHREADED
+    // Worker buffers can only be summed once the run is over, mid run only
+    // atomically scored histograms are complete. A multithreaded build can
+    // still run sequentially, then the histograms are always complete.
+    if (!atomic_scoring && dynamic_cast<G4MTRunManager*>(G4RunManager::GetRunManager()))
+        return;
+#endif
+
+    boost::mutex::scoped_lock lock(checkpoint_mutex);
+
+    events_since_checkpoint++;
+
+    G4bool due = checkpoint_events > 0 && events_since_checkpoint >= checkpoint_events;
+    if (checkpoint_seconds > 0 && std::difftime(std::time(NULL), last_checkpoint) >= checkpoint_seconds)
+        due = true;
+
+    if (!due)
+        return;
+
+    detector->Checkpoint();
+
+    events_since_checkpoint = 0;
+    last_checkpoint = std::time(NULL);
+}
+
+
+boost::python::dict DetectorConstruction::GetDoseStatistics(G4int label, G4int bins,
+        G4double maximum, pyublas::numpy_vector<G4double> volumes,
+        pyublas::numpy_vector<G4double> doses)
+{
+    // Raised as a RuntimeError in Python.
+    if (!detector)
+        throw std::runtime_error("DetectorConstruction::GetDoseStatistics: no phantom or CT "
+                                 "detector has been set up");
+
+    const std::vector<uint8_t>& labels = structures.empty() ? scoring_mask : structures;
+    DoseStatistics statistics(detector, labels, label);
+
+    if (maximum <= 0)
+        maximum = statistics.GetMaximum();
+
+    npy_intp edge_dims[] = {bins + 1};
+    pyublas::numpy_vector<G4double> edges(1, edge_dims);
+    for (G4int i=0; i<=bins; i++)
+        edges[i] = i*maximum/bins;
+
+    npy_intp volume_dims[] = {(npy_intp) volumes.size()};
+    pyublas::numpy_vector<G4double> dose_metrics(1, volume_dims);
+    for (unsigned int i=0; i<volumes.size(); i++)
+        dose_metrics[i] = statistics.GetDose(volumes[i]);
+
+    npy_intp dose_dims[] = {(npy_intp) doses.size()};
+    pyublas::numpy_vector<G4double> volume_metrics(1, dose_dims);
+    for (unsigned int i=0; i<doses.size(); i++)
+        volume_metrics[i] = statistics.GetVolume(doses[i]);
+
+    boost::python::dict result;
+    result["voxels"] = statistics.GetVoxelCount();
+    result["volume"] = statistics.GetVoxelCount()*detector->volume;
+    result["mean"] = statistics.GetMean();
+    result["minimum"] = statistics.GetMinimum();
+    result["maximum"] = statistics.GetMaximum();
+    result["edges"] = edges;
+    result["differential"] = statistics.GetDifferential(bins, maximum);
+    result["cumulative"] = statistics.GetCumulative(bins, maximum);
+    result["D"] = dose_metrics;
+    result["V"] = volume_metrics;
+
+    return result;
+}
+
+
 G4VPhysicalVolume* DetectorConstruction::FindVolume(G4String name, G4VPhysicalVolume * mother)
 {
     if (verbose >= 4)
@@ -172,12 +323,16 @@ void DetectorConstruction::SetupPhantom()
                                        "phantom_physical", world_logical, false, 0);
 //    phantom_logical->SetVisAttributes(new G4VisAttributes(G4Colour(0, 0.6, 0.9, 1))); 
 
-    if (!this->detector)
-        detector = new SensitiveDetector("phantom_detector");
+    if (!this->detector) {
+        detector = MakeDetector("phantom_detector");
+        if (!scoring_mask.empty())
+            detector->SetScoringMask(scoring_mask);
+    }
 
     G4SDManager* sd_manager = G4SDManager::GetSDMpointer();
     sd_manager->AddNewDetector(detector);
     phantom_logical->SetSensitiveDetector(detector);
+    detector_volumes.push_back(phantom_logical);
 }
 
 void DetectorConstruction::SetupCADPhantom(char* filename, G4ThreeVector offset)
@@ -200,11 +355,12 @@ void DetectorConstruction::SetupCADPhantom(char* filename, G4ThreeVector offset)
                                                     false, 0);
 
     if (!this->detector)
-        detector = new SensitiveDetector("phantom_detector");
+        detector = MakeDetector("phantom_detector");
 
     G4SDManager* sd_manager = G4SDManager::GetSDMpointer();
     sd_manager->AddNewDetector(detector);
     logical->SetSensitiveDetector(detector);
+    detector_volumes.push_back(logical);
 
     G4RunManager::GetRunManager()->GeometryHasBeenModified();
 }
@@ -331,15 +487,16 @@ void DetectorConstruction::SetupCT()
         G4cout << "DetectorConstruction::SetupCT" << G4endl;
 
     if (!voxeldata_param) {
+        CTMaterialRamp ramp(materials, ct_rounding, ct_lower, ct_upper);
         voxeldata_param =
-            new G4VoxelDataParameterisation<int16_t>(array, materials, world_physical );
+            new CTParameterisation(array, materials, world_physical, ramp);
 
         G4RotationMatrix* rotation = new G4RotationMatrix();
         rotation->rotateZ(90*deg);
         rotation->rotateX(-90*deg);
 
         voxeldata_param->Construct(ct_position, rotation);
-        voxeldata_param->SetRounding(25, -1000, 2000);
+        voxeldata_param->SetRounding(ct_rounding, ct_lower, ct_upper);
 
         std::map<int16_t, G4Colour*> colours;
         for (int i=-2500; i<5000; i++) {
@@ -359,11 +516,33 @@ void DetectorConstruction::SetupCT()
         voxeldata_param->SetColourMap(colours);
         voxeldata_param->SetVisibility(false);
 
-        detector = new SensitiveDetector("ct_detector");
+        // Mass of every voxel up front, so scoring a hit is a lookup
+        // rather than a division by the density of the step material.
+        std::vector<unsigned int> shape = array->GetShape();
+        std::vector<double> spacing = array->GetSpacing();
+        G4double voxel_volume = spacing[0]*spacing[1]*spacing[2];
+
+        std::vector<G4double> inverse_masses(shape[0]*shape[1]*shape[2]);
+        for (unsigned int x=0; x<shape[0]; x++) {
+            for (unsigned int y=0; y<shape[1]; y++) {
+                for (unsigned int z=0; z<shape[2]; z++) {
+                    G4Material* material = ramp.GetMaterial(array->GetValue(x, y, z));
+                    inverse_masses[(x*shape[1] + y)*shape[2] + z] =
+                        1. / (material->GetDensity() * voxel_volume);
+                }
+            }
+        }
+
+        detector = MakeDetector("ct_detector");
+        detector->SetResolution(spacing[0], spacing[1], spacing[2]);
+        detector->SetVoxelData(shape[0], shape[1], shape[2], inverse_masses);
+        if (!scoring_mask.empty())
+            detector->SetScoringMask(scoring_mask);
 
         G4SDManager* sd_manager = G4SDManager::GetSDMpointer();
         sd_manager->AddNewDetector(detector);
         voxeldata_param->GetLogicalVolume()->SetSensitiveDetector(detector);
+        detector_volumes.push_back(voxeldata_param->GetLogicalVolume());
         
         G4RunManager::GetRunManager()->GeometryHasBeenModified();
     }
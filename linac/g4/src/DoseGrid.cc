@@ -0,0 +1,753 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+#include "DoseGrid.hh"
+
+#include "boost/bind.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+DoseGrid::DoseGrid(G4int x_dim, G4int y_dim, G4int z_dim, G4bool tiled,
+        G4bool energysq, G4bool counts) {
+    this->x_dim = x_dim;
+    this->y_dim = y_dim;
+    this->z_dim = z_dim;
+
+    size = x_dim * y_dim * z_dim;
+
+    x_bricks = (x_dim + 7) / 8;
+    y_bricks = (y_dim + 7) / 8;
+    z_bricks = (z_dim + 7) / 8;
+    brick_count = x_bricks * y_bricks * z_bricks;
+
+    // 128kB of each histogram at a time, small enough to stay in cache
+    // while every worker buffer is added in.
+    block_size = 16384;
+    atomic = false;
+    this->tiled = tiled;
+    this->keep_energysq = energysq;
+    this->keep_counts = counts;
+
+    mapped_energy = NULL;
+    mapped_energysq = NULL;
+    mapped_counts = NULL;
+    mapped_histories = NULL;
+
+    master.owned = false;
+    master.history_energy = NULL;
+    master.last_history = NULL;
+    master.history = 0;
+    master.histories = 0;
+
+    Allocate();
+}
+
+DoseGrid::~DoseGrid() {
+    Free();
+
+    delete mapped_energy;
+    delete mapped_energysq;
+    delete mapped_counts;
+    delete mapped_histories;
+}
+
+void DoseGrid::Allocate() {
+    master.energy = NULL;
+    master.energysq = NULL;
+    master.counts = NULL;
+    master.bricks = NULL;
+
+    if (tiled) {
+        master.bricks = new DoseBrick*[brick_count];
+        std::fill(master.bricks, master.bricks + brick_count, (DoseBrick*) NULL);
+    } else {
+        npy_intp dims[] = {x_dim, y_dim, z_dim};
+
+        energy_histogram = pyublas::numpy_vector<G4double> (3, dims);
+        master.energy = &energy_histogram[0];
+
+        if (keep_energysq) {
+            energysq_histogram = pyublas::numpy_vector<G4double> (3, dims);
+            master.energysq = &energysq_histogram[0];
+        }
+
+        if (keep_counts) {
+            counts_histogram = pyublas::numpy_vector<G4double> (3, dims);
+            master.counts = &counts_histogram[0];
+        }
+    }
+
+    Zero();
+}
+
+void DoseGrid::Free() {
+    for (unsigned int i=0; i<buffers.size(); i++) {
+        DoseGridBuffer* buffer = buffers[i];
+
+        if (buffer->owned) {
+            if (tiled) {
+                for (G4int b=0; b<brick_count; b++)
+                    delete buffer->bricks[b];
+                delete [] buffer->bricks;
+            } else {
+                delete [] buffer->energy;
+                delete [] buffer->energysq;
+                delete [] buffer->counts;
+            }
+        }
+        delete [] buffer->history_energy;
+        delete [] buffer->last_history;
+        delete buffer;
+    }
+    buffers.clear();
+
+    if (tiled) {
+        for (G4int b=0; b<brick_count; b++)
+            delete master.bricks[b];
+        delete [] master.bricks;
+        master.bricks = NULL;
+    } else {
+        energy_histogram = pyublas::numpy_vector<G4double>();
+        energysq_histogram = pyublas::numpy_vector<G4double>();
+        counts_histogram = pyublas::numpy_vector<G4double>();
+    }
+}
+
+void DoseGrid::SetTiled(G4bool tiled) {
+    if (tiled == this->tiled)
+        return;
+
+    if (IsMapped()) {
+        G4cout << "DoseGrid::SetTiled: histograms are mapped to files, ignored." << G4endl;
+        return;
+    }
+
+    if (!buffers.empty()) {
+        G4cout << "DoseGrid::SetTiled: already scoring, ignored." << G4endl;
+        return;
+    }
+
+    Free();
+    this->tiled = tiled;
+    Allocate();
+}
+
+DoseGridBuffer* DoseGrid::GetLocalBuffer() {
+    boost::mutex::scoped_lock lock(mutex);
+
+    DoseGridBuffer* buffer = new DoseGridBuffer(master);
+
+    // Atomic scoring keeps the current history sparse instead, and bricks
+    // carry their own.
+    if (keep_energysq && !atomic && !tiled) {
+        buffer->history_energy = new G4double[size];
+        buffer->last_history = new int64_t[size];
+
+        std::fill(buffer->history_energy, buffer->history_energy + size, 0.0);
+        std::fill(buffer->last_history, buffer->last_history + size, -1);
+    }
+
+#ifdef G4MULTITHREADED
+    if (!atomic && tiled) {
+        buffer->bricks = new DoseBrick*[brick_count];
+        buffer->owned = true;
+
+        std::fill(buffer->bricks, buffer->bricks + brick_count, (DoseBrick*) NULL);
+    } else if (!atomic) {
+        buffer->energy = new G4double[size];
+        buffer->owned = true;
+        std::fill(buffer->energy, buffer->energy + size, 0.0);
+
+        if (keep_energysq) {
+            buffer->energysq = new G4double[size];
+            std::fill(buffer->energysq, buffer->energysq + size, 0.0);
+        }
+
+        if (keep_counts) {
+            buffer->counts = new G4double[size];
+            std::fill(buffer->counts, buffer->counts + size, 0.0);
+        }
+    }
+#endif
+    // Otherwise there is only one worker, or all workers share the
+    // master histograms through atomic adds.
+
+    buffers.push_back(buffer);
+    return buffer;
+}
+
+DoseBrick* DoseGrid::NewBrick(DoseGridBuffer* buffer, G4int index, G4bool scored) {
+    // Atomic scoring keeps the current history in `touched` instead.
+    DoseBrick* brick = new DoseBrick(keep_energysq, keep_counts,
+            scored && keep_energysq && !atomic);
+
+    // With atomic scoring the workers share the master bricks, the first
+    // to put one in place wins.
+    DoseBrick* seen = __sync_val_compare_and_swap(buffer->bricks + index,
+            (DoseBrick*) NULL, brick);
+    if (seen != NULL) {
+        delete brick;
+        return seen;
+    }
+
+    return brick;
+}
+
+G4int DoseGrid::GetBrickCount() {
+    if (!tiled)
+        return 0;
+
+    G4int count = 0;
+    for (G4int b=0; b<brick_count; b++) {
+        if (master.bricks[b])
+            count++;
+    }
+    return count;
+}
+
+void DoseGrid::EndHistory(DoseGridBuffer* buffer) {
+    if (!atomic)
+        return;
+
+    boost::unordered_map<G4int, G4double>::iterator it;
+    for (it = buffer->touched.begin(); it != buffer->touched.end(); it++) {
+        AtomicAdd(EnergyAt(buffer, it->first), it->second);
+        AtomicAdd(EnergySqAt(buffer, it->first), it->second*it->second);
+    }
+    buffer->touched.clear();
+}
+
+G4bool DoseGrid::Map(G4String prefix) {
+    boost::mutex::scoped_lock lock(mutex);
+
+    if (IsMapped())
+        return true;
+
+    if (tiled || !buffers.empty()) {
+        G4cout << "DoseGrid::Map: only dense grids can be mapped, before the first event."
+               << G4endl;
+        return false;
+    }
+
+    std::vector<int64_t> shape;
+    shape.push_back(x_dim);
+    shape.push_back(y_dim);
+    shape.push_back(z_dim);
+
+    std::vector<int64_t> single(1, 1);
+
+    MappedHistogram* energy = new MappedHistogram();
+    MappedHistogram* energysq = keep_energysq ? new MappedHistogram() : NULL;
+    MappedHistogram* counts = keep_counts ? new MappedHistogram() : NULL;
+    MappedHistogram* histories_file = new MappedHistogram();
+
+    G4bool opened = energy->Open(prefix + "_energy.npy", "<f8", shape)
+        && (!energysq || energysq->Open(prefix + "_energy2.npy", "<f8", shape))
+        && (!counts || counts->Open(prefix + "_counts.npy", "<f8", shape))
+        && histories_file->Open(prefix + "_histories.npy", "<i8", single);
+
+    if (!opened) {
+        delete energy;
+        delete energysq;
+        delete counts;
+        delete histories_file;
+        return false;
+    }
+
+    // Carry on from the files only if all of them were there, anything
+    // else starts from zero.
+    G4bool resume = energy->Existed() && histories_file->Existed()
+        && (!energysq || energysq->Existed()) && (!counts || counts->Existed());
+
+    mapped_energy = energy;
+    mapped_energysq = energysq;
+    mapped_counts = counts;
+    mapped_histories = histories_file;
+
+    master.energy = (G4double*) energy->GetData();
+    master.energysq = energysq ? (G4double*) energysq->GetData() : NULL;
+    master.counts = counts ? (G4double*) counts->GetData() : NULL;
+
+    // The in memory histograms are not needed any more.
+    energy_histogram = pyublas::numpy_vector<G4double>();
+    energysq_histogram = pyublas::numpy_vector<G4double>();
+    counts_histogram = pyublas::numpy_vector<G4double>();
+
+    int64_t* stored_histories = (int64_t*) histories_file->GetData();
+    if (resume) {
+        histories = *stored_histories;
+        G4cout << "Resuming histograms from " << prefix << " after "
+               << histories << " histories." << G4endl;
+    } else {
+        ZeroLocked();
+    }
+
+    return true;
+}
+
+void DoseGrid::Checkpoint() {
+    if (!IsMapped())
+        return;
+
+    if (!atomic) {
+        Reduce();
+        return;
+    }
+
+    boost::mutex::scoped_lock lock(mutex);
+    Sync();
+}
+
+void DoseGrid::Sync() {
+    if (!IsMapped())
+        return;
+
+    // Histories still held by workers scoring atomically count too, their
+    // dose is already in the master histograms.
+    int64_t total = histories;
+    if (atomic) {
+        for (unsigned int i=0; i<buffers.size(); i++)
+            total += buffers[i]->histories;
+    }
+    *((int64_t*) mapped_histories->GetData()) = total;
+
+    mapped_energy->Sync();
+    if (mapped_energysq)
+        mapped_energysq->Sync();
+    if (mapped_counts)
+        mapped_counts->Sync();
+    mapped_histories->Sync();
+}
+
+void DoseGrid::Reduce(G4int threads) {
+    boost::mutex::scoped_lock lock(mutex);
+
+    if (threads <= 0)
+        threads = std::max(1u, boost::thread::hardware_concurrency());
+
+    boost::thread_group thread_group;
+    for (int i=0; i<threads; i++) {
+        if (tiled) {
+            thread_group.create_thread(boost::bind(&DoseGrid::ReduceBricks,
+                        this, i, threads));
+        } else {
+            thread_group.create_thread(boost::bind(&DoseGrid::ReduceBlocks,
+                        this, i, threads));
+        }
+    }
+    thread_group.join_all();
+
+    for (unsigned int i=0; i<buffers.size(); i++) {
+        histories += buffers[i]->histories;
+        buffers[i]->histories = 0;
+    }
+
+    Sync();
+}
+
+void DoseGrid::Merge(pyublas::numpy_vector<G4double> energy,
+        pyublas::numpy_vector<G4double> energysq,
+        pyublas::numpy_vector<G4double> counts, int64_t histories) {
+    if ((G4int) energy.size() != size
+            || (keep_energysq && (G4int) energysq.size() != size)
+            || (keep_counts && (G4int) counts.size() != size)) {
+        G4cout << "DoseGrid::Merge: histograms do not match the grid, ignored." << G4endl;
+        return;
+    }
+
+    boost::mutex::scoped_lock lock(mutex);
+
+    for (G4int i=0; i<size; i++) {
+        G4int index = i;
+        if (tiled) {
+            // Leave bricks that saw nothing unallocated.
+            if (energy[i] == 0 && (!keep_counts || counts[i] == 0))
+                continue;
+
+            G4int x = i / (y_dim*z_dim);
+            G4int y = (i / z_dim) % y_dim;
+            G4int z = i % z_dim;
+            index = GetIndex(x, y, z);
+        }
+
+        *EnergyAt(&master, index) += energy[i];
+        if (keep_energysq)
+            *EnergySqAt(&master, index) += energysq[i];
+        if (keep_counts)
+            *CountsAt(&master, index) += counts[i];
+    }
+
+    this->histories += histories;
+
+    Sync();
+}
+
+void DoseGrid::ReduceBlocks(G4int first, G4int stride) {
+    for (G4int begin=first*block_size; begin<size; begin+=stride*block_size) {
+        G4int end = std::min(begin + block_size, size);
+
+        for (unsigned int i=0; i<buffers.size(); i++) {
+            DoseGridBuffer* buffer = buffers[i];
+
+            // Square off the histories still waiting on a later one.
+            if (buffer->history_energy) {
+                for (G4int j=begin; j<end; j++) {
+                    buffer->energysq[j] += buffer->history_energy[j]*buffer->history_energy[j];
+                }
+                std::fill(buffer->history_energy + begin, buffer->history_energy + end, 0.0);
+                std::fill(buffer->last_history + begin, buffer->last_history + end, -1);
+            }
+
+            if (!buffer->owned)
+                continue;
+
+            for (G4int j=begin; j<end; j++)
+                master.energy[j] += buffer->energy[j];
+            std::fill(buffer->energy + begin, buffer->energy + end, 0.0);
+
+            if (keep_energysq) {
+                for (G4int j=begin; j<end; j++)
+                    master.energysq[j] += buffer->energysq[j];
+                std::fill(buffer->energysq + begin, buffer->energysq + end, 0.0);
+            }
+
+            if (keep_counts) {
+                for (G4int j=begin; j<end; j++)
+                    master.counts[j] += buffer->counts[j];
+                std::fill(buffer->counts + begin, buffer->counts + end, 0.0);
+            }
+        }
+    }
+}
+
+void DoseGrid::ReduceBricks(G4int first, G4int stride) {
+    for (G4int b=first; b<brick_count; b+=stride) {
+        for (unsigned int i=0; i<buffers.size(); i++) {
+            DoseBrick* brick = buffers[i]->bricks[b];
+            if (brick == NULL)
+                continue;
+
+            // Square off the histories still waiting on a later one.
+            if (brick->history_energy) {
+                for (G4int j=0; j<512; j++) {
+                    brick->energysq[j] += brick->history_energy[j]*brick->history_energy[j];
+                }
+                std::fill(brick->history_energy, brick->history_energy + 512, 0.0);
+                std::fill(brick->last_history, brick->last_history + 512, -1);
+            }
+
+            if (!buffers[i]->owned)
+                continue;
+
+            // Only this thread reduces brick `b`, so no one else can be
+            // putting the master brick in place.
+            DoseBrick* target = master.bricks[b];
+            if (target == NULL)
+                target = NewBrick(&master, b, false);
+
+            for (G4int j=0; j<512; j++)
+                target->energy[j] += brick->energy[j];
+            if (keep_energysq) {
+                for (G4int j=0; j<512; j++)
+                    target->energysq[j] += brick->energysq[j];
+            }
+            if (keep_counts) {
+                for (G4int j=0; j<512; j++)
+                    target->counts[j] += brick->counts[j];
+            }
+
+            // The worker keeps the brick, the next run most likely scores
+            // into the same place.
+            std::fill(brick->energy, brick->energy + 512, 0.0);
+            if (keep_energysq)
+                std::fill(brick->energysq, brick->energysq + 512, 0.0);
+            if (keep_counts)
+                std::fill(brick->counts, brick->counts + 512, 0.0);
+        }
+    }
+}
+
+void DoseGrid::Zero() {
+    boost::mutex::scoped_lock lock(mutex);
+    ZeroLocked();
+}
+
+void DoseGrid::ZeroLocked() {
+    histories = 0;
+    if (IsMapped())
+        *((int64_t*) mapped_histories->GetData()) = 0;
+
+    if (tiled) {
+        // Dropping the bricks gives back the memory of the last field.
+        for (G4int b=0; b<brick_count; b++) {
+            delete master.bricks[b];
+            master.bricks[b] = NULL;
+        }
+    } else {
+        std::fill(master.energy, master.energy + size, 0.0);
+        if (keep_energysq)
+            std::fill(master.energysq, master.energysq + size, 0.0);
+        if (keep_counts)
+            std::fill(master.counts, master.counts + size, 0.0);
+    }
+
+    for (unsigned int i=0; i<buffers.size(); i++) {
+        DoseGridBuffer* buffer = buffers[i];
+        buffer->histories = 0;
+        buffer->touched.clear();
+
+        if (buffer->history_energy) {
+            std::fill(buffer->history_energy, buffer->history_energy + size, 0.0);
+            std::fill(buffer->last_history, buffer->last_history + size, -1);
+        }
+
+        if (!buffer->owned)
+            continue;
+
+        if (tiled) {
+            for (G4int b=0; b<brick_count; b++) {
+                delete buffer->bricks[b];
+                buffer->bricks[b] = NULL;
+            }
+        } else {
+            std::fill(buffer->energy, buffer->energy + size, 0.0);
+            if (keep_energysq)
+                std::fill(buffer->energysq, buffer->energysq + size, 0.0);
+            if (keep_counts)
+                std::fill(buffer->counts, buffer->counts + size, 0.0);
+        }
+    }
+}
+
+pyublas::numpy_vector<G4double> DoseGrid::Densify(G4double* DoseBrick::* field) {
+    npy_intp dims[] = {x_dim, y_dim, z_dim};
+    pyublas::numpy_vector<G4double> dense(3, dims);
+    std::fill(dense.begin(), dense.end(), 0.0);
+
+    for (G4int b=0; b<brick_count; b++) {
+        DoseBrick* brick = master.bricks[b];
+        if (brick == NULL)
+            continue;
+
+        G4int x0 = (b / (y_bricks*z_bricks)) * 8;
+        G4int y0 = ((b / z_bricks) % y_bricks) * 8;
+        G4int z0 = (b % z_bricks) * 8;
+
+        G4int x_end = std::min(x0 + 8, x_dim);
+        G4int y_end = std::min(y0 + 8, y_dim);
+        G4int z_end = std::min(z0 + 8, z_dim);
+
+        for (G4int x=x0; x<x_end; x++) {
+            for (G4int y=y0; y<y_end; y++) {
+                for (G4int z=z0; z<z_end; z++) {
+                    G4int j = ((x - x0) << 6) | ((y - y0) << 3) | (z - z0);
+                    dense[(x*y_dim + y)*z_dim + z] = (brick->*field)[j];
+                }
+            }
+        }
+    }
+
+    return dense;
+}
+
+pyublas::numpy_vector<G4double> DoseGrid::GetEnergy() {
+    if (tiled)
+        return Densify(&DoseBrick::energy);
+    if (IsMapped())
+        return Copy(master.energy);
+    return energy_histogram;
+}
+
+pyublas::numpy_vector<G4double> DoseGrid::GetEnergySq() {
+    if (!keep_energysq)
+        return Zeros();
+    if (tiled)
+        return Densify(&DoseBrick::energysq);
+    if (IsMapped())
+        return Copy(master.energysq);
+    return energysq_histogram;
+}
+
+pyublas::numpy_vector<G4double> DoseGrid::GetCounts() {
+    if (!keep_counts)
+        return Zeros();
+    if (tiled)
+        return Densify(&DoseBrick::counts);
+    if (IsMapped())
+        return Copy(master.counts);
+    return counts_histogram;
+}
+
+pyublas::numpy_vector<G4double> DoseGrid::Zeros() {
+    npy_intp dims[] = {x_dim, y_dim, z_dim};
+    pyublas::numpy_vector<G4double> zeros(3, dims);
+    std::fill(zeros.begin(), zeros.end(), 0.0);
+
+    return zeros;
+}
+
+pyublas::numpy_vector<G4double> DoseGrid::Copy(G4double* histogram) {
+    npy_intp dims[] = {x_dim, y_dim, z_dim};
+    pyublas::numpy_vector<G4double> copy(3, dims);
+    std::copy(histogram, histogram + size, copy.begin());
+
+    return copy;
+}
+
+pyublas::numpy_vector<G4double> DoseGrid::GetUncertainty() {
+    // Without energy squared there is nothing to go on.
+    if (!keep_energysq)
+        return Zeros();
+
+    pyublas::numpy_vector<G4double> energy = GetEnergy();
+    pyublas::numpy_vector<G4double> energysq = GetEnergySq();
+
+    npy_intp dims[] = {x_dim, y_dim, z_dim};
+    pyublas::numpy_vector<G4double> uncertainty(3, dims);
+
+    G4double n = histories;
+
+    for (G4int i=0; i<size; i++)
+        uncertainty[i] = RelativeError(energy[i], energysq[i], n);
+
+    return uncertainty;
+}
+
+G4double DoseGrid::GetRegionUncertainty(G4double threshold) {
+    if (!keep_energysq)
+        return -1;
+
+    G4double n = histories;
+    G4double maximum = 0;
+
+    if (tiled) {
+        for (G4int b=0; b<brick_count; b++) {
+            DoseBrick* brick = master.bricks[b];
+            if (brick == NULL)
+                continue;
+
+            for (G4int j=0; j<512; j++) {
+                if (InGrid(b, j))
+                    maximum = std::max(maximum, brick->energy[j]);
+            }
+        }
+    } else {
+        for (G4int i=0; i<size; i++)
+            maximum = std::max(maximum, master.energy[i]);
+    }
+
+    if (maximum <= 0)
+        return -1;
+
+    // Voxels on the threshold count, so a lone hot voxel is still a region.
+    // Voxels that were never scored have no uncertainty to speak of and
+    // never count, whatever the threshold.
+    G4double cut = threshold*maximum;
+    G4double total = 0;
+    G4int voxels = 0;
+
+    if (tiled) {
+        for (G4int b=0; b<brick_count; b++) {
+            DoseBrick* brick = master.bricks[b];
+            if (brick == NULL)
+                continue;
+
+            for (G4int j=0; j<512; j++) {
+                if (brick->energy[j] <= 0 || brick->energy[j] < cut || !InGrid(b, j))
+                    continue;
+
+                total += RelativeError(brick->energy[j], brick->energysq[j], n);
+                voxels++;
+            }
+        }
+    } else {
+        for (G4int i=0; i<size; i++) {
+            if (master.energy[i] <= 0 || master.energy[i] < cut)
+                continue;
+
+            total += RelativeError(master.energy[i], master.energysq[i], n);
+            voxels++;
+        }
+    }
+
+    if (voxels == 0)
+        return -1;
+
+    return total / voxels;
+}
+
+boost::python::tuple DoseGrid::GetSparse() {
+    std::vector<int64_t> index;
+    std::vector<G4double> energy;
+    std::vector<G4double> energysq;
+    std::vector<G4double> counts;
+
+    if (tiled) {
+        for (G4int b=0; b<brick_count; b++) {
+            DoseBrick* brick = master.bricks[b];
+            if (brick == NULL)
+                continue;
+
+            G4int x0 = (b / (y_bricks*z_bricks)) * 8;
+            G4int y0 = ((b / z_bricks) % y_bricks) * 8;
+            G4int z0 = (b % z_bricks) * 8;
+
+            for (G4int j=0; j<512; j++) {
+                if (brick->energy[j] == 0 && (!keep_counts || brick->counts[j] == 0))
+                    continue;
+
+                G4int x = x0 + (j >> 6);
+                G4int y = y0 + ((j >> 3) & 7);
+                G4int z = z0 + (j & 7);
+
+                index.push_back(((int64_t) x*y_dim + y)*z_dim + z);
+                energy.push_back(brick->energy[j]);
+                energysq.push_back(keep_energysq ? brick->energysq[j] : 0);
+                counts.push_back(keep_counts ? brick->counts[j] : 0);
+            }
+        }
+    } else {
+        for (G4int i=0; i<size; i++) {
+            if (master.energy[i] == 0 && (!keep_counts || master.counts[i] == 0))
+                continue;
+
+            index.push_back(i);
+            energy.push_back(master.energy[i]);
+            energysq.push_back(keep_energysq ? master.energysq[i] : 0);
+            counts.push_back(keep_counts ? master.counts[i] : 0);
+        }
+    }
+
+    npy_intp dims[] = {(npy_intp) index.size()};
+    pyublas::numpy_vector<int64_t> index_array(1, dims);
+    pyublas::numpy_vector<G4double> energy_array(1, dims);
+    pyublas::numpy_vector<G4double> energysq_array(1, dims);
+    pyublas::numpy_vector<G4double> counts_array(1, dims);
+
+    std::copy(index.begin(), index.end(), index_array.begin());
+    std::copy(energy.begin(), energy.end(), energy_array.begin());
+    std::copy(energysq.begin(), energysq.end(), energysq_array.begin());
+    std::copy(counts.begin(), counts.end(), counts_array.begin());
+
+    return boost::python::make_tuple(index_array, energy_array,
+            energysq_array, counts_array);
+}
@@ -0,0 +1,168 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "DoseStatistics.hh"
+#include "SensitiveDetector.hh"
+
+#include "boost/bind.hpp"
+#include "boost/thread.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+
+DoseStatistics::DoseStatistics(SensitiveDetector* detector,
+        const std::vector<uint8_t>& labels, G4int label, G4int threads)
+    : detector(detector), labels(labels), label(label), sum(0) {
+    x_dim = detector->x_max - detector->x_min;
+    y_dim = detector->y_max - detector->y_min;
+    z_dim = detector->z_max - detector->z_min;
+
+    if (!detector->ScoresDose())
+        throw std::invalid_argument("DoseStatistics: the detector does not score dose");
+
+    if (!labels.empty() && (G4int) labels.size() != x_dim*y_dim*z_dim) {
+        std::ostringstream message;
+        message << "DoseStatistics: labels of " << labels.size() << " voxels do not match the "
+                << x_dim << "x" << y_dim << "x" << z_dim << " grid";
+        throw std::invalid_argument(message.str());
+    }
+
+    if (threads <= 0)
+        threads = std::max(1u, boost::thread::hardware_concurrency());
+
+    // Each thread takes every `threads`th slab along x, and the slabs are
+    // put back together in order.
+    std::vector<std::vector<G4double> > parts(threads);
+
+    boost::thread_group thread_group;
+    for (int i=0; i<threads; i++) {
+        thread_group.create_thread(boost::bind(&DoseStatistics::Gather,
+                    this, i, threads, &parts[i]));
+    }
+    thread_group.join_all();
+
+    for (int i=0; i<threads; i++)
+        doses.insert(doses.end(), parts[i].begin(), parts[i].end());
+
+    for (unsigned int i=0; i<doses.size(); i++)
+        sum += doses[i];
+
+    std::sort(doses.begin(), doses.end());
+}
+
+void DoseStatistics::Gather(G4int first, G4int stride, std::vector<G4double>* part) {
+    // Dose split over several grids, by particle for one, is their sum.
+    const std::vector<DoseGrid*>& grids = detector->dose_grids;
+    ScoringMask* mask = detector->mask;
+
+    for (G4int x=first; x<x_dim; x+=stride) {
+        for (G4int y=0; y<y_dim; y++) {
+            for (G4int z=0; z<z_dim; z++) {
+                G4int flat = (x*y_dim + y)*z_dim + z;
+                if (!labels.empty() && labels[flat] != label)
+                    continue;
+
+                G4int index;
+                if (mask) {
+                    if (!mask->Contains(flat))
+                        continue;
+                    index = mask->GetCompactIndex(flat);
+                } else {
+                    index = grids[0]->GetIndex(x, y, z);
+                }
+
+                G4double dose = 0;
+                for (unsigned int i=0; i<grids.size(); i++)
+                    dose += grids[i]->GetEnergyAt(index);
+                part->push_back(dose);
+            }
+        }
+    }
+}
+
+G4double DoseStatistics::GetMean() {
+    return doses.empty() ? 0 : sum / doses.size();
+}
+
+G4double DoseStatistics::GetMinimum() {
+    return doses.empty() ? 0 : doses.front();
+}
+
+G4double DoseStatistics::GetMaximum() {
+    return doses.empty() ? 0 : doses.back();
+}
+
+pyublas::numpy_vector<G4double> DoseStatistics::GetDifferential(G4int bins, G4double maximum) {
+    pyublas::numpy_vector<G4double> differential(bins);
+    std::fill(differential.begin(), differential.end(), 0.);
+
+    if (maximum <= 0)
+        maximum = GetMaximum();
+    if (doses.empty() || maximum <= 0)
+        return differential;
+
+    G4double width = maximum / bins;
+    G4double fraction = 1. / doses.size();
+
+    for (unsigned int i=0; i<doses.size(); i++) {
+        G4int bin = std::min(bins - 1, (G4int) (doses[i] / width));
+        differential[bin] += fraction;
+    }
+
+    return differential;
+}
+
+pyublas::numpy_vector<G4double> DoseStatistics::GetCumulative(G4int bins, G4double maximum) {
+    pyublas::numpy_vector<G4double> cumulative(bins);
+    std::fill(cumulative.begin(), cumulative.end(), 0.);
+
+    if (maximum <= 0)
+        maximum = GetMaximum();
+    if (doses.empty() || maximum <= 0)
+        return cumulative;
+
+    G4double width = maximum / bins;
+    for (G4int i=0; i<bins; i++)
+        cumulative[i] = GetVolume(i*width);
+
+    return cumulative;
+}
+
+G4double DoseStatistics::GetDose(G4double volume) {
+    if (doses.empty())
+        return 0;
+
+    G4int hottest = (G4int) std::ceil(volume*doses.size());
+    hottest = std::max(1, std::min((G4int) doses.size(), hottest));
+
+    return doses[doses.size() - hottest];
+}
+
+G4double DoseStatistics::GetVolume(G4double dose) {
+    if (doses.empty())
+        return 0;
+
+    std::vector<G4double>::iterator it = std::lower_bound(doses.begin(), doses.end(), dose);
+    return (G4double) (doses.end() - it) / doses.size();
+}
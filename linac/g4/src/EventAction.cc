@@ -20,9 +20,11 @@
 
 
 #include "EventAction.hh"
+#include "DetectorConstruction.hh"
 
 #include "G4Event.hh"
 #include "G4EventManager.hh"
+#include "G4RunManager.hh"
 
 
 EventAction::EventAction()
@@ -39,5 +41,8 @@ void EventAction::BeginOfEventAction(const G4Event*)
 
 void EventAction::EndOfEventAction(const G4Event*)
 {
+    DetectorConstruction* detector_construction = (DetectorConstruction*)
+        (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+    detector_construction->CheckpointIfDue();
 }
 
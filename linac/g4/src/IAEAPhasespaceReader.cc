@@ -0,0 +1,262 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "IAEAPhasespaceReader.hh"
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+
+static G4bool EndsWith(const G4String& text, const G4String& suffix) {
+    return text.size() >= suffix.size() &&
+        text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static void SwapBytes(char* word) {
+    std::swap(word[0], word[3]);
+    std::swap(word[1], word[2]);
+}
+
+
+G4String IAEAPhasespaceReader::GetStem(G4String filename) {
+    if (EndsWith(filename, ".IAEAphsp"))
+        return filename.substr(0, filename.size() - 9);
+    if (EndsWith(filename, ".IAEAheader"))
+        return filename.substr(0, filename.size() - 11);
+
+    return filename;
+}
+
+IAEAPhasespaceReader::IAEAPhasespaceReader(G4String filename) {
+    G4String stem = GetStem(filename);
+
+    record_count = 0;
+    original_histories = 0;
+    current_record = 0;
+    skipped_records = 0;
+    record_length = 0;
+    swap_bytes = false;
+    input_file_stream = NULL;
+
+    if (!ReadHeader(stem + ".IAEAheader")) {
+        G4cout << "Could not read IAEA header: " << stem << ".IAEAheader" << G4endl;
+        record_count = 0;
+        return;
+    }
+
+    input_file_stream = new std::ifstream((stem + ".IAEAphsp").c_str(), std::ios::binary);
+    buffer.resize(record_length);
+    extra_floats.resize(extra_float_types.size());
+    extra_longs.resize(extra_long_types.size());
+}
+
+IAEAPhasespaceReader::~IAEAPhasespaceReader() {
+    delete input_file_stream;
+}
+
+G4bool IAEAPhasespaceReader::ReadHeader(G4String filename) {
+    std::ifstream header(filename.c_str());
+    if (!header.is_open())
+        return false;
+
+    // Collect the values listed under each $SECTION:, dropping comments.
+    std::map<G4String, std::vector<G4String> > sections;
+    G4String section;
+    std::string line;
+    while (std::getline(header, line)) {
+        size_t comment = line.find("//");
+        if (comment != std::string::npos)
+            line = line.substr(0, comment);
+
+        std::istringstream tokens(line);
+        std::string token;
+        if (!(tokens >> token))
+            continue;
+
+        if (token[0] == '$') {
+            section = token.substr(1, token.find(':') - 1);
+            sections[section];
+            continue;
+        }
+
+        // Each line holds one value, except the statistics tables.
+        sections[section].push_back(token);
+    }
+
+    std::vector<G4String>& contents = sections["RECORD_CONTENTS"];
+    if (contents.size() < 9)
+        return false;
+
+    for (int i=0; i<7; i++) {
+        stored[i] = std::atoi(contents[i].c_str()) != 0;
+        constant[i] = 0;
+    }
+
+    int n_floats = std::atoi(contents[7].c_str());
+    int n_longs = std::atoi(contents[8].c_str());
+    if ((int) contents.size() < 9 + n_floats + n_longs)
+        return false;
+
+    for (int i=0; i<n_floats; i++)
+        extra_float_types.push_back(std::atoi(contents[9 + i].c_str()));
+    for (int i=0; i<n_longs; i++)
+        extra_long_types.push_back(std::atoi(contents[9 + n_floats + i].c_str()));
+
+    std::vector<G4String>& constants = sections["RECORD_CONSTANT"];
+    unsigned int next_constant = 0;
+    for (int i=0; i<7; i++) {
+        if (!stored[i] && next_constant < constants.size())
+            constant[i] = std::atof(constants[next_constant++].c_str());
+    }
+
+    // W is never in the record itself, only the sign of the particle type.
+    record_length = 1 + sizeof(float);
+    for (int i=0; i<7; i++) {
+        if (stored[i] && i != 5)
+            record_length += sizeof(float);
+    }
+    record_length += (n_floats + n_longs)*4;
+
+    if (!sections["RECORD_LENGTH"].empty()) {
+        G4int header_length = std::atoi(sections["RECORD_LENGTH"][0].c_str());
+        if (header_length != record_length) {
+            G4cout << "IAEA record length " << header_length << " does not match "
+                   << "$RECORD_CONTENTS (" << record_length << ")" << G4endl;
+            return false;
+        }
+    }
+
+    if (!sections["BYTE_ORDER"].empty())
+        swap_bytes = sections["BYTE_ORDER"][0] == "4321";
+
+    if (!sections["PARTICLES"].empty())
+        record_count = std::atoll(sections["PARTICLES"][0].c_str());
+    if (!sections["ORIG_HISTORIES"].empty())
+        original_histories = std::atoll(sections["ORIG_HISTORIES"][0].c_str());
+
+    const char* names[] = {"PHOTONS", "ELECTRONS", "POSITRONS", "NEUTRONS", "PROTONS"};
+    for (int i=0; i<5; i++) {
+        if (!sections[names[i]].empty())
+            particle_counts[names[i]] = std::atoll(sections[names[i]][0].c_str());
+    }
+
+    return true;
+}
+
+G4bool IAEAPhasespaceReader::Read(PhasespaceRecord& record) {
+    if (input_file_stream == NULL)
+        return false;
+
+    while (current_record < record_count) {
+        input_file_stream->read(&buffer[0], record_length);
+        if (!input_file_stream->good())
+            return false;
+
+        current_record++;
+
+        G4int type = std::abs((int) (signed char) buffer[0]);
+        if (type != IAEA_PHOTON && type != IAEA_ELECTRON && type != IAEA_POSITRON) {
+            skipped_records++;
+            continue;
+        }
+
+        Parse(&buffer[0], record);
+        return true;
+    }
+
+    return false;
+}
+
+void IAEAPhasespaceReader::Parse(const char* data, PhasespaceRecord& record) {
+    signed char type = data[0];
+    const char* next = data + 1;
+
+    float energy;
+    std::memcpy(&energy, next, sizeof(float));
+    if (swap_bytes) SwapBytes((char*) &energy);
+    next += sizeof(float);
+
+    // x, y, z, u, v, w, weight, taken from the header when not stored
+    G4double values[7];
+    for (int i=0; i<7; i++) {
+        values[i] = constant[i];
+        if (stored[i] && i != 5) {
+            float value;
+            std::memcpy(&value, next, sizeof(float));
+            if (swap_bytes) SwapBytes((char*) &value);
+            values[i] = value;
+            next += sizeof(float);
+        }
+    }
+
+    for (unsigned int i=0; i<extra_floats.size(); i++) {
+        std::memcpy(&extra_floats[i], next, sizeof(float));
+        if (swap_bytes) SwapBytes((char*) &extra_floats[i]);
+        next += sizeof(float);
+    }
+
+    for (unsigned int i=0; i<extra_longs.size(); i++) {
+        std::memcpy(&extra_longs[i], next, sizeof(int32_t));
+        if (swap_bytes) SwapBytes((char*) &extra_longs[i]);
+        next += sizeof(int32_t);
+    }
+
+    G4double u = values[3];
+    G4double v = values[4];
+    G4double w = std::sqrt(std::max(0., 1 - u*u - v*v));
+    if (type < 0)
+        w = -w;
+
+    record.new_history = energy < 0;
+    record.kinetic_energy = std::abs(energy)*MeV;
+
+    record.particle_type = 0;
+    G4double mass = 0;
+    if (std::abs(type) == IAEA_ELECTRON) {
+        record.particle_type = -1;
+        mass = electron_mass_c2;
+    } else if (std::abs(type) == IAEA_POSITRON) {
+        record.particle_type = 1;
+        mass = electron_mass_c2;
+    }
+
+    G4double momentum = std::sqrt(record.kinetic_energy*(record.kinetic_energy + 2*mass));
+
+    record.position_x = values[0]*cm;
+    record.position_y = values[1]*cm;
+    record.position_z = values[2]*cm;
+    record.momentum_x = u*momentum;
+    record.momentum_y = v*momentum;
+    record.momentum_z = w*momentum;
+    record.weight = stored[6] ? values[6] : (constant[6] != 0 ? constant[6] : 1.);
+}
+
+G4bool IAEAPhasespaceReader::Seek(int64_t index) {
+    if (input_file_stream == NULL || index < 0 || index > record_count)
+        return false;
+
+    input_file_stream->clear();
+    input_file_stream->seekg(index*record_length);
+    current_record = index;
+
+    return input_file_stream->good();
+}
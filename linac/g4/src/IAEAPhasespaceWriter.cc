@@ -0,0 +1,186 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "IAEAPhasespaceWriter.hh"
+#include "IAEAPhasespaceReader.hh"
+
+#include <cfloat>
+#include <cstring>
+#include <iomanip>
+
+
+// type, energy, x, y, z, u, v, weight and one extra long
+static const int IAEA_RECORD_LENGTH = 1 + 7*sizeof(float) + sizeof(int32_t);
+
+
+IAEAPhasespaceWriter::IAEAPhasespaceWriter(G4String filename) {
+    stem = IAEAPhasespaceReader::GetStem(filename);
+
+    record_count = 0;
+    original_histories = 0;
+    last_history = 0;
+
+    for (int i=0; i<3; i++) {
+        position_min[i] = DBL_MAX;
+        position_max[i] = -DBL_MAX;
+    }
+
+    output_file_stream = new std::ofstream((stem + ".IAEAphsp").c_str(), std::ios::binary);
+}
+
+IAEAPhasespaceWriter::~IAEAPhasespaceWriter() {
+    Close();
+    delete output_file_stream;
+}
+
+void IAEAPhasespaceWriter::Write(const PhasespaceRecord& record) {
+    G4int type = IAEA_PHOTON;
+    if (record.particle_type == -1) {
+        type = IAEA_ELECTRON;
+    } else if (record.particle_type == 1) {
+        type = IAEA_POSITRON;
+    }
+
+    G4double momentum = std::sqrt(record.momentum_x*record.momentum_x +
+            record.momentum_y*record.momentum_y + record.momentum_z*record.momentum_z);
+    G4double u = momentum > 0 ? record.momentum_x / momentum : 0;
+    G4double v = momentum > 0 ? record.momentum_y / momentum : 0;
+    G4double w = momentum > 0 ? record.momentum_z / momentum : 0;
+
+    // W is not stored, only its sign as the sign of the particle type.
+    // A negative energy flags the first particle of a new history.
+    char buffer[IAEA_RECORD_LENGTH];
+    buffer[0] = w < 0 ? -type : type;
+
+    float values[7];
+    values[0] = record.new_history ? -record.kinetic_energy : record.kinetic_energy;
+    values[1] = record.position_x / cm;
+    values[2] = record.position_y / cm;
+    values[3] = record.position_z / cm;
+    values[4] = u;
+    values[5] = v;
+    values[6] = record.weight;
+    std::memcpy(&buffer[1], values, sizeof(values));
+
+    // Records read back from a file do not know their history, histories
+    // that left nothing behind in it are then lost.
+    int64_t history = record.history;
+    if (history <= last_history)
+        history = last_history + (record.new_history ? 1 : 0);
+
+    int32_t increment = history - last_history;
+    last_history = history;
+    std::memcpy(&buffer[1 + sizeof(values)], &increment, sizeof(increment));
+
+    output_file_stream->write(buffer, IAEA_RECORD_LENGTH);
+    record_count++;
+
+    if (statistics.count(type) == 0) {
+        Statistics empty = {0, 0, DBL_MAX, -DBL_MAX, 0, DBL_MAX, -DBL_MAX};
+        statistics[type] = empty;
+    }
+
+    Statistics& s = statistics[type];
+    s.count++;
+    s.weight += record.weight;
+    s.weight_min = std::min(s.weight_min, record.weight);
+    s.weight_max = std::max(s.weight_max, record.weight);
+    s.energy += record.weight*record.kinetic_energy;
+    s.energy_min = std::min(s.energy_min, record.kinetic_energy);
+    s.energy_max = std::max(s.energy_max, record.kinetic_energy);
+
+    G4double position[3] = {values[1], values[2], values[3]};
+    for (int i=0; i<3; i++) {
+        position_min[i] = std::min(position_min[i], position[i]);
+        position_max[i] = std::max(position_max[i], position[i]);
+    }
+}
+
+void IAEAPhasespaceWriter::Close() {
+    if (!output_file_stream->is_open())
+        return;
+
+    output_file_stream->close();
+    WriteHeader();
+}
+
+void IAEAPhasespaceWriter::WriteHeader() {
+    std::ofstream header((stem + ".IAEAheader").c_str());
+
+    header << "$IAEA_INDEX:" << std::endl << "0" << std::endl << std::endl;
+    header << "$TITLE:" << std::endl << stem << std::endl << std::endl;
+    header << "$FILE_TYPE:" << std::endl << "0" << std::endl << std::endl;
+    header << "$CHECKSUM:" << std::endl << record_count*IAEA_RECORD_LENGTH << std::endl << std::endl;
+
+    header << "$RECORD_CONTENTS:" << std::endl;
+    header << "    1     // X is stored ?" << std::endl;
+    header << "    1     // Y is stored ?" << std::endl;
+    header << "    1     // Z is stored ?" << std::endl;
+    header << "    1     // U is stored ?" << std::endl;
+    header << "    1     // V is stored ?" << std::endl;
+    header << "    1     // W is stored ?" << std::endl;
+    header << "    1     // Weight is stored ?" << std::endl;
+    header << "    0     // Extra floats stored ?" << std::endl;
+    header << "    1     // Extra longs stored ?" << std::endl;
+    header << "    " << IAEA_NEW_HISTORY_NUMBER
+           << "     // Incremental history number stored in the extralong array [ 0]" << std::endl;
+    header << std::endl;
+
+    header << "$RECORD_CONSTANT:" << std::endl << std::endl;
+    header << "$RECORD_LENGTH:" << std::endl << IAEA_RECORD_LENGTH << std::endl << std::endl;
+    header << "$BYTE_ORDER:" << std::endl << "1234" << std::endl << std::endl;
+    header << "$ORIG_HISTORIES:" << std::endl << original_histories << std::endl << std::endl;
+    header << "$PARTICLES:" << std::endl << record_count << std::endl << std::endl;
+
+    const char* names[] = {"", "PHOTONS", "ELECTRONS", "POSITRONS"};
+    for (int type=IAEA_PHOTON; type<=IAEA_POSITRON; type++) {
+        int64_t count = statistics.count(type) ? statistics[type].count : 0;
+        header << "$" << names[type] << ":" << std::endl << count << std::endl << std::endl;
+    }
+
+    header << "$TRANSPORT_PARAMETERS:" << std::endl << std::endl;
+    header << "$MACHINE_TYPE:" << std::endl << std::endl;
+    header << "$MONTE_CARLO_CODE_VERSION:" << std::endl << "GEANT4" << std::endl << std::endl;
+    header << "$GLOBAL_PHOTON_ENERGY_CUTOFF:" << std::endl << std::endl;
+    header << "$GLOBAL_PARTICLE_ENERGY_CUTOFF:" << std::endl << std::endl;
+    header << "$COORDINATE_SYSTEM_DESCRIPTION:" << std::endl << std::endl;
+
+    header << "//  OPTIONAL INFORMATION" << std::endl << std::endl;
+
+    header << std::scientific << std::setprecision(5);
+    header << "$STATISTICAL_INFORMATION_PARTICLES:" << std::endl;
+    header << "//        Weight        Wmin         Wmax       <E>         Emin         Emax    Particle" << std::endl;
+    std::map<G4int, Statistics>::iterator it;
+    for (it=statistics.begin(); it!=statistics.end(); it++) {
+        Statistics& s = it->second;
+        header << "   " << s.weight << "  " << s.weight_min << "  " << s.weight_max
+               << "  " << s.energy / s.weight << "  " << s.energy_min << "  " << s.energy_max
+               << "   " << names[it->first] << std::endl;
+    }
+    header << std::endl;
+
+    header << "$STATISTICAL_INFORMATION_GEOMETRY:" << std::endl;
+    if (record_count > 0) {
+        for (int i=0; i<3; i++)
+            header << "   " << position_min[i] << "   " << position_max[i] << std::endl;
+    }
+    header << std::endl;
+}
@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "IndexingPhasespaceWriter.hh"
+
+
+IndexingPhasespaceWriter::IndexingPhasespaceWriter(PhasespaceWriter* writer,
+        G4String filename) {
+    this->writer = writer;
+    this->filename = filename;
+
+    closed = false;
+}
+
+IndexingPhasespaceWriter::~IndexingPhasespaceWriter() {
+    Close();
+    delete writer;
+}
+
+void IndexingPhasespaceWriter::Write(const PhasespaceRecord& record) {
+    index.Add(record);
+    writer->Write(record);
+}
+
+void IndexingPhasespaceWriter::WriteBlock(const std::vector<PhasespaceRecord>& block) {
+    for (unsigned int i=0; i<block.size(); i++)
+        index.Add(block[i]);
+
+    writer->WriteBlock(block);
+}
+
+void IndexingPhasespaceWriter::Close() {
+    if (closed)
+        return;
+
+    writer->Close();
+    index.Save(filename);
+    closed = true;
+}
@@ -0,0 +1,125 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "MappedHistogram.hh"
+
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+MappedHistogram::MappedHistogram() {
+    mapping = NULL;
+    mapping_size = 0;
+    data = NULL;
+    existed = false;
+}
+
+MappedHistogram::~MappedHistogram() {
+    if (mapping) {
+        msync(mapping, mapping_size, MS_SYNC);
+        munmap(mapping, mapping_size);
+    }
+}
+
+std::string MappedHistogram::MakeHeader(G4String descr, const std::vector<int64_t>& shape) {
+    std::ostringstream dict;
+    dict << "{'descr': '" << descr << "', 'fortran_order': False, 'shape': (";
+    for (unsigned int i=0; i<shape.size(); i++)
+        dict << shape[i] << ", ";
+    dict << "), }";
+
+    // Magic, version and length take 10 bytes, the data starts on a 64
+    // byte boundary after the newline ending the padded dictionary.
+    std::string header = dict.str();
+    size_t total = 10 + header.size() + 1;
+    header.append((64 - total % 64) % 64, ' ');
+    header += '\n';
+
+    uint16_t length = header.size();
+    std::string preamble("\x93NUMPY\x01\x00", 8);
+    preamble += (char) (length & 0xff);
+    preamble += (char) (length >> 8);
+
+    return preamble + header;
+}
+
+G4bool MappedHistogram::Open(G4String filename, G4String descr,
+        const std::vector<int64_t>& shape) {
+    std::string header = MakeHeader(descr, shape);
+
+    size_t count = 1;
+    for (unsigned int i=0; i<shape.size(); i++)
+        count *= shape[i];
+    size_t size = header.size() + count*8;
+
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        G4cout << "Could not open histogram file: " << filename << G4endl;
+        return false;
+    }
+
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+    existed = file_stat.st_size > 0;
+
+    if (existed) {
+        // Only ever pick up a file written for exactly this grid.
+        std::string found(header.size(), '\0');
+        if ((size_t) file_stat.st_size != size ||
+                pread(fd, &found[0], header.size(), 0) != (ssize_t) header.size() ||
+                found != header) {
+            G4cout << "Histogram file does not match the grid, leaving it alone: "
+                   << filename << G4endl;
+            close(fd);
+            return false;
+        }
+    } else {
+        if (ftruncate(fd, size) != 0 ||
+                pwrite(fd, header.data(), header.size(), 0) != (ssize_t) header.size()) {
+            G4cout << "Could not write histogram file: " << filename << G4endl;
+            close(fd);
+            return false;
+        }
+    }
+
+    mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        G4cout << "Could not map histogram file: " << filename << G4endl;
+        mapping = NULL;
+        return false;
+    }
+
+    mapping_size = size;
+    data = (char*) mapping + header.size();
+    return true;
+}
+
+void MappedHistogram::Sync() {
+    if (mapping)
+        msync(mapping, mapping_size, MS_SYNC);
+}
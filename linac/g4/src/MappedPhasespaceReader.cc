@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "MappedPhasespaceReader.hh"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+MappedPhasespaceReader::MappedPhasespaceReader(G4String filename, G4bool sequential) {
+    this->filename = filename;
+
+    mapping = NULL;
+    mapping_size = 0;
+    records = NULL;
+    record_size = 0;
+    record_count = 0;
+    current_record = 0;
+    begin_record = 0;
+    end_record = 0;
+    timing = false;
+    first_timed_record = 0;
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        G4cout << "Could not open phasespace file: " << filename << G4endl;
+        return;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size < (off_t) sizeof(PhasespaceHeader)) {
+        close(fd);
+        return;
+    }
+
+    mapping_size = file_stat.st_size;
+    mapping = mmap(NULL, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        G4cout << "Could not map phasespace file: " << filename << G4endl;
+        mapping = NULL;
+        return;
+    }
+
+    const PhasespaceHeader* header = (const PhasespaceHeader*) mapping;
+    if (std::memcmp(header->magic, PHASESPACE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version > PHASESPACE_VERSION ||
+            header->length_unit != mm || header->energy_unit != MeV) {
+        G4cout << "Only fixed width phasespace files in mm/MeV can be mapped: "
+               << filename << G4endl;
+        munmap(mapping, mapping_size);
+        mapping = NULL;
+        return;
+    }
+
+    record_size = header->record_size;
+    record_count = header->record_count;
+
+    // Never trust the count past the end of the file.
+    int64_t available = (mapping_size - sizeof(PhasespaceHeader)) / record_size;
+    if (record_count > available)
+        record_count = available;
+
+    records = (const char*) mapping + sizeof(PhasespaceHeader);
+    end_record = record_count;
+
+    phasespace_index = PhasespaceIndex::Load(filename);
+
+    // Let the kernel read ahead aggressively and drop pages behind us.
+    madvise(mapping, mapping_size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+}
+
+MappedPhasespaceReader::~MappedPhasespaceReader() {
+    if (mapping)
+        munmap(mapping, mapping_size);
+}
+
+G4bool MappedPhasespaceReader::Read(PhasespaceRecord& record) {
+    const PackedPhasespaceRecord* packed = Next();
+    if (packed == NULL)
+        return false;
+
+    record = PhasespaceRecord(*packed);
+    return true;
+}
+
+G4bool MappedPhasespaceReader::Seek(int64_t index) {
+    if (index < 0 || begin_record + index > end_record)
+        return false;
+
+    current_record = begin_record + index;
+    timing = false;
+    return true;
+}
+
+G4bool MappedPhasespaceReader::SetRange(int64_t begin, int64_t end) {
+    if (begin < 0 || end > record_count || begin > end)
+        return false;
+
+    begin_record = begin;
+    end_record = end;
+    return Seek(0);
+}
+
+G4double MappedPhasespaceReader::GetRecordsPerSecond() {
+    timer.Stop();
+
+    G4double elapsed = timer.GetRealElapsed();
+    if (!timing || elapsed <= 0)
+        return 0;
+
+    return (current_record - first_timed_record) / elapsed;
+}
+
+void MappedPhasespaceReader::PrintStatistics() {
+    G4cout << "Mapped phasespace source: " << filename << G4endl;
+    G4cout << "    Records consumed:  " << current_record - begin_record
+           << " of " << GetRecordCount() << G4endl;
+    G4cout << "    Records/s:         " << GetRecordsPerSecond() << G4endl;
+}
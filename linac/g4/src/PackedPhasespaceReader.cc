@@ -0,0 +1,78 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "PackedPhasespaceReader.hh"
+
+#include <cstring>
+
+
+PackedPhasespaceReader::PackedPhasespaceReader(G4String filename) {
+    std::memset(&header, 0, sizeof(header));
+    current_record = 0;
+
+    input_file_stream = new std::ifstream(filename.c_str(), std::ios::binary);
+    input_file_stream->read((char*) &header, sizeof(header));
+
+    if (std::memcmp(header.magic, PHASESPACE_MAGIC, sizeof(header.magic)) != 0) {
+        G4cout << "Not a packed phasespace file: " << filename << G4endl;
+        header.record_count = 0;
+    } else if (header.version > PHASESPACE_VERSION) {
+        G4cout << "Unsupported phasespace version " << header.version
+               << " in " << filename << G4endl;
+        header.record_count = 0;
+    }
+}
+
+PackedPhasespaceReader::~PackedPhasespaceReader() {
+    delete input_file_stream;
+}
+
+G4bool PackedPhasespaceReader::Read(PhasespaceRecord& record) {
+    if (current_record >= (int64_t) header.record_count)
+        return false;
+
+    PackedPhasespaceRecord packed;
+    input_file_stream->read((char*) &packed, sizeof(packed));
+
+    // Newer versions may only ever append fields to each record.
+    if (header.record_size > sizeof(packed))
+        input_file_stream->seekg(header.record_size - sizeof(packed), std::ios::cur);
+
+    if (!input_file_stream->good())
+        return false;
+
+    // Units are fixed at mm and MeV for now, but honour the header anyway.
+    record = PhasespaceRecord(packed, header.length_unit, header.energy_unit);
+
+    current_record++;
+    return true;
+}
+
+G4bool PackedPhasespaceReader::Seek(int64_t index) {
+    if (index < 0 || index > (int64_t) header.record_count)
+        return false;
+
+    input_file_stream->clear();
+    input_file_stream->seekg(sizeof(header) + index*header.record_size);
+    current_record = index;
+
+    return input_file_stream->good();
+}
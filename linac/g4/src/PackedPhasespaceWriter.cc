@@ -0,0 +1,78 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "PackedPhasespaceWriter.hh"
+
+#include <cstring>
+
+
+PackedPhasespaceWriter::PackedPhasespaceWriter(G4String filename) {
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PHASESPACE_MAGIC, sizeof(header.magic));
+    header.version = PHASESPACE_VERSION;
+    header.record_size = sizeof(PackedPhasespaceRecord);
+    header.record_count = 0;
+    header.length_unit = mm;
+    header.energy_unit = MeV;
+
+    output_file_stream = new std::ofstream(filename.c_str(), std::ios::binary);
+    WriteHeader();
+}
+
+PackedPhasespaceWriter::~PackedPhasespaceWriter() {
+    Close();
+    delete output_file_stream;
+}
+
+void PackedPhasespaceWriter::Write(const PhasespaceRecord& record) {
+    PackedPhasespaceRecord packed = record.Pack();
+    output_file_stream->write((char*) &packed, sizeof(packed));
+
+    header.record_count++;
+}
+
+void PackedPhasespaceWriter::WriteBlock(const std::vector<PhasespaceRecord>& block) {
+    if (block.empty())
+        return;
+
+    packed_block.resize(block.size());
+    for (unsigned int i=0; i<block.size(); i++)
+        packed_block[i] = block[i].Pack();
+
+    output_file_stream->write((char*) &packed_block[0],
+            packed_block.size()*sizeof(PackedPhasespaceRecord));
+
+    header.record_count += block.size();
+}
+
+void PackedPhasespaceWriter::Close() {
+    if (!output_file_stream->is_open())
+        return;
+
+    // The record count is only known now, so go back and fix up the header.
+    output_file_stream->seekp(0);
+    WriteHeader();
+    output_file_stream->close();
+}
+
+void PackedPhasespaceWriter::WriteHeader() {
+    output_file_stream->write((char*) &header, sizeof(header));
+}
@@ -31,6 +31,13 @@
 #include "G4VisAttributes.hh"
 #include "G4Color.hh"
 
+#ifdef G4MULTITHREADED
+#include "G4Threading.hh"
+
+// The copy the calling worker thread has of each master detector.
+static G4ThreadLocal std::map<G4VSensitiveDetector*, G4VSensitiveDetector*>* worker_detectors = NULL;
+#endif
+
 
 ParallelDetectorConstruction::ParallelDetectorConstruction(G4String name)
     : G4VUserParallelWorld(name)
@@ -51,6 +58,41 @@ void ParallelDetectorConstruction::Construct()
     world_logical->SetVisAttributes(G4VisAttributes::Invisible);
 }
 
+#ifdef G4MULTITHREADED
+void ParallelDetectorConstruction::ConstructSD()
+{
+    // The master attached its own detectors as the phasespaces and meshes
+    // were added, each worker needs a copy of every one.
+    if (!G4Threading::IsWorkerThread())
+        return;
+
+    std::map<G4String, Phasespace*>::iterator it;
+    for (it=phasespaces.begin(); it!=phasespaces.end(); it++)
+        AttachWorker(it->first, it->second);
+
+    std::map<G4String, ScoringMesh*>::iterator mesh;
+    for (mesh=meshes.begin(); mesh!=meshes.end(); mesh++)
+        AttachWorker(mesh->first, mesh->second);
+}
+
+template<class Detector>
+void ParallelDetectorConstruction::AttachWorker(G4String name, Detector* master)
+{
+    if (!worker_detectors)
+        worker_detectors = new std::map<G4VSensitiveDetector*, G4VSensitiveDetector*>();
+
+    // Made once per worker, however often the geometry is rebuilt.
+    G4VSensitiveDetector* worker = (*worker_detectors)[master];
+    if (worker == NULL) {
+        worker = master->MakeWorker();
+        (*worker_detectors)[master] = worker;
+        G4SDManager::GetSDMpointer()->AddNewDetector(worker);
+    }
+
+    SetSensitiveDetector(volumes[name], worker);
+}
+#endif
+
 G4VPhysicalVolume* ParallelDetectorConstruction::AddPhasespace(char* name, double radius, double z_position, bool kill)
 {
     if (verbose >= 4)
@@ -70,6 +112,7 @@ G4VPhysicalVolume* ParallelDetectorConstruction::AddPhasespace(char* name, doubl
     Phasespace* phasespace_sensitive_detector = new Phasespace(name, radius - (radius*0.01));
     phasespace_sensitive_detector->SetKillAtPlane(kill);
     phasespaces[name] = phasespace_sensitive_detector;
+    volumes[name] = logical;
 
     G4SDManager* sensitive_detector_manager = G4SDManager::GetSDMpointer();
     sensitive_detector_manager->AddNewDetector(phasespace_sensitive_detector);
@@ -82,8 +125,12 @@ G4VPhysicalVolume* ParallelDetectorConstruction::AddPhasespace(char* name, doubl
 void ParallelDetectorConstruction::RemovePhasespace(char* name) {
     if (verbose >=4)
         G4cout << "DetectorConstruction::RemovePhasespace" << G4endl;
-   
+
+    // Flush everything still buffered before the file is read back.
+    if (phasespaces.count(name))
+        phasespaces[name]->Close();
     phasespaces.erase(name);
+    volumes.erase(name);
 
     DetectorConstruction* detector = (DetectorConstruction*) G4RunManager::GetRunManager()->GetUserDetectorConstruction();
 
@@ -92,3 +139,108 @@ void ParallelDetectorConstruction::RemovePhasespace(char* name) {
     G4RunManager::GetRunManager()->GeometryHasBeenModified();
 }
 
+
+Phasespace* ParallelDetectorConstruction::GetPhasespace(G4String name) {
+    if (phasespaces.count(name))
+        return phasespaces[name];
+
+    return NULL;
+}
+
+
+void ParallelDetectorConstruction::ClosePhasespaces() {
+    if (verbose >=4)
+        G4cout << "DetectorConstruction::ClosePhasespaces" << G4endl;
+
+    std::map<G4String, Phasespace*>::iterator it;
+    for (it=phasespaces.begin(); it!=phasespaces.end(); it++) {
+        (it->second)->Close();
+    }
+}
+
+
+G4VPhysicalVolume* ParallelDetectorConstruction::AddScoringMesh(char* name,
+        ScoringMesh::Shape shape, G4ThreeVector size,
+        G4int x_bins, G4int y_bins, G4int z_bins,
+        G4ThreeVector translation, G4ThreeVector rotation)
+{
+    if (verbose >= 4)
+        G4cout << "DetectorConstruction::AddScoringMesh: " << name << G4endl;
+
+    if (meshes.count(name)) {
+        G4cout << "DetectorConstruction::AddScoringMesh: there is already a mesh called "
+               << name << ", ignored." << G4endl;
+        return NULL;
+    }
+
+    G4RotationMatrix* rot = new G4RotationMatrix();
+    rot->rotateX(rotation.x()*deg);
+    rot->rotateY(rotation.y()*deg);
+    rot->rotateZ(rotation.z()*deg);
+
+    G4VSolid* solid;
+    if (shape == ScoringMesh::kCylinder) {
+        solid = new G4Tubs(name, 0, size.x(), size.z()/2., 0, 360*deg);
+    } else {
+        solid = new G4Box(name, size.x()/2., size.y()/2., size.z()/2.);
+    }
+
+    G4LogicalVolume* logical = new G4LogicalVolume(solid, 0, name, 0, 0, 0);
+    logical->SetVisAttributes(new G4VisAttributes(G4Color(0, 1, 1, 0.5)));
+
+    G4VPhysicalVolume* physical = new G4PVPlacement(rot, translation,
+            logical, name, world_logical, false, 0);
+
+    ScoringMesh* mesh = new ScoringMesh(name, shape, size, x_bins, y_bins, z_bins);
+    meshes[name] = mesh;
+    volumes[name] = logical;
+
+    G4SDManager* sensitive_detector_manager = G4SDManager::GetSDMpointer();
+    sensitive_detector_manager->AddNewDetector(mesh);
+    logical->SetSensitiveDetector(mesh);
+
+    G4RunManager::GetRunManager()->GeometryHasBeenModified();
+    return physical;
+}
+
+
+void ParallelDetectorConstruction::RemoveScoringMesh(char* name) {
+    if (verbose >=4)
+        G4cout << "DetectorConstruction::RemoveScoringMesh" << G4endl;
+
+    // The detector stays with the SD manager, only stop it scoring.
+    if (meshes.count(name))
+        meshes[name]->Activate(false);
+    meshes.erase(name);
+    volumes.erase(name);
+
+    DetectorConstruction* detector = (DetectorConstruction*) G4RunManager::GetRunManager()->GetUserDetectorConstruction();
+
+    G4VPhysicalVolume* physical = detector->FindVolume(name, world_physical);
+    delete physical;
+    G4RunManager::GetRunManager()->GeometryHasBeenModified();
+}
+
+
+ScoringMesh* ParallelDetectorConstruction::GetScoringMesh(G4String name) {
+    if (meshes.count(name))
+        return meshes[name];
+
+    return NULL;
+}
+
+
+void ParallelDetectorConstruction::ReduceScoringMeshes() {
+    std::map<G4String, ScoringMesh*>::iterator it;
+    for (it=meshes.begin(); it!=meshes.end(); it++) {
+        (it->second)->GetDoseGrid()->Reduce();
+    }
+}
+
+
+void ParallelDetectorConstruction::ZeroScoringMeshes() {
+    std::map<G4String, ScoringMesh*>::iterator it;
+    for (it=meshes.begin(); it!=meshes.end(); it++) {
+        (it->second)->GetDoseGrid()->Zero();
+    }
+}
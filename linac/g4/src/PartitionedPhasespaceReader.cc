@@ -0,0 +1,66 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "PartitionedPhasespaceReader.hh"
+
+
+PartitionedPhasespaceReader::PartitionedPhasespaceReader(PhasespaceReader* reader,
+        int64_t begin, int64_t end) {
+    this->reader = reader;
+    this->begin = begin;
+    this->end = end;
+
+    current_record = end;
+    Seek(0);
+}
+
+PartitionedPhasespaceReader::~PartitionedPhasespaceReader() {
+    delete reader;
+}
+
+G4bool PartitionedPhasespaceReader::Read(PhasespaceRecord& record) {
+    if (current_record >= end)
+        return false;
+
+    int64_t skipped = reader->GetSkippedCount();
+    if (!reader->Read(record))
+        return false;
+
+    // Records skipped on the way still belong to the range.
+    current_record += 1 + reader->GetSkippedCount() - skipped;
+    if (current_record > end) {
+        current_record = end;
+        return false;
+    }
+
+    return true;
+}
+
+G4bool PartitionedPhasespaceReader::Seek(int64_t index) {
+    if (index < 0 || begin + index > end)
+        return false;
+
+    if (!reader->Seek(begin + index))
+        return false;
+
+    current_record = begin + index;
+    return true;
+}
@@ -22,6 +22,13 @@
 #include "globals.hh"
 
 #include "Phasespace.hh"
+#include "PackedPhasespaceWriter.hh"
+#include "CompressedPhasespaceWriter.hh"
+#include "IAEAPhasespaceWriter.hh"
+#include "IAEAPhasespaceReader.hh"
+#include "AsyncPhasespaceWriter.hh"
+#include "IndexingPhasespaceWriter.hh"
+#include "ShardedPhasespaceReader.hh"
 #include "DetectorConstruction.hh"
 
 
@@ -36,35 +43,103 @@
 #include "G4SteppingManager.hh"
 #include "G4ThreeVector.hh"
 
-#include <fstream>
+#ifdef G4MULTITHREADED
+#include "G4Threading.hh"
+#endif
 
 
 Phasespace::Phasespace(const G4String& name, G4double radius) : G4VSensitiveDetector(name) {
 
 //    debug = false;
     this->name = name;
+    shard = -1;
     kill = true;   
  
-    output_file_stream = new std::ofstream(name, std::ios::binary);
-    phasespace_archive = new boost::archive::binary_oarchive(*output_file_stream);
+    writer = NULL;
+    compressed = false;
     
     detector_construction = (DetectorConstruction*) (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
 
     this->radius = radius;
     record_count = 0;
+    history_count = 0;
+    new_history = true;
 }
 
 Phasespace::~Phasespace() {
     Close();
-//    delete output_file_stream;
-//    delete phasespace_archive;
+    delete writer;
+}
+
+void Phasespace::Open() {
+    if (writer)
+        return;
+
+#ifdef G4MULTITHREADED
+    // Every worker has its own copy of this detector, give each a file.
+    if (G4Threading::IsWorkerThread())
+        shard = G4Threading::G4GetThreadId();
+#endif
+
+    G4String filename = name;
+    if (shard >= 0)
+        filename = ShardedPhasespaceReader::GetShardFilename(name, shard);
+
+    PhasespaceWriter* file_writer;
+    if (IAEAPhasespaceReader::GetStem(filename) != filename) {
+        file_writer = new IAEAPhasespaceWriter(filename);
+    } else if (compressed) {
+        file_writer = new CompressedPhasespaceWriter(filename, compression_level, delta,
+                position_step, direction_step, energy_step);
+    } else {
+        file_writer = new PackedPhasespaceWriter(filename);
+    }
+
+    // Tracking only fills in-memory blocks, the file and its index are
+    // written from a background thread.
+    writer = new AsyncPhasespaceWriter(new IndexingPhasespaceWriter(file_writer, filename));
+}
+
+Phasespace* Phasespace::MakeWorker() {
+    Phasespace* worker = new Phasespace(name, radius);
+    worker->kill = kill;
+
+    worker->compressed = compressed;
+    worker->compression_level = compression_level;
+    worker->delta = delta;
+    worker->position_step = position_step;
+    worker->direction_step = direction_step;
+    worker->energy_step = energy_step;
+
+    boost::mutex::scoped_lock lock(workers_mutex);
+    workers.push_back(worker);
+
+    return worker;
 }
 
 void Phasespace::Close() {
-    output_file_stream->close();
+    // The workers write the shards, the master never sees an event.
+    if (!workers.empty()) {
+        boost::mutex::scoped_lock lock(workers_mutex);
+        for (unsigned int i=0; i<workers.size(); i++)
+            workers[i]->Close();
+        return;
+    }
+
+    // Always leave a file behind, even if no event reached us.
+    Open();
+    writer->SetOriginalHistories(history_count);
+    writer->Close();
 }
 
 void Phasespace::Initialize(G4HCofThisEvent*) {
+    // The file format can be changed up until the first event.
+    Open();
+
+    // Called at the start of every event, the next record we write is
+    // the first one for this primary history.
+    new_history = true;
+    history_count++;
 }
 
 G4bool Phasespace::ProcessHits(G4Step* aStep, G4TouchableHistory* touchable) {
@@ -79,8 +154,11 @@ G4bool Phasespace::ProcessHits(G4Step* aStep, G4TouchableHistory* touchable) {
         return false; 
 
     PhasespaceRecord record = PhasespaceRecord(aStep);    
+    record.new_history = new_history;
+    record.history = history_count;
+    new_history = false;
 
-    *phasespace_archive << record;
+    writer->Write(record);
 
     if (kill)
         aStep->GetTrack()->SetTrackStatus(fStopAndKill);
@@ -0,0 +1,185 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "PhasespaceBlockCodec.hh"
+
+#include "boost/iostreams/filtering_stream.hpp"
+#include "boost/iostreams/filter/zstd.hpp"
+#include "boost/iostreams/device/array.hpp"
+#include "boost/iostreams/device/back_inserter.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+
+// x, y, z, u, v, w, kinetic energy and weight
+static const int FLOAT_COLUMNS = 8;
+
+
+static float* GetColumn(PackedPhasespaceRecord& record, int column) {
+    if (column < 3)
+        return &record.position[column];
+    if (column < 6)
+        return &record.direction[column - 3];
+    if (column == 6)
+        return &record.kinetic_energy;
+    return &record.weight;
+}
+
+
+// The nearest multiple of `step`, values past what an int32_t holds are
+// clamped to its ends rather than wrapped around.
+static int32_t Quantise(float value, float step) {
+    double steps = std::floor((double) value/step + 0.5);
+
+    if (steps < std::numeric_limits<int32_t>::min())
+        return std::numeric_limits<int32_t>::min();
+    if (!(steps <= std::numeric_limits<int32_t>::max()))
+        return std::numeric_limits<int32_t>::max();
+
+    return (int32_t) steps;
+}
+
+
+PhasespaceBlockCodec::PhasespaceBlockCodec(const CompressedPhasespaceHeader& header, int level) {
+    this->header = header;
+    this->level = level;
+}
+
+PhasespaceBlockCodec::~PhasespaceBlockCodec() {
+}
+
+float PhasespaceBlockCodec::GetStep(int column) const {
+    if (!(header.encoding & PHASESPACE_ENCODING_QUANTIZED))
+        return 0;
+
+    if (column < 3)
+        return header.position_step;
+    if (column < 6)
+        return header.direction_step;
+    if (column == 6)
+        return header.energy_step;
+
+    // Weights are always kept exactly.
+    return 0;
+}
+
+void PhasespaceBlockCodec::Encode(const std::vector<PackedPhasespaceRecord>& records,
+        std::vector<char>& compressed) const {
+    unsigned int n = records.size();
+    compressed.clear();
+    if (n == 0)
+        return;
+
+    std::vector<char> raw(n*(FLOAT_COLUMNS*sizeof(uint32_t) + 2));
+    uint32_t* words = (uint32_t*) &raw[0];
+
+    for (int column=0; column<FLOAT_COLUMNS; column++) {
+        float step = GetStep(column);
+        uint32_t previous = 0;
+
+        for (unsigned int i=0; i<n; i++) {
+            float value = *GetColumn(const_cast<PackedPhasespaceRecord&>(records[i]), column);
+
+            uint32_t word;
+            if (step > 0) {
+                word = (uint32_t) Quantise(value, step);
+            } else {
+                std::memcpy(&word, &value, sizeof(word));
+            }
+
+            if (header.encoding & PHASESPACE_ENCODING_DELTA) {
+                // Quantised values are integers and difference well, the
+                // raw float bits do better with an xor.
+                uint32_t delta = step > 0 ? word - previous : word ^ previous;
+                previous = word;
+                word = delta;
+            }
+
+            words[column*n + i] = word;
+        }
+    }
+
+    char* bytes = &raw[n*FLOAT_COLUMNS*sizeof(uint32_t)];
+    for (unsigned int i=0; i<n; i++) {
+        bytes[i] = records[i].particle_type;
+        bytes[n + i] = records[i].flags;
+    }
+
+    boost::iostreams::filtering_ostream output;
+    output.push(boost::iostreams::zstd_compressor(boost::iostreams::zstd_params(level)));
+    output.push(boost::iostreams::back_inserter(compressed));
+    output.write(&raw[0], raw.size());
+    output.reset();
+}
+
+bool PhasespaceBlockCodec::Decode(const std::vector<char>& compressed, unsigned int record_count,
+        std::vector<PackedPhasespaceRecord>& records) const {
+    unsigned int n = record_count;
+    if (n == 0 || compressed.empty()) {
+        records.clear();
+        return n == 0;
+    }
+
+    std::vector<char> raw(n*(FLOAT_COLUMNS*sizeof(uint32_t) + 2));
+
+    boost::iostreams::filtering_istream input;
+    input.push(boost::iostreams::zstd_decompressor());
+    input.push(boost::iostreams::array_source(&compressed[0], compressed.size()));
+    input.read(&raw[0], raw.size());
+
+    if ((size_t) input.gcount() != raw.size())
+        return false;
+
+    records.resize(n);
+    const uint32_t* words = (const uint32_t*) &raw[0];
+
+    for (int column=0; column<FLOAT_COLUMNS; column++) {
+        float step = GetStep(column);
+        uint32_t previous = 0;
+
+        for (unsigned int i=0; i<n; i++) {
+            uint32_t word = words[column*n + i];
+
+            if (header.encoding & PHASESPACE_ENCODING_DELTA) {
+                word = step > 0 ? word + previous : word ^ previous;
+                previous = word;
+            }
+
+            float* value = GetColumn(records[i], column);
+            if (step > 0) {
+                *value = ((int32_t) word) * step;
+            } else {
+                std::memcpy(value, &word, sizeof(word));
+            }
+        }
+    }
+
+    const char* bytes = &raw[n*FLOAT_COLUMNS*sizeof(uint32_t)];
+    for (unsigned int i=0; i<n; i++) {
+        records[i].particle_type = bytes[i];
+        records[i].flags = bytes[n + i];
+        records[i].reserved = 0;
+    }
+
+    return true;
+}
@@ -0,0 +1,183 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "PhasespaceIndex.hh"
+#include "PhasespaceReader.hh"
+
+#include "boost/archive/text_oarchive.hpp"
+#include "boost/archive/text_iarchive.hpp"
+
+#include <fstream>
+#include <limits>
+
+
+PhasespaceIndex::PhasespaceIndex(G4int block_size) {
+    this->block_size = block_size;
+
+    record_count = 0;
+    original_histories = 0;
+
+    for (int i=0; i<INDEX_PARTICLE_TYPES; i++) {
+        particle_count[i] = 0;
+        weight_sum[i] = 0;
+    }
+
+    for (int i=0; i<INDEX_FIELDS; i++) {
+        minimum[i] = std::numeric_limits<G4double>::max();
+        maximum[i] = -std::numeric_limits<G4double>::max();
+    }
+}
+
+void PhasespaceIndex::Add(const PhasespaceRecord& record) {
+    // PhasespaceRecord getters are not const.
+    PhasespaceRecord r = record;
+
+    G4int type = r.GetParticleType() + 1;
+    if (type < 0 || type >= INDEX_PARTICLE_TYPES)
+        return;
+
+    if (record_count % block_size == 0) {
+        PhasespaceIndexBlock block;
+        block.first_record = record_count;
+        block.record_count = 0;
+        for (int i=0; i<INDEX_PARTICLE_TYPES; i++)
+            block.particle_count[i] = 0;
+        blocks.push_back(block);
+    }
+
+    PhasespaceIndexBlock& block = blocks.back();
+    block.record_count++;
+    block.particle_count[type]++;
+
+    record_count++;
+    particle_count[type]++;
+    weight_sum[type] += r.GetWeight();
+
+    G4ThreeVector position = r.GetPosition();
+    G4ThreeVector direction = r.GetMomentum().unit();
+
+    G4double values[INDEX_FIELDS] = {
+        position.x(), position.y(), position.z(),
+        direction.x(), direction.y(), direction.z(),
+        r.GetKineticEnergy(), r.GetWeight()
+    };
+
+    for (int i=0; i<INDEX_FIELDS; i++) {
+        if (values[i] < minimum[i])
+            minimum[i] = values[i];
+        if (values[i] > maximum[i])
+            maximum[i] = values[i];
+    }
+}
+
+void PhasespaceIndex::Append(const PhasespaceIndex& other) {
+    for (unsigned int i=0; i<other.blocks.size(); i++) {
+        PhasespaceIndexBlock block = other.blocks[i];
+        block.first_record += record_count;
+        blocks.push_back(block);
+    }
+
+    record_count += other.record_count;
+    original_histories += other.original_histories;
+
+    for (int i=0; i<INDEX_PARTICLE_TYPES; i++) {
+        particle_count[i] += other.particle_count[i];
+        weight_sum[i] += other.weight_sum[i];
+    }
+
+    for (int i=0; i<INDEX_FIELDS; i++) {
+        if (other.minimum[i] < minimum[i])
+            minimum[i] = other.minimum[i];
+        if (other.maximum[i] > maximum[i])
+            maximum[i] = other.maximum[i];
+    }
+}
+
+G4String PhasespaceIndex::GetIndexFilename(G4String filename) {
+    return filename + ".index";
+}
+
+G4bool PhasespaceIndex::Save(G4String filename) {
+    std::ofstream output_file_stream(GetIndexFilename(filename).c_str());
+    if (!output_file_stream.is_open()) {
+        G4cout << "Could not write phasespace index for: " << filename << G4endl;
+        return false;
+    }
+
+    boost::archive::text_oarchive archive(output_file_stream);
+    archive << *this;
+
+    return true;
+}
+
+PhasespaceIndex* PhasespaceIndex::Load(G4String filename) {
+    std::ifstream input_file_stream(GetIndexFilename(filename).c_str());
+    if (!input_file_stream.is_open())
+        return NULL;
+
+    PhasespaceIndex* index = new PhasespaceIndex();
+    try {
+        boost::archive::text_iarchive archive(input_file_stream);
+        archive >> *index;
+    } catch (...) {
+        G4cout << "Ignoring unreadable phasespace index for: " << filename << G4endl;
+        delete index;
+        return NULL;
+    }
+
+    return index;
+}
+
+PhasespaceIndex* PhasespaceIndex::Build(PhasespaceReader* reader, G4int block_size) {
+    PhasespaceIndex* index = new PhasespaceIndex(block_size);
+
+    PhasespaceRecord record;
+    while (reader->Read(record)) {
+        index->Add(record);
+        if (record.IsNewHistory())
+            index->original_histories++;
+    }
+
+    return index;
+}
+
+void PhasespaceIndex::Print() {
+    const char* names[INDEX_PARTICLE_TYPES] = {"electrons", "photons", "positrons"};
+    const char* fields[INDEX_FIELDS] = {"x", "y", "z", "u", "v", "w", "energy", "weight"};
+
+    G4cout << "Phasespace index" << G4endl;
+    G4cout << "    Records:             " << record_count << G4endl;
+    G4cout << "    Original histories:  " << original_histories << G4endl;
+    G4cout << "    Blocks:              " << blocks.size() << G4endl;
+
+    for (int i=0; i<INDEX_PARTICLE_TYPES; i++) {
+        G4cout << "    " << names[i] << ": " << particle_count[i]
+               << " (weight " << weight_sum[i] << ")" << G4endl;
+    }
+
+    if (record_count == 0)
+        return;
+
+    for (int i=0; i<INDEX_FIELDS; i++) {
+        G4cout << "    " << fields[i] << ": [" << minimum[i] << ", "
+               << maximum[i] << "]" << G4endl;
+    }
+}
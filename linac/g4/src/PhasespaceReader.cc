@@ -0,0 +1,134 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "PhasespaceReader.hh"
+#include "PhasespaceFormat.hh"
+#include "PackedPhasespaceReader.hh"
+#include "CompressedPhasespaceReader.hh"
+#include "IAEAPhasespaceReader.hh"
+#include "ArchivePhasespaceReader.hh"
+#include "ShardedPhasespaceReader.hh"
+
+#include <fstream>
+#include <cstring>
+#include <unistd.h>
+
+
+PhasespaceReader::PhasespaceReader() {
+    phasespace_index = NULL;
+}
+
+PhasespaceReader::~PhasespaceReader() {
+    delete phasespace_index;
+}
+
+PhasespaceReader* PhasespaceReader::Open(G4String filename) {
+    // Worker shards that have not been merged read as one file.
+    if (access(filename.c_str(), R_OK) != 0) {
+        std::vector<G4String> shards = ShardedPhasespaceReader::FindShards(filename);
+        if (!shards.empty()) {
+            G4cout << "Reading " << shards.size() << " phasespace shards as one: "
+                   << filename << G4endl;
+            return new ShardedPhasespaceReader(shards);
+        }
+    }
+
+    PhasespaceReader* reader = OpenFile(filename);
+
+    if (reader)
+        reader->phasespace_index = PhasespaceIndex::Load(filename);
+
+    return reader;
+}
+
+PhasespaceReader* PhasespaceReader::OpenFile(G4String filename) {
+    // IAEA files have no magic number, go by the extension instead.
+    if (IAEAPhasespaceReader::GetStem(filename) != filename)
+        return new IAEAPhasespaceReader(filename);
+
+    std::ifstream input_file_stream(filename.c_str(), std::ios::binary);
+    if (!input_file_stream.is_open()) {
+        G4cout << "Could not open phasespace file: " << filename << G4endl;
+        return NULL;
+    }
+
+    char magic[sizeof(PHASESPACE_MAGIC)];
+    std::memset(magic, 0, sizeof(magic));
+    input_file_stream.read(magic, sizeof(magic));
+    input_file_stream.close();
+
+    if (std::memcmp(magic, PHASESPACE_MAGIC, sizeof(magic)) == 0)
+        return new PackedPhasespaceReader(filename);
+
+    if (std::memcmp(magic, COMPRESSED_PHASESPACE_MAGIC, sizeof(magic)) == 0)
+        return new CompressedPhasespaceReader(filename);
+
+    // Anything else is assumed to be a boost::serialization archive
+    // written before the packed format existed.
+    G4cout << "Reading legacy phasespace archive: " << filename << G4endl;
+    return new ArchivePhasespaceReader(filename);
+}
+
+int64_t PhasespaceReader::FindHistoryStart(int64_t index) {
+    int64_t record_count = GetRecordCount();
+    if (index >= record_count || !Seek(index))
+        return record_count;
+
+    PhasespaceRecord record;
+    int64_t skipped = GetSkippedCount();
+    while (Read(record)) {
+        index += GetSkippedCount() - skipped;
+        skipped = GetSkippedCount();
+
+        if (record.IsNewHistory())
+            return index;
+        index++;
+    }
+
+    return record_count;
+}
+
+G4bool PhasespaceReader::GetPartition(int64_t index, int64_t count,
+        G4bool align_histories, int64_t& begin, int64_t& end) {
+    int64_t record_count = GetRecordCount();
+    if (record_count < 0 || count < 1 || index < 0 || index >= count)
+        return false;
+
+    begin = record_count*index/count;
+    end = record_count*(index + 1)/count;
+
+    if (!align_histories)
+        return true;
+
+    // Files written without history flags have nothing to align to.
+    PhasespaceRecord first;
+    if (!Seek(0) || !Read(first) || !first.IsNewHistory()) {
+        G4cout << "Phasespace has no history boundaries, splitting by record" << G4endl;
+        return true;
+    }
+
+    // Every partition moves its ends the same way, so neighbours still
+    // meet exactly and no record is lost or replayed twice.
+    begin = FindHistoryStart(begin);
+    end = FindHistoryStart(end);
+
+    return true;
+}
@@ -31,7 +31,8 @@
 
 
 PhasespaceRecord::PhasespaceRecord() {
-
+    new_history = false;
+    history = 0;
 }
 
 PhasespaceRecord::PhasespaceRecord(G4Step* step) {
@@ -57,6 +58,31 @@ PhasespaceRecord::PhasespaceRecord(G4Step* step) {
     } else {
         particle_type = 0;
     }
+
+    new_history = false;
+    history = 0;
+}
+
+PhasespaceRecord::PhasespaceRecord(const PackedPhasespaceRecord& packed,
+        G4double length_unit, G4double energy_unit) {
+    position_x = packed.position[0] * length_unit;
+    position_y = packed.position[1] * length_unit;
+    position_z = packed.position[2] * length_unit;
+
+    // Packed records only keep the direction, recover the momentum
+    // magnitude from the kinetic energy and rest mass.
+    kinetic_energy = packed.kinetic_energy * energy_unit;
+    G4double mass = packed.particle_type == 0 ? 0 : electron_mass_c2;
+    G4double momentum = std::sqrt(kinetic_energy*(kinetic_energy + 2*mass));
+
+    momentum_x = packed.direction[0] * momentum;
+    momentum_y = packed.direction[1] * momentum;
+    momentum_z = packed.direction[2] * momentum;
+
+    weight = packed.weight;
+    particle_type = packed.particle_type;
+    new_history = (packed.flags & PHASESPACE_NEW_HISTORY) != 0;
+    history = 0;
 }
 
 PhasespaceRecord::~PhasespaceRecord() {
@@ -78,6 +104,15 @@ void PhasespaceRecord::serialize(Archive & ar, const unsigned int version);
 G4bool PhasespaceRecord::CheckIt(G4double xlow, G4double xhigh,
         G4double ylow, G4double yhigh,
         G4double zlow, G4double zhigh)
+{
+    return CheckPosition(position_x, position_y, position_z,
+            xlow, xhigh, ylow, yhigh, zlow, zhigh);
+}
+
+G4bool PhasespaceRecord::CheckPosition(G4double position_x, G4double position_y,
+        G4double position_z, G4double xlow, G4double xhigh,
+        G4double ylow, G4double yhigh,
+        G4double zlow, G4double zhigh)
 {
     if ((isnan(position_x)) ||
         (isnan(position_y)) ||
@@ -127,3 +162,35 @@ G4int PhasespaceRecord::GetParticleType() {
 G4double PhasespaceRecord::GetWeight() {
     return weight;
 }
+
+G4bool PhasespaceRecord::IsNewHistory() {
+    return new_history;
+}
+
+PackedPhasespaceRecord PhasespaceRecord::Pack() const {
+    PackedPhasespaceRecord packed;
+
+    packed.position[0] = position_x;
+    packed.position[1] = position_y;
+    packed.position[2] = position_z;
+
+    G4double momentum = std::sqrt(momentum_x*momentum_x +
+            momentum_y*momentum_y + momentum_z*momentum_z);
+    if (momentum > 0) {
+        packed.direction[0] = momentum_x / momentum;
+        packed.direction[1] = momentum_y / momentum;
+        packed.direction[2] = momentum_z / momentum;
+    } else {
+        packed.direction[0] = 0;
+        packed.direction[1] = 0;
+        packed.direction[2] = 0;
+    }
+
+    packed.kinetic_energy = kinetic_energy;
+    packed.weight = weight;
+    packed.particle_type = particle_type;
+    packed.flags = new_history ? PHASESPACE_NEW_HISTORY : 0;
+    packed.reserved = 0;
+
+    return packed;
+}
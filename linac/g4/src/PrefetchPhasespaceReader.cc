@@ -0,0 +1,117 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "PrefetchPhasespaceReader.hh"
+
+#include <unistd.h>
+
+
+PrefetchPhasespaceReader::PrefetchPhasespaceReader(PhasespaceReader* reader,
+        G4int depth) {
+    this->reader = reader;
+
+    ring = new boost::lockfree::spsc_queue<PhasespaceRecord>(depth);
+    stalls = 0;
+
+    Start();
+}
+
+PrefetchPhasespaceReader::~PrefetchPhasespaceReader() {
+    Stop();
+
+    delete ring;
+    delete reader;
+}
+
+void PrefetchPhasespaceReader::Start() {
+    stopping = false;
+    finished = false;
+    exhausted = false;
+
+    prefetch_thread = boost::thread(&PrefetchPhasespaceReader::Run, this);
+    owner = getpid();
+}
+
+void PrefetchPhasespaceReader::Stop() {
+    // After a fork the thread is left behind in the parent, there is
+    // nothing here to join.
+    if (getpid() == owner) {
+        stopping = true;
+        prefetch_thread.join();
+    }
+
+    PhasespaceRecord record;
+    while (ring->pop(record)) {}
+}
+
+G4bool PrefetchPhasespaceReader::Read(PhasespaceRecord& record) {
+    G4bool stalled = false;
+
+    while (!ring->pop(record)) {
+        if (finished) {
+            // The producer may have pushed its last records just before
+            // finishing, so look once more before giving up.
+            if (ring->pop(record))
+                return true;
+
+            exhausted = true;
+            return false;
+        }
+
+        if (!stalled) {
+            stalled = true;
+            stalls++;
+        }
+        boost::this_thread::yield();
+    }
+
+    return true;
+}
+
+G4bool PrefetchPhasespaceReader::Seek(int64_t index) {
+    Stop();
+    G4bool found = reader->Seek(index);
+    Start();
+
+    return found;
+}
+
+void PrefetchPhasespaceReader::Run() {
+    PhasespaceRecord record;
+    G4bool pending = false;
+
+    while (!stopping) {
+        if (!pending) {
+            if (!reader->Read(record))
+                break;
+            pending = true;
+        }
+
+        if (ring->push(record)) {
+            pending = false;
+        } else {
+            // Buffer is full, the event loop is the bottleneck.
+            boost::this_thread::sleep(boost::posix_time::microseconds(100));
+        }
+    }
+
+    finished = true;
+}
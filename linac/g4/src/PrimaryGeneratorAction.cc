@@ -32,8 +32,10 @@
 #include "G4ParticleDefinition.hh"
 
 
-PrimaryGeneratorAction::PrimaryGeneratorAction()
+PrimaryGeneratorAction::PrimaryGeneratorAction(PrimaryGeneratorAction* master)
 {
+    this->master = master;
+
     phasespace_particle_gun = new G4ParticleGun();
     particle_gun = new G4GeneralParticleSource();
 
@@ -46,6 +48,11 @@ PrimaryGeneratorAction::PrimaryGeneratorAction()
     particle_gun->GetCurrentSource()->GetPosDist()->SetPosDisType("Beam");
     particle_gun->GetCurrentSource()->GetPosDist()->SetBeamSigmaInR(1*mm);
     particle_gun->GetCurrentSource()->GetEneDist()->SetMonoEnergy(6*MeV);
+
+    gun_position = G4ThreeVector();
+    gun_direction = G4ThreeVector(0, 0, -1);
+    gun_energy = 6;
+    gun_fwhm = 1;
  
 //    particle_gun->SetParticleDefinition(particle);
 //    particle_gun->SetParticlePosition(G4ThreeVector(0., 0., 1005.));
@@ -53,7 +60,29 @@ PrimaryGeneratorAction::PrimaryGeneratorAction()
 //    particle_gun->SetParticleMomentumDirection(G4ThreeVector(0.,0.,-1.));
     
     redistribute = false;
+    batch_recycling = false;
     rotation = G4ThreeVector();
+
+    from_phasespace = false;
+    phasespace_reader = NULL;
+    mapped_reader = NULL;
+    memory_mapped = false;
+    prefetch_reader = NULL;
+    source_index = NULL;
+    prefetch_depth = 0;
+    source_exhausted = false;
+    record_valid = false;
+
+    partition_index = 0;
+    partition_count = 1;
+    range_begin = 0;
+    range_end = -1;
+
+    event_seeding = false;
+    event_seed = 0;
+    seed_run = 0;
+    first_event = 0;
+
     Reset();
 }
 
@@ -68,46 +97,189 @@ void PrimaryGeneratorAction::Reset()
 
 PrimaryGeneratorAction::~PrimaryGeneratorAction()
 {
+    if (phasespace_reader)
+        delete phasespace_reader;
 }
 
 
+void PrimaryGeneratorAction::SetSource(char* phasespace)
+{
+    // Closed either way, which also stops any prefetch thread.
+    if (phasespace_reader)
+        delete phasespace_reader;
+    phasespace_reader = NULL;
+    mapped_reader = NULL;
+    prefetch_reader = NULL;
+    source_index = NULL;
+
+    if (phasespace == NULL) {
+        G4cout << "Not using phasespace file as particle source, running from GPS" << G4endl;
+        from_phasespace = false;
+        return;
+    }
+
+    G4cout << "Using phasespace file as particle source: " << phasespace << G4endl;
+
+    if (memory_mapped) {
+        mapped_reader = new MappedPhasespaceReader(phasespace);
+        if (mapped_reader->IsMapped()) {
+            phasespace_reader = mapped_reader;
+        } else {
+            G4cout << "Falling back to reading the phasespace file" << G4endl;
+            delete mapped_reader;
+            mapped_reader = NULL;
+        }
+    }
+
+    if (!phasespace_reader)
+        phasespace_reader = PhasespaceReader::Open(phasespace);
+
+    // Owned by the file reader, which lives as long as any wrapper.
+    if (phasespace_reader)
+        source_index = phasespace_reader->GetIndex();
+
+    if (phasespace_reader && !RestrictSource()) {
+        delete phasespace_reader;
+        phasespace_reader = NULL;
+        mapped_reader = NULL;
+        source_index = NULL;
+    }
+
+    if (source_index)
+        source_index->Print();
+
+    // The mapped reader never waits on the disk itself.
+    if (phasespace_reader && !mapped_reader && prefetch_depth > 0) {
+        prefetch_reader = new PrefetchPhasespaceReader(phasespace_reader,
+                prefetch_depth);
+        phasespace_reader = prefetch_reader;
+    }
+
+    from_phasespace = phasespace_reader != NULL;
+    source_exhausted = false;
+
+    particle_gun->GetCurrentSource()->GetPosDist()->SetPosDisType("Point");
+    phasespace_record_repeat = 0;
+}
+
+void PrimaryGeneratorAction::Synchronise()
+{
+    if (!master)
+        return;
+
+    SetPosition(master->gun_position);
+    SetDirection(master->gun_direction);
+    SetEnergy(master->gun_energy);
+    SetFWHM(master->gun_fwhm);
+
+    from_phasespace = master->from_phasespace;
+    {
+        boost::mutex::scoped_lock lock(master->source_mutex);
+        source_exhausted = master->source_exhausted;
+    }
+
+    recycling_number = master->recycling_number;
+    redistribute = master->redistribute;
+    batch_recycling = master->batch_recycling;
+    rotation = master->rotation;
+    copy_rotations.clear();
+
+    xlow = master->xlow;
+    xhigh = master->xhigh;
+    ylow = master->ylow;
+    yhigh = master->yhigh;
+    zlow = master->zlow;
+    zhigh = master->zhigh;
+
+    event_seeding = master->event_seeding;
+    event_seed = master->event_seed;
+    seed_run = master->seed_run;
+    first_event = master->first_event;
+}
+
+G4bool PrimaryGeneratorAction::RestrictSource()
+{
+    if (partition_count == 1 && range_begin == 0 && range_end < 0)
+        return true;
+
+    int64_t begin = range_begin;
+    int64_t end = range_end;
+
+    if (partition_count > 1) {
+        if (!phasespace_reader->GetPartition(partition_index, partition_count,
+                    true, begin, end)) {
+            G4cout << "Cannot partition phasespace without a record count" << G4endl;
+            return false;
+        }
+    } else if (end < 0) {
+        end = phasespace_reader->GetRecordCount();
+        if (end < 0) {
+            G4cout << "Cannot take a record range of a phasespace without a record count" << G4endl;
+            return false;
+        }
+    }
+
+    G4cout << "Replaying phasespace records " << begin << " to " << end << G4endl;
+
+    if (mapped_reader)
+        return mapped_reader->SetRange(begin, end);
+
+    phasespace_reader = new PartitionedPhasespaceReader(phasespace_reader, begin, end);
+    return true;
+}
+
 void PrimaryGeneratorAction::GeneratePrimaries(G4Event* event)
 {
-    if (from_phasespace) {
+    // Before anything is drawn for the event, the gun included.
+    if (event_seeding)
+        SeedEvent(event->GetEventID());
+
+    if (from_phasespace && batch_recycling) {
+        GenerateBatchedPhasespacePrimaries(event);
+    } else if (from_phasespace) {
         GeneratePhasespacePrimaries(event);
     } else {
         particle_gun->GeneratePrimaryVertex(event);
     }
 }
 
-void PrimaryGeneratorAction::GeneratePhasespacePrimaries(G4Event* event)
+void PrimaryGeneratorAction::SeedEvent(G4int event_id)
 {
-    if (phasespace_record_repeat == 0) {
+    // Counter based: the seeds are a hash of the run and event numbers,
+    // nothing is carried over from the events before.
+    uint64_t key = Mix(Mix(Mix((uint64_t) event_seed) ^ (uint64_t) seed_run)
+            ^ (uint64_t) (first_event + event_id));
 
-        phasespace_record = PhasespaceRecord();
-        try {
-            *phasespace_archive >> phasespace_record;
-        } catch (...) {
-            G4cout << "ABORTING RUN" << G4endl;
-            G4cout << "Particles in phasespace: " << count << G4endl;
+    // Positive and non-zero like the seeds Geant4 hands its own workers,
+    // and zero terminated.
+    long seeds[3];
+    seeds[0] = (long) (key & 0x7fffffff);
+    seeds[1] = (long) ((key >> 32) & 0x7fffffff);
+    seeds[2] = 0;
+    if (seeds[0] == 0)
+        seeds[0] = 1;
+    if (seeds[1] == 0)
+        seeds[1] = 1;
 
-            phasespace_record_repeat = 0;
-            count = 0;
+#ifdef G4MULTITHREADED
+    // The engine of this worker thread.
+    G4Random::setTheSeeds(seeds);
+#else
+    CLHEP::HepRandom::setTheSeeds(seeds);
+#endif
+}
 
-            G4RunManager* run_manager = G4RunManager::GetRunManager();
-            run_manager->AbortRun(); 
-        }
-  
-        G4ParticleDefinition* particle = gamma; 
+void PrimaryGeneratorAction::GeneratePhasespacePrimaries(G4Event* event)
+{
+    if (source_exhausted)
+        return;
 
-        if (phasespace_record.GetParticleType() == -1) {
-            particle = electron;
-        } else if (phasespace_record.GetParticleType() == 1) {
-            particle = positron;
-        } 
+    if (phasespace_record_repeat == 0) {
 
-        phasespace_particle_gun->SetParticleDefinition(particle);
-        phasespace_particle_gun->SetParticleEnergy(phasespace_record.GetKineticEnergy());
+        if (!ReadPhasespaceRecord()) {
+            SourceExhausted();
+            return;
+        }
     }
 
     phasespace_record_repeat++;
@@ -118,12 +290,12 @@ void PrimaryGeneratorAction::GeneratePhasespacePrimaries(G4Event* event)
     }
 
     // Sanity check
-    if (phasespace_record.CheckIt(xlow, xhigh, ylow, yhigh, zlow, zhigh) == false) { 
+    if (record_valid == false) { 
        return;
     } 
 
-    G4ThreeVector pos = G4ThreeVector(phasespace_record.GetPosition());
-    G4ThreeVector mom = G4ThreeVector(phasespace_record.GetMomentum());
+    G4ThreeVector pos = record_position;
+    G4ThreeVector mom = record_direction;
 
     if (redistribute) {
         G4double angle = G4UniformRand() * 360.0*deg;
@@ -140,6 +312,148 @@ void PrimaryGeneratorAction::GeneratePhasespacePrimaries(G4Event* event)
     phasespace_particle_gun->SetParticleMomentumDirection(mom);
 
     phasespace_particle_gun->GeneratePrimaryVertex(event);
-    event->GetPrimaryVertex()->SetWeight(phasespace_record.GetWeight());
+    event->GetPrimaryVertex()->SetWeight(record_weight);
+}
+
+void PrimaryGeneratorAction::GenerateBatchedPhasespacePrimaries(G4Event* event)
+{
+    if (source_exhausted)
+        return;
+
+    if (!ReadPhasespaceRecord()) {
+        SourceExhausted();
+        return;
+    }
+
+    count++;
+
+    // Sanity check
+    if (record_valid == false) { 
+       return;
+    } 
+
+    // Same number of uses per record as one-copy-per-event recycling.
+    G4int copies = recycling_number + 1;
+    if ((G4int) copy_rotations.size() != copies)
+        PrepareCopyRotations(copies);
+
+    G4ThreeVector pos = record_position;
+    G4ThreeVector mom = record_direction;
+
+    // One random turn per record, the copies are spread evenly from it.
+    if (redistribute) {
+        G4double angle = G4UniformRand() * 360.0*deg;
+
+        pos.rotateZ(angle);
+        mom.rotateZ(angle);
+    }
+
+    G4double weight = record_weight / copies;
+
+    for (G4int i=0; i<copies; i++) {
+        phasespace_particle_gun->SetParticlePosition(copy_rotations[i] * pos);
+        phasespace_particle_gun->SetParticleMomentumDirection(copy_rotations[i] * mom);
+
+        phasespace_particle_gun->GeneratePrimaryVertex(event);
+        event->GetPrimaryVertex(i)->SetWeight(weight);
+    }
+}
+
+void PrimaryGeneratorAction::PrepareCopyRotations(G4int copies)
+{
+    copy_rotations.clear();
+
+    for (G4int i=0; i<copies; i++) {
+        G4RotationMatrix copy_rotation;
+
+        if (redistribute)
+            copy_rotation.rotateZ(i * 360.0*deg / copies);
+
+        // gantry rotation correction
+        copy_rotation.rotateY(-rotation.y()*deg);
+
+        copy_rotations.push_back(copy_rotation);
+    }
+}
+
+void PrimaryGeneratorAction::SourceExhausted()
+{
+    // Finish the run after this event rather than replaying the
+    // last record until BeamOn is done.
+    G4cout << "Phasespace source exhausted" << G4endl;
+    G4cout << "Particles in phasespace: " << count << G4endl;
+
+    phasespace_record_repeat = 0;
+    count = 0;
+    source_exhausted = true;
+    if (master) {
+        // Other workers and the master read it too.
+        boost::mutex::scoped_lock lock(master->source_mutex);
+        master->source_exhausted = true;
+    }
+
+    G4RunManager* run_manager = G4RunManager::GetRunManager();
+    run_manager->AbortRun(true); 
+}
+
+G4bool PrimaryGeneratorAction::ReadPhasespaceRecord()
+{
+    // Workers take turns at the one source opened on the master, so the
+    // records are shared out as fast as each worker gets through them.
+    if (master) {
+        boost::mutex::scoped_lock lock(master->source_mutex);
+        return ReadPhasespaceRecord(master->mapped_reader, master->phasespace_reader);
+    }
+
+    return ReadPhasespaceRecord(mapped_reader, phasespace_reader);
+}
+
+G4bool PrimaryGeneratorAction::ReadPhasespaceRecord(MappedPhasespaceReader* mapped,
+        PhasespaceReader* reader)
+{
+    G4int particle_type;
+    G4double energy;
+
+    if (mapped) {
+        // Straight from the mapped file, no copy or deserialisation.
+        const PackedPhasespaceRecord* packed = mapped->Next();
+        if (packed == NULL)
+            return false;
+
+        record_position = G4ThreeVector(packed->position[0],
+                packed->position[1], packed->position[2]);
+        record_direction = G4ThreeVector(packed->direction[0],
+                packed->direction[1], packed->direction[2]);
+        record_weight = packed->weight;
+        particle_type = packed->particle_type;
+        energy = packed->kinetic_energy;
+    } else {
+        if (!reader->Read(phasespace_record))
+            return false;
+
+        // The gun only needs the direction of the momentum.
+        record_position = phasespace_record.GetPosition();
+        record_direction = phasespace_record.GetMomentum();
+        record_weight = phasespace_record.GetWeight();
+        particle_type = phasespace_record.GetParticleType();
+        energy = phasespace_record.GetKineticEnergy();
+    }
+
+    record_valid = PhasespaceRecord::CheckPosition(record_position.x(),
+            record_position.y(), record_position.z(),
+            xlow, xhigh, ylow, yhigh, zlow, zhigh);
+
+    G4ParticleDefinition* particle = gamma; 
+
+    if (particle_type == -1) {
+        particle = electron;
+    } else if (particle_type == 1) {
+        particle = positron;
+    } 
+
+    phasespace_particle_gun->SetParticleDefinition(particle);
+    phasespace_particle_gun->SetParticleEnergy(energy);
+
+    return true;
 }
 
@@ -0,0 +1,132 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "RandomEngine.hh"
+#include "XoshiroEngine.hh"
+
+#include "Randomize.hh"
+#include "G4Timer.hh"
+#include "G4Version.hh"
+
+#include "CLHEP/Random/Ranlux64Engine.h"
+#include "CLHEP/Random/RanluxEngine.h"
+#include "CLHEP/Random/JamesRandom.h"
+#include "CLHEP/Random/RanecuEngine.h"
+#include "CLHEP/Random/MTwistEngine.h"
+#if G4VERSION_NUMBER >= 1030
+#include "CLHEP/Random/MixMaxRng.h"
+#endif
+
+#ifdef G4MULTITHREADED
+#include "G4Threading.hh"
+#endif
+
+
+G4String RandomEngine::engine_name = "";
+G4int RandomEngine::generation = 0;
+CLHEP::HepRandomEngine* RandomEngine::master_engine = NULL;
+
+#ifdef G4MULTITHREADED
+// The choice each worker last made its engine for.
+static G4ThreadLocal G4int worker_generation = 0;
+#endif
+
+
+CLHEP::HepRandomEngine* RandomEngine::Create(G4String name)
+{
+    if (name == "ranlux64")
+        return new CLHEP::Ranlux64Engine();
+    if (name == "ranlux")
+        return new CLHEP::RanluxEngine();
+    if (name == "james")
+        return new CLHEP::HepJamesRandom();
+    if (name == "ranecu")
+        return new CLHEP::RanecuEngine();
+    if (name == "mtwist")
+        return new CLHEP::MTwistEngine();
+#if G4VERSION_NUMBER >= 1030
+    if (name == "mixmax")
+        return new CLHEP::MixMaxRng();
+#endif
+    if (name == "xoshiro")
+        return new XoshiroEngine();
+
+    return NULL;
+}
+
+G4bool RandomEngine::Use(G4String name)
+{
+    CLHEP::HepRandomEngine* engine = Create(name);
+    if (engine == NULL) {
+        G4cout << "RandomEngine::Use: unknown engine " << name << ", ignored." << G4endl;
+        return false;
+    }
+
+    CLHEP::HepRandom::setTheEngine(engine);
+
+    // Nothing else holds on to the engine it replaces.
+    delete master_engine;
+    master_engine = engine;
+
+    engine_name = name;
+    generation++;
+
+    return true;
+}
+
+void RandomEngine::UseOnWorker()
+{
+#ifdef G4MULTITHREADED
+    if (!G4Threading::IsWorkerThread() || worker_generation == generation)
+        return;
+
+    // Lives as long as the thread.
+    CLHEP::HepRandomEngine* engine = Create(engine_name);
+    if (engine)
+        G4Random::setTheEngine(engine);
+
+    worker_generation = generation;
+#endif
+}
+
+G4double RandomEngine::Benchmark(G4String name, G4int count)
+{
+    CLHEP::HepRandomEngine* engine = Create(name);
+    if (engine == NULL)
+        return -1;
+
+    G4Timer timer;
+    timer.Start();
+
+    // Summed so none of the calls can be left out.
+    G4double sum = 0;
+    for (G4int i=0; i<count; i++)
+        sum += engine->flat();
+
+    timer.Stop();
+    delete engine;
+
+    G4double elapsed = timer.GetRealElapsed();
+    if (sum < 0 || elapsed <= 0)
+        return 0;
+
+    return count / elapsed;
+}
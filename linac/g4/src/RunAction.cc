@@ -0,0 +1,70 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "RunAction.hh"
+#include "DetectorConstruction.hh"
+#include "PrimaryGeneratorAction.hh"
+#include "RandomEngine.hh"
+
+#include "G4Run.hh"
+#include "G4RunManager.hh"
+
+
+RunAction::RunAction()
+{
+}
+
+RunAction::~RunAction()
+{
+}
+
+void RunAction::BeginOfRunAction(const G4Run*)
+{
+#ifdef G4MULTITHREADED
+    // Whatever was set on the master generator since the last run.
+    if (!IsMaster()) {
+        PrimaryGeneratorAction* primary_generator = (PrimaryGeneratorAction*)
+            (G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+        primary_generator->Synchronise();
+
+        // The phantom or CT may have been set up again since.
+        DetectorConstruction* detector_construction = (DetectorConstruction*)
+            (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+        detector_construction->AttachWorkerDetector();
+
+        RandomEngine::UseOnWorker();
+    }
+#endif
+}
+
+void RunAction::EndOfRunAction(const G4Run*)
+{
+#ifdef G4MULTITHREADED
+    // Workers are still scoring until the master gets here.
+    if (!IsMaster())
+        return;
+#endif
+
+    DetectorConstruction* detector_construction = (DetectorConstruction*)
+        (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+    if (detector_construction->GetReduceEachRun())
+        detector_construction->ReduceHistograms();
+}
@@ -0,0 +1,96 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifdef G4MULTITHREADED
+
+#include "SchedulingRunManager.hh"
+
+#include "G4Threading.hh"
+
+#include <algorithm>
+
+
+SchedulingRunManager::SchedulingRunManager()
+{
+    chunk_time = 0.05;
+    maximum_chunk = 10000;
+    event_cost = 0;
+}
+
+SchedulingRunManager::~SchedulingRunManager()
+{
+}
+
+void SchedulingRunManager::InitializeEventLoop(G4int n_event, const char* macroFile,
+        G4int n_select)
+{
+    G4MTRunManager::InitializeEventLoop(n_event, macroFile, n_select);
+
+    boost::mutex::scoped_lock lock(mutex);
+
+    // The time between runs is not spent on events.
+    chunk_start.assign(GetNumberOfThreads(), -1);
+    chunk_events.assign(GetNumberOfThreads(), 0);
+    timer.Start();
+}
+
+G4int SchedulingRunManager::SetUpNEvents(G4Event* event, G4SeedsQueue* seeds_queue,
+        G4bool reseed_required)
+{
+    boost::mutex::scoped_lock lock(mutex);
+
+    timer.Stop();
+    G4double now = timer.GetRealElapsed();
+
+    // The chunk this worker just finished gives the cost of an event.
+    unsigned int worker = G4Threading::G4GetThreadId();
+    if (worker < chunk_start.size() && chunk_start[worker] >= 0 && chunk_events[worker] > 0) {
+        G4double cost = (now - chunk_start[worker]) / chunk_events[worker];
+        event_cost = event_cost > 0 ? 0.75*event_cost + 0.25*cost : cost;
+    }
+
+    eventModulo = ChunkSize(numberOfEventToBeProcessed - numberOfEventProcessed);
+    G4int events = G4MTRunManager::SetUpNEvents(event, seeds_queue, reseed_required);
+
+    if (worker < chunk_start.size()) {
+        chunk_start[worker] = now;
+        chunk_events[worker] = events;
+    }
+
+    return events;
+}
+
+G4int SchedulingRunManager::ChunkSize(G4int remaining)
+{
+    // Half of what is left over the workers, so that however costly the
+    // events in a chunk turn out, the others have as much again to do.
+    G4int chunk = remaining / (2*GetNumberOfThreads());
+
+    // One event at a time until the cost is known.
+    if (event_cost > 0)
+        chunk = std::min(chunk, (G4int) (chunk_time / event_cost));
+    else
+        chunk = 1;
+
+    return std::max(1, std::min(chunk, maximum_chunk));
+}
+
+#endif // G4MULTITHREADED
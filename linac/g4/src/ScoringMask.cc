@@ -0,0 +1,72 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "ScoringMask.hh"
+
+#include <algorithm>
+
+
+ScoringMask::ScoringMask(G4int x, G4int y, G4int z, const std::vector<uint8_t>& labels)
+    : x_dim(x), y_dim(y), z_dim(z), labels(labels) {
+    G4int size = labels.size();
+    G4int words = (size + 63) / 64;
+
+    bits.assign(words, 0);
+    ranks.assign(words, 0);
+
+    for (G4int i=0; i<size; i++) {
+        if (labels[i] == 0)
+            continue;
+
+        bits[i >> 6] |= ((uint64_t) 1) << (i & 63);
+        voxels.push_back(i);
+    }
+
+    G4int count = 0;
+    for (G4int w=0; w<words; w++) {
+        ranks[w] = count;
+        count += __builtin_popcountll(bits[w]);
+    }
+}
+
+pyublas::numpy_vector<G4double> ScoringMask::Expand(pyublas::numpy_vector<G4double> compact) {
+    npy_intp dims[] = {x_dim, y_dim, z_dim};
+    pyublas::numpy_vector<G4double> expanded(3, dims);
+    std::fill(expanded.begin(), expanded.end(), 0.);
+
+    for (unsigned int i=0; i<voxels.size() && i<compact.size(); i++)
+        expanded[voxels[i]] = compact[i];
+
+    return expanded;
+}
+
+void ScoringMask::ExpandIndices(pyublas::numpy_vector<int64_t> indices) {
+    for (unsigned int i=0; i<indices.size(); i++)
+        indices[i] = voxels[indices[i]];
+}
+
+pyublas::numpy_vector<uint8_t> ScoringMask::GetLabels() {
+    npy_intp dims[] = {x_dim, y_dim, z_dim};
+    pyublas::numpy_vector<uint8_t> array(3, dims);
+    std::copy(labels.begin(), labels.end(), array.begin());
+
+    return array;
+}
@@ -0,0 +1,205 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "ScoringMesh.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4StepPoint.hh"
+#include "G4TouchableHistory.hh"
+#include "G4AffineTransform.hh"
+#include "G4Material.hh"
+
+#include <algorithm>
+#include <cmath>
+
+
+static const G4int SEGMENTS_PER_BIN = 4;
+static const G4int MAXIMUM_SEGMENTS = 256;
+
+ScoringMesh::ScoringMesh(const G4String& name, Shape shape, G4ThreeVector size,
+        G4int x_bins, G4int y_bins, G4int z_bins, DoseGrid* dose_grid)
+    : G4VSensitiveDetector(name) {
+
+    this->shape = shape;
+    this->size = size;
+    this->x_bins = x_bins;
+    this->y_bins = y_bins;
+    this->z_bins = z_bins;
+
+    quantity = kDose;
+
+    if (shape == kCylinder) {
+        G4double radius = size.x();
+        G4double dphi = twopi / y_bins;
+        G4double dz = size.z() / z_bins;
+        G4double dr = radius / x_bins;
+
+        bin_density = G4ThreeVector(1. / dr, 1. / dphi, 1. / dz);
+
+        for (G4int i=0; i<x_bins; i++) {
+            G4double inner = i * dr;
+            G4double outer = (i + 1) * dr;
+            inverse_volumes.push_back(1. / ((outer*outer - inner*inner) / 2. * dphi * dz));
+        }
+    } else {
+        bin_density = G4ThreeVector(x_bins / size.x(), y_bins / size.y(), z_bins / size.z());
+
+        G4double volume = size.x()*size.y()*size.z() / (x_bins*y_bins*z_bins);
+        inverse_volumes.assign(x_bins, 1. / volume);
+    }
+
+    this->owns_dose_grid = dose_grid == NULL;
+    if (owns_dose_grid)
+        dose_grid = new DoseGrid(x_bins, y_bins, z_bins);
+
+    this->dose_grid = dose_grid;
+    this->dose_buffer = NULL;
+}
+
+ScoringMesh::~ScoringMesh() {
+    if (owns_dose_grid)
+        delete dose_grid;
+}
+
+ScoringMesh* ScoringMesh::MakeWorker() {
+    ScoringMesh* worker = new ScoringMesh(GetName(), shape, size,
+            x_bins, y_bins, z_bins, dose_grid);
+    worker->SetQuantity(quantity);
+
+    return worker;
+}
+
+void ScoringMesh::Initialize(G4HCofThisEvent*) {
+    if (dose_buffer == NULL)
+        dose_buffer = dose_grid->GetLocalBuffer();
+
+    dose_grid->BeginHistory(dose_buffer);
+}
+
+G4bool ScoringMesh::ProcessHits(G4Step* step, G4TouchableHistory*) {
+    G4double energy_deposit = step->GetTotalEnergyDeposit();
+    if (energy_deposit == 0)
+        return false;
+
+    // The bins are not volumes of their own, so a step can cross several.
+    // Cut it into pieces in the frame of the mesh and share the deposit
+    // out along it, as if it were lost evenly over the step.
+    G4StepPoint* pre_step = step->GetPreStepPoint();
+    const G4AffineTransform& transform =
+        pre_step->GetTouchableHandle()->GetHistory()->GetTopTransform();
+    G4ThreeVector pre = transform.TransformPoint(pre_step->GetPosition());
+    G4ThreeVector post = transform.TransformPoint(step->GetPostStepPoint()->GetPosition());
+
+    G4int segments = GetSegments(pre, post);
+    G4double fraction = 1. / segments;
+
+    const G4Track* track = step->GetTrack();
+    G4double value = energy_deposit * fraction;
+    if (quantity == kDose)
+        value /= track->GetMaterial()->GetDensity();
+
+    // Neighbouring pieces in the same bin are added together, so a bin
+    // counts the track once however many pieces it got.
+    G4int current = -1;
+    G4double current_value = 0;
+
+    for (G4int i=0; i<segments; i++) {
+        G4ThreeVector position = pre + (post - pre) * ((i + 0.5) * fraction);
+
+        G4int x_index;
+        G4int index;
+        if (!Locate(position, x_index, index))
+            continue;
+
+        if (index != current && current >= 0) {
+            dose_grid->Add(dose_buffer, current, current_value, track->GetWeight());
+            current_value = 0;
+        }
+
+        current = index;
+        current_value += quantity == kDose ? value * inverse_volumes[x_index] : value;
+    }
+
+    if (current < 0)
+        return false;
+
+    dose_grid->Add(dose_buffer, current, current_value, track->GetWeight());
+    return true;
+}
+
+G4bool ScoringMesh::Locate(const G4ThreeVector& position, G4int& x_index, G4int& index) {
+    G4int y_index;
+    G4int z_index;
+
+    if (shape == kCylinder) {
+        x_index = (G4int) std::floor(position.perp() * bin_density.x());
+        y_index = (G4int) std::floor((position.phi() + pi) * bin_density.y());
+    } else {
+        x_index = (G4int) std::floor((position.x() + size.x()/2.) * bin_density.x());
+        y_index = (G4int) std::floor((position.y() + size.y()/2.) * bin_density.y());
+    }
+    z_index = (G4int) std::floor((position.z() + size.z()/2.) * bin_density.z());
+
+    // Edges of the solid can round just outside the last bin.
+    if (x_index < 0 || x_index >= x_bins)
+        return false;
+    if (y_index < 0 || y_index >= y_bins)
+        return false;
+    if (z_index < 0 || z_index >= z_bins)
+        return false;
+
+    index = dose_grid->GetIndex(x_index, y_index, z_index);
+    return true;
+}
+
+G4int ScoringMesh::GetSegments(const G4ThreeVector& pre, const G4ThreeVector& post) {
+    G4ThreeVector delta = post - pre;
+
+    // Bins crossed along each axis, at most. Along a straight line phi
+    // turns one way only, by less than half a turn, and the radius
+    // changes by no more than the length of the step.
+    G4double bins;
+    if (shape == kCylinder) {
+        G4double dphi = std::abs(post.phi() - pre.phi());
+        if (dphi > pi)
+            dphi = twopi - dphi;
+
+        bins = std::max(delta.mag() * bin_density.x(), dphi * bin_density.y());
+    } else {
+        bins = std::max(std::abs(delta.x()) * bin_density.x(),
+                std::abs(delta.y()) * bin_density.y());
+    }
+    bins = std::max(bins, std::abs(delta.z()) * bin_density.z());
+
+    G4int segments = (G4int) std::ceil(bins * SEGMENTS_PER_BIN);
+    return std::max(1, std::min(MAXIMUM_SEGMENTS, segments));
+}
+
+void ScoringMesh::EndOfEvent(G4HCofThisEvent*) {
+    dose_grid->EndHistory(dose_buffer);
+}
+
+void ScoringMesh::clear() {
+}
+
+void ScoringMesh::PrintAll() {
+}
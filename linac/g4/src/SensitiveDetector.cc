@@ -22,6 +22,7 @@
 #include "globals.hh"
 
 #include "SensitiveDetector.hh"
+#include "ScoringDetector.hh"
 #include "DetectorConstruction.hh"
 
 
@@ -35,13 +36,37 @@
 #include "G4RunManager.hh"
 #include "G4SteppingManager.hh"
 #include "G4ThreeVector.hh"
+#include "G4VTouchable.hh"
 
 #include "boost/python.hpp"
 #include "pyublas/numpy.hpp"
+#include <algorithm>
 #include <vector>
 
 
-SensitiveDetector::SensitiveDetector(const G4String& name) : G4VSensitiveDetector(name) {
+SensitiveDetector* SensitiveDetector::Create(const G4String& name,
+        const G4String& quantity, G4bool tiled, SensitiveDetector* master) {
+    if (quantity == "dose")
+        return new ScoringDetector<DoseQuantity>(name, tiled, master);
+    if (quantity == "fluence")
+        return new ScoringDetector<FluenceQuantity>(name, tiled, master);
+    if (quantity == "kerma")
+        return new ScoringDetector<KermaQuantity>(name, tiled, master);
+    if (quantity == "particle_dose")
+        return new ScoringDetector<ParticleDoseQuantity>(name, tiled, master);
+    if (quantity == "let")
+        return new ScoringDetector<LETQuantity>(name, tiled, master);
+
+    if (quantity != "dose_uncertainty") {
+        G4cout << "SensitiveDetector::Create: unknown quantity " << quantity
+               << ", scoring dose_uncertainty." << G4endl;
+    }
+    return new ScoringDetector<DoseUncertaintyQuantity>(name, tiled, master);
+}
+
+SensitiveDetector::SensitiveDetector(const G4String& name, G4int grids,
+        G4bool energysq, G4bool counts, G4bool tiled, SensitiveDetector* master)
+    : G4VSensitiveDetector(name) {
 
     debug = false;
 
@@ -57,114 +82,253 @@ SensitiveDetector::SensitiveDetector(const G4String& name) : G4VSensitiveDetecto
     y_max = y_dim;
     z_max = z_dim;
 
-    x_res = 4*mm;
-    y_res = x_res;
-    z_res = x_res;
+    SetResolution(4*mm, 4*mm, 4*mm);
 
-    volume = x_res*y_res*z_res;
+    use_replica_numbers = false;
+    mask = NULL;
+    x_depth = 2;
+    y_depth = 1;
+    z_depth = 0;
 
     detector_construction = (DetectorConstruction*) (G4RunManager::GetRunManager()->GetUserDetectorConstruction());
 
-    npy_intp dims[] = {x_max - x_min, y_max - y_min, z_max - z_min};
-
-    energy_histogram = pyublas::numpy_vector<float> (3, dims);
-    std::fill(energy_histogram.begin(), energy_histogram.end(), 0.0);
-
-    energysq_histogram = pyublas::numpy_vector<float> (3, dims);
-    std::fill(energysq_histogram.begin(), energysq_histogram.end(), 0.0);
+    this->owns_dose_grid = master == NULL;
+    if (owns_dose_grid) {
+        for (G4int i=0; i<grids; i++) {
+            dose_grids.push_back(new DoseGrid(x_max - x_min, y_max - y_min, z_max - z_min,
+                        tiled, energysq, counts));
+        }
+    } else {
+        // Score exactly where the master does.
+        dose_grids = master->dose_grids;
+
+        SetDimensions(master->x_dim, master->y_dim, master->z_dim);
+        SetMinimumCutoff(master->x_min, master->y_min, master->z_min);
+        SetMaximumCutoff(master->x_max, master->y_max, master->z_max);
+        SetResolution(master->x_res, master->y_res, master->z_res);
+
+        use_replica_numbers = master->use_replica_numbers;
+        SetReplicaDepths(master->x_depth, master->y_depth, master->z_depth);
+        inverse_masses = master->inverse_masses;
+        mask = master->mask;
+
+        checkpoint_prefix = master->checkpoint_prefix;
+        log_energies = master->log_energies;
+        log_coefficients = master->log_coefficients;
+        debug = master->debug;
+    }
 
-    counts_histogram = pyublas::numpy_vector<float> (3, dims);
-    std::fill(counts_histogram.begin(), counts_histogram.end(), 0.0);
+    this->dose_grid = dose_grids[0];
 }
 
 SensitiveDetector::~SensitiveDetector() {
+    if (owns_dose_grid) {
+        for (unsigned int i=0; i<dose_grids.size(); i++)
+            delete dose_grids[i];
+        delete mask;
+    }
 }
 
-void SensitiveDetector::Initialize(G4HCofThisEvent*) {
-}
+void SensitiveDetector::SetVoxelData(G4int x, G4int y, G4int z,
+        const std::vector<G4double>& inverse_masses) {
+    if (!dose_buffers.empty()) {
+        G4cout << "SensitiveDetector::SetVoxelData: already scoring, ignored." << G4endl;
+        return;
+    }
 
-G4bool SensitiveDetector::ProcessHits(G4Step* aStep, G4TouchableHistory* touchable) {
-    const G4Track* aTrack = aStep->GetTrack();
-    const G4String name = aTrack->GetDefinition()->GetParticleName();
+    if ((G4int) inverse_masses.size() != x*y*z) {
+        G4cout << "SensitiveDetector::SetVoxelData: " << inverse_masses.size()
+               << " voxel masses for a " << x << "x" << y << "x" << z << " grid, ignored." << G4endl;
+        return;
+    }
 
-    G4double energy_deposit = aStep->GetTotalEnergyDeposit();
+    SetDimensions(x, y, z);
+    SetMinimumCutoff(0, 0, 0);
+    SetMaximumCutoff(x, y, z);
 
-    if(energy_deposit == 0) {
-        if (debug) G4cout << "No enegy to deposit." << G4endl << G4endl;
-        return false;
+    if (mask && mask->GetSize() != x*y*z) {
+        G4cout << "SensitiveDetector::SetVoxelData: scoring mask does not match "
+               << "the voxel data, scoring every voxel." << G4endl;
+        if (owns_dose_grid)
+            delete mask;
+        mask = NULL;
     }
 
-    G4double voxel_mass = aTrack->GetMaterial()->GetDensity() * volume;
-
-
-    G4ThreeVector position = aTrack->GetPosition();
-    //G4ThreeVector world_position = aTrack->GetPosition();
-    ////G4ThreeVector world_position = aStep->GetPreStepPoint()->GetPosition();
-    //G4ThreeVector position = aStep->GetPreStepPoint()->GetTouchableHandle()->
-    //        GetHistory()->GetTopTransform().TransformPoint(world_position);
-
-    int x_index = std::floor((position.x() + (x_dim/2. * x_res)) / x_res);
-    int y_index = std::floor((position.y() + (y_dim/2. * y_res)) / y_res);
-    //int z_index = std::floor((position.z() + 300*mm + (z_dim/2. * z_res)) / z_res);
-    int z_index = std::floor((position.z() + (z_dim/2. * z_res)) / z_res);
-
-    if (debug) {
-        G4cout << "Solid name:       " << aTrack->GetVolume()->GetLogicalVolume()->GetName() << G4endl;
-        G4cout << "Total energy:     " << aTrack->GetTotalEnergy() << G4endl;
-        G4cout << "Enegy to deposit: " << energy_deposit << " MeV" << G4endl;
-        G4cout << "Voxel material:   " << aTrack->GetMaterial()->GetName() << G4endl;
-        G4cout << "Voxel mass:       " << voxel_mass << G4endl;
-        G4cout << "Voxel volume:     " << volume << G4endl;
-        G4cout << "Position: "
-               << position.x() << " "
-               << position.y() << " "
-               << position.z() << " " << G4endl;
-        G4cout << "Histogram index: "
-               << x_index << " "
-               << y_index << " "
-               << z_index << " " << G4endl;
-        if (x_index != std::abs(x_index)) {
-            G4cout << "Error: X index" << G4endl;
-        }
-        if (y_index != std::abs(y_index)) {
-            G4cout << "Error: Y index" << G4endl;
+    ResizeGrids();
+
+    this->inverse_masses = inverse_masses;
+    this->use_replica_numbers = true;
+}
+
+void SensitiveDetector::SetScoringMask(const std::vector<uint8_t>& labels) {
+    if (!dose_buffers.empty()) {
+        G4cout << "SensitiveDetector::SetScoringMask: already scoring, ignored." << G4endl;
+        return;
+    }
+    if (!owns_dose_grid)
+        return;
+
+    G4int x = x_max - x_min;
+    G4int y = y_max - y_min;
+    G4int z = z_max - z_min;
+
+    ScoringMask* new_mask = NULL;
+    if (!labels.empty()) {
+        if ((G4int) labels.size() != x*y*z) {
+            G4cout << "SensitiveDetector::SetScoringMask: mask of " << labels.size()
+                   << " voxels does not match the " << x << "x" << y << "x" << z
+                   << " grid, ignored." << G4endl;
+            return;
         }
-        if (z_index != std::abs(z_index)) {
-            G4cout << "Error: Z index" << G4endl;
+
+        new_mask = new ScoringMask(x, y, z, labels);
+        if (new_mask->GetVoxelCount() == 0) {
+            G4cout << "SensitiveDetector::SetScoringMask: mask is empty, ignored." << G4endl;
+            delete new_mask;
+            return;
         }
     }
 
+    delete mask;
+    mask = new_mask;
 
-    if (x_index < x_min || x_index >= x_max) {
-        if (debug) {G4cout << "Out of bounds: X index" << G4endl;}
-        return false;
+    ResizeGrids();
+}
+
+void SensitiveDetector::ResizeGrids() {
+    if (!owns_dose_grid)
+        return;
+
+    for (unsigned int i=0; i<dose_grids.size(); i++) {
+        DoseGrid* old_grid = dose_grids[i];
+
+        // The scored voxels of a mask are packed one after the other,
+        // there is nothing left for bricks to skip.
+        if (mask) {
+            dose_grids[i] = new DoseGrid(mask->GetVoxelCount(), 1, 1, false,
+                    old_grid->HasEnergySq(), old_grid->HasCounts());
+        } else {
+            dose_grids[i] = new DoseGrid(x_max - x_min, y_max - y_min, z_max - z_min,
+                    old_grid->IsTiled(), old_grid->HasEnergySq(), old_grid->HasCounts());
+        }
+        dose_grids[i]->SetAtomic(old_grid->IsAtomic());
+
+        delete old_grid;
     }
-    if (y_index < y_min || y_index >= y_max) {
-        if (debug) {G4cout << "Out of bounds: Y index" << G4endl;}
-        return false;
+    dose_grid = dose_grids[0];
+}
+
+void SensitiveDetector::SetMassEnergyAbsorption(const std::vector<G4double>& energies,
+        const std::vector<G4double>& coefficients) {
+    log_energies.clear();
+    log_coefficients.clear();
+
+    for (unsigned int i=0; i<energies.size() && i<coefficients.size(); i++) {
+        log_energies.push_back(std::log(energies[i]));
+        log_coefficients.push_back(std::log(coefficients[i]));
     }
-    if (z_index < z_min || z_index >= z_max) {
-        if (debug) {G4cout << "Out of bounds: Z index" << G4endl;}
-        return false;
+}
+
+G4double SensitiveDetector::GetMassEnergyAbsorption(G4double energy) {
+    if (log_energies.empty())
+        return 0;
+
+    G4double log_energy = std::log(energy);
+
+    std::vector<G4double>::iterator it = std::upper_bound(log_energies.begin(),
+            log_energies.end(), log_energy);
+    if (it == log_energies.begin())
+        return std::exp(log_coefficients.front());
+    if (it == log_energies.end())
+        return std::exp(log_coefficients.back());
+
+    G4int i = it - log_energies.begin();
+    G4double t = (log_energy - log_energies[i-1]) / (log_energies[i] - log_energies[i-1]);
+
+    return std::exp(log_coefficients[i-1] + t*(log_coefficients[i] - log_coefficients[i-1]));
+}
+
+void SensitiveDetector::SetAtomic(G4bool atomic) {
+    for (unsigned int i=0; i<dose_grids.size(); i++)
+        dose_grids[i]->SetAtomic(atomic);
+}
+
+void SensitiveDetector::SetTiled(G4bool tiled) {
+    if (mask && tiled) {
+        G4cout << "SensitiveDetector::SetTiled: masked grids are already packed, "
+               << "not tiled." << G4endl;
+        return;
     }
 
-    x_index -= x_min;
-    y_index -= y_min;
-    z_index -= z_min;
+    for (unsigned int i=0; i<dose_grids.size(); i++)
+        dose_grids[i]->SetTiled(tiled);
+}
 
-    if (debug){
-        G4cout << "New index: " << x_index << " " << y_index << " " << z_index << " " << G4endl;
+void SensitiveDetector::Reduce() {
+    for (unsigned int i=0; i<dose_grids.size(); i++)
+        dose_grids[i]->Reduce();
+}
+
+void SensitiveDetector::Zero() {
+    for (unsigned int i=0; i<dose_grids.size(); i++)
+        dose_grids[i]->Zero();
+}
+
+void SensitiveDetector::Checkpoint() {
+    for (unsigned int i=0; i<dose_grids.size(); i++)
+        dose_grids[i]->Checkpoint();
+}
+
+void SensitiveDetector::Initialize(G4HCofThisEvent*) {
+    // Taken at the first event rather than in the constructor, so the
+    // scoring mode can still be changed after the geometry is built.
+    if (dose_buffers.empty()) {
+        for (unsigned int i=0; i<dose_grids.size(); i++) {
+            if (checkpoint_prefix != "") {
+                G4String prefix = checkpoint_prefix;
+                if (dose_grids.size() > 1)
+                    prefix += "_" + GetHistogramName(i);
+                dose_grids[i]->Map(prefix);
+            }
+
+            dose_buffers.push_back(dose_grids[i]->GetLocalBuffer());
+        }
     }
-    energy_histogram.sub(x_index, y_index, z_index) += energy_deposit/voxel_mass;
-    energysq_histogram.sub(x_index, y_index, z_index) += std::pow(energy_deposit, 2.);
-    counts_histogram.sub(x_index, y_index, z_index) += aTrack->GetWeight();
-    
-    if (debug) G4cout << G4endl;
 
-    return true;
+    // Every event is one history as far as the uncertainty goes.
+    for (unsigned int i=0; i<dose_grids.size(); i++)
+        dose_grids[i]->BeginHistory(dose_buffers[i]);
+}
+
+void SensitiveDetector::PrintHit(const G4Step* step) {
+    const G4Track* track = step->GetTrack();
+    G4ThreeVector position = track->GetPosition();
+
+    G4cout << "Solid name:       " << track->GetVolume()->GetLogicalVolume()->GetName() << G4endl;
+    G4cout << "Total energy:     " << track->GetTotalEnergy() << G4endl;
+    G4cout << "Enegy to deposit: " << step->GetTotalEnergyDeposit() << " MeV" << G4endl;
+    G4cout << "Step length:      " << step->GetStepLength() << G4endl;
+    G4cout << "Voxel material:   " << track->GetMaterial()->GetName() << G4endl;
+    G4cout << "Voxel volume:     " << volume << G4endl;
+    G4cout << "Position: "
+           << position.x() << " "
+           << position.y() << " "
+           << position.z() << " " << G4endl;
+
+    G4int index;
+    G4double inverse_mass;
+    if (Locate(step, index, inverse_mass)) {
+        G4cout << "Grid index:       " << index << G4endl;
+        G4cout << "Voxel mass:       " << 1. / inverse_mass << G4endl;
+    } else {
+        G4cout << "Out of bounds" << G4endl;
+    }
+    G4cout << G4endl;
 }
 
 void SensitiveDetector::EndOfEvent(G4HCofThisEvent*) {
+    for (unsigned int i=0; i<dose_grids.size(); i++)
+        dose_grids[i]->EndHistory(dose_buffers[i]);
 }
 
 void SensitiveDetector::clear() {
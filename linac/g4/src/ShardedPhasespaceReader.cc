@@ -0,0 +1,250 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "ShardedPhasespaceReader.hh"
+#include "PackedPhasespaceWriter.hh"
+#include "CompressedPhasespaceReader.hh"
+#include "CompressedPhasespaceWriter.hh"
+#include "IAEAPhasespaceWriter.hh"
+#include "IAEAPhasespaceReader.hh"
+#include "IndexingPhasespaceWriter.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <dirent.h>
+#include <unistd.h>
+
+
+ShardedPhasespaceReader::ShardedPhasespaceReader(std::vector<G4String> shards) {
+    current_reader = 0;
+
+    G4bool indexed = true;
+    for (unsigned int i=0; i<shards.size(); i++) {
+        PhasespaceReader* reader = PhasespaceReader::Open(shards[i]);
+        if (reader == NULL)
+            continue;
+
+        readers.push_back(reader);
+        indexed = indexed && reader->GetIndex();
+    }
+
+    // The view is only indexed if every shard is.
+    if (indexed && !readers.empty()) {
+        phasespace_index = new PhasespaceIndex();
+        for (unsigned int i=0; i<readers.size(); i++)
+            phasespace_index->Append(*readers[i]->GetIndex());
+    }
+}
+
+ShardedPhasespaceReader::~ShardedPhasespaceReader() {
+    for (unsigned int i=0; i<readers.size(); i++)
+        delete readers[i];
+}
+
+G4bool ShardedPhasespaceReader::Read(PhasespaceRecord& record) {
+    while (current_reader < readers.size()) {
+        if (readers[current_reader]->Read(record))
+            return true;
+
+        current_reader++;
+        if (current_reader < readers.size())
+            readers[current_reader]->Seek(0);
+    }
+
+    return false;
+}
+
+G4bool ShardedPhasespaceReader::Seek(int64_t index) {
+    for (unsigned int i=0; i<readers.size(); i++) {
+        int64_t shard_count = readers[i]->GetRecordCount();
+        if (shard_count < 0)
+            return false;
+
+        // Seeking to the very end lands after the last record of the last shard.
+        if (index < shard_count || i == readers.size() - 1) {
+            current_reader = i;
+            return readers[i]->Seek(index);
+        }
+
+        index -= shard_count;
+    }
+
+    return false;
+}
+
+int64_t ShardedPhasespaceReader::GetRecordCount() {
+    int64_t record_count = 0;
+
+    for (unsigned int i=0; i<readers.size(); i++) {
+        int64_t shard_count = readers[i]->GetRecordCount();
+        if (shard_count < 0)
+            return -1;
+        record_count += shard_count;
+    }
+
+    return record_count;
+}
+
+int64_t ShardedPhasespaceReader::GetSkippedCount() {
+    int64_t skipped = 0;
+
+    for (unsigned int i=0; i<readers.size(); i++)
+        skipped += readers[i]->GetSkippedCount();
+
+    return skipped;
+}
+
+G4String ShardedPhasespaceReader::GetShardFilename(G4String filename, G4int shard) {
+    std::string name = filename;
+
+    std::ostringstream suffix;
+    suffix << ".shard" << shard;
+
+    size_t slash = name.rfind('/');
+    size_t dot = name.rfind('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return name + suffix.str();
+
+    return name.substr(0, dot) + suffix.str() + name.substr(dot);
+}
+
+std::vector<G4String> ShardedPhasespaceReader::FindShards(G4String filename) {
+    std::vector<G4String> shards;
+
+    while (true) {
+        G4String shard = GetShardFilename(filename, shards.size());
+        if (access(shard.c_str(), R_OK) != 0)
+            break;
+        shards.push_back(shard);
+    }
+
+    // A shard numbered past the first missing one means a worker's file
+    // went astray, merging the rest would quietly drop its records.
+    std::string first = GetShardFilename(filename, 0);
+    size_t marker = first.rfind(".shard0");
+    size_t slash = first.rfind('/');
+
+    std::string directory = slash == std::string::npos ? "." : first.substr(0, slash);
+    std::string head = first.substr(slash == std::string::npos ? 0 : slash + 1,
+            marker + 6 - (slash == std::string::npos ? 0 : slash + 1));
+    std::string tail = first.substr(marker + 7);
+
+    DIR* dir = opendir(directory.c_str());
+    if (dir == NULL)
+        return shards;
+
+    G4int last = -1;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        std::string name = entry->d_name;
+        if (name.size() <= head.size() + tail.size() || name.compare(0, head.size(), head) != 0
+                || name.compare(name.size() - tail.size(), tail.size(), tail) != 0)
+            continue;
+
+        std::string number = name.substr(head.size(), name.size() - head.size() - tail.size());
+        if (number.find_first_not_of("0123456789") != std::string::npos)
+            continue;
+
+        last = std::max(last, std::atoi(number.c_str()));
+    }
+    closedir(dir);
+
+    if (last >= (G4int) shards.size()) {
+        G4cout << "Shard " << shards.size() << " of " << filename << " is missing, but there "
+               << "are shards up to " << last << ", not reading any." << G4endl;
+        shards.clear();
+    }
+
+    return shards;
+}
+
+G4bool ShardedPhasespaceReader::Merge(G4String filename, G4bool remove_shards) {
+    std::vector<G4String> shards = FindShards(filename);
+    if (shards.empty()) {
+        G4cout << "No shards to merge for phasespace: " << filename << G4endl;
+        return false;
+    }
+
+    ShardedPhasespaceReader reader(shards);
+
+    // Keep the encoding the workers wrote with, the level is not stored.
+    PhasespaceReader* first_shard = PhasespaceReader::Open(shards[0]);
+    CompressedPhasespaceReader* compressed =
+        dynamic_cast<CompressedPhasespaceReader*>(first_shard);
+
+    PhasespaceWriter* file_writer;
+    if (IAEAPhasespaceReader::GetStem(filename) != filename) {
+        file_writer = new IAEAPhasespaceWriter(filename);
+    } else if (compressed) {
+        const CompressedPhasespaceHeader& header = compressed->GetCompressedHeader();
+        G4bool quantised = (header.encoding & PHASESPACE_ENCODING_QUANTIZED) != 0;
+        file_writer = new CompressedPhasespaceWriter(filename, 3,
+                (header.encoding & PHASESPACE_ENCODING_DELTA) != 0,
+                quantised ? header.position_step : 0,
+                quantised ? header.direction_step : 0,
+                quantised ? header.energy_step : 0);
+    } else {
+        file_writer = new PackedPhasespaceWriter(filename);
+    }
+    delete first_shard;
+    IndexingPhasespaceWriter writer(file_writer, filename);
+
+    std::vector<PhasespaceRecord> block;
+    block.reserve(65536);
+
+    PhasespaceRecord record;
+    int64_t histories = 0;
+
+    while (reader.Read(record)) {
+        if (record.IsNewHistory())
+            histories++;
+
+        block.push_back(record);
+        if (block.size() == block.capacity()) {
+            writer.WriteBlock(block);
+            block.clear();
+        }
+    }
+    writer.WriteBlock(block);
+
+    // Histories that left nothing in the plane still count.
+    if (reader.GetIndex())
+        histories = reader.GetIndex()->GetOriginalHistories();
+
+    writer.SetOriginalHistories(histories);
+    writer.Close();
+
+    G4cout << "Merged " << shards.size() << " shards into " << filename
+           << " (" << writer.GetRecordCount() << " records)" << G4endl;
+
+    if (remove_shards) {
+        for (unsigned int i=0; i<shards.size(); i++) {
+            std::remove(shards[i].c_str());
+            std::remove(PhasespaceIndex::GetIndexFilename(shards[i]).c_str());
+            if (IAEAPhasespaceReader::GetStem(shards[i]) != shards[i])
+                std::remove((IAEAPhasespaceReader::GetStem(shards[i]) + ".IAEAheader").c_str());
+        }
+    }
+
+    return true;
+}
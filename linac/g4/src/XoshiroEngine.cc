@@ -0,0 +1,100 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "XoshiroEngine.hh"
+
+#include "globals.hh"
+
+#include <fstream>
+
+
+XoshiroEngine::XoshiroEngine(long seed)
+{
+    setSeed(seed, 0);
+}
+
+XoshiroEngine::~XoshiroEngine()
+{
+}
+
+void XoshiroEngine::flatArray(const int size, double* vect)
+{
+    for (int i=0; i<size; i++)
+        vect[i] = flat();
+}
+
+void XoshiroEngine::setSeed(long seed, int)
+{
+    long seeds[2] = {seed, 0};
+    setSeeds(seeds, 0);
+}
+
+void XoshiroEngine::setSeeds(const long* seeds, int)
+{
+    theSeed = seeds[0];
+
+    // Fold every seed in, then spread them over the whole state. A state
+    // of all zeros is out of reach of SplitMix64.
+    uint64_t x = 0;
+    for (const long* seed=seeds; *seed != 0; seed++) {
+        x ^= (uint64_t) *seed;
+        SplitMix(x);
+    }
+
+    for (int i=0; i<4; i++)
+        state[i] = SplitMix(x);
+}
+
+void XoshiroEngine::saveStatus(const char filename[]) const
+{
+    std::ofstream file(filename);
+    if (!file) {
+        G4cout << "XoshiroEngine::saveStatus: could not open " << filename << G4endl;
+        return;
+    }
+
+    file << name() << std::endl;
+    for (int i=0; i<4; i++)
+        file << state[i] << std::endl;
+}
+
+void XoshiroEngine::restoreStatus(const char filename[])
+{
+    std::ifstream file(filename);
+    std::string engine;
+    file >> engine;
+
+    if (!file || engine != name()) {
+        G4cout << "XoshiroEngine::restoreStatus: no engine status in " << filename << G4endl;
+        return;
+    }
+
+    for (int i=0; i<4; i++)
+        file >> state[i];
+}
+
+void XoshiroEngine::showStatus() const
+{
+    G4cout << name() << " state:";
+    for (int i=0; i<4; i++)
+        G4cout << " " << state[i];
+    G4cout << G4endl;
+}
@@ -0,0 +1,68 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+#include "TestRecord.hh"
+
+#include "AsyncPhasespaceWriter.hh"
+#include "PackedPhasespaceWriter.hh"
+#include "PhasespaceReader.hh"
+#include "PhasespaceRecord.hh"
+
+
+int main(int argc, char** argv) {
+    std::string filename = TestPath(argc, argv, "async.phsp");
+
+    // Small blocks and a short queue, so tracking has to wait on the
+    // background thread and the last block is only partly full.
+    int count = 10007;
+    AsyncPhasespaceWriter* writer = new AsyncPhasespaceWriter(
+            new PackedPhasespaceWriter(filename), 100, 2);
+    for (int i=0; i<count; i++)
+        writer->Write(MakeRecord(i));
+    writer->SetOriginalHistories(count);
+    CHECK(writer->GetRecordCount() == count);
+    writer->Close();
+
+    // Closing twice, as the destructor does, writes nothing more.
+    delete writer;
+
+    PhasespaceReader* reader = PhasespaceReader::Open(filename);
+    CHECK(reader != NULL);
+    if (reader == NULL)
+        return CheckResult();
+    CHECK(reader->GetRecordCount() == count);
+
+    // Every record arrives once and in order.
+    PhasespaceRecord record;
+    int read = 0;
+    int out_of_order = 0;
+    while (reader->Read(record)) {
+        if (record.position_x != read)
+            out_of_order++;
+        read++;
+    }
+    CHECK(read == count);
+    CHECK(out_of_order == 0);
+
+    delete reader;
+    return CheckResult();
+}
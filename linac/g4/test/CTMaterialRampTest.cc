@@ -0,0 +1,65 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+
+#include "CTMaterialRamp.hh"
+
+
+int main(int, char**) {
+    G4Material* air = new G4Material("air", 7, 14.01*g/mole, 0.0012*g/cm3);
+    G4Material* water = new G4Material("water", 8, 16.00*g/mole, 1.0*g/cm3);
+    G4Material* bone = new G4Material("bone", 20, 40.08*g/mole, 1.85*g/cm3);
+
+    std::map<int16_t, G4Material*> materials;
+    materials[-1000] = air;
+    materials[0] = water;
+    materials[1000] = bone;
+
+    CTMaterialRamp ramp(materials, 25, -1000, 2000);
+
+    // Clipped to the range, then rounded down, not to nearest.
+    CHECK(ramp.Round(-3000) == -1000);
+    CHECK(ramp.Round(-1001) == -1000);
+    CHECK(ramp.Round(-1) == -25);
+    CHECK(ramp.Round(0) == 0);
+    CHECK(ramp.Round(24) == 0);
+    CHECK(ramp.Round(25) == 25);
+    CHECK(ramp.Round(1999) == 1975);
+    CHECK(ramp.Round(5000) == 2000);
+
+    // Either side of each setpoint, and beyond either end of the range.
+    CHECK(ramp.GetMaterial(-3000) == air);
+    CHECK(ramp.GetMaterial(-1000) == air);
+    CHECK(ramp.GetMaterial(-1) == air);
+    CHECK(ramp.GetMaterial(0) == water);
+    CHECK(ramp.GetMaterial(24) == water);
+    CHECK(ramp.GetMaterial(999) == water);
+    CHECK(ramp.GetMaterial(1000) == bone);
+    CHECK(ramp.GetMaterial(1024) == bone);
+    CHECK(ramp.GetMaterial(5000) == bone);
+
+    // A range starting below the first setpoint still gets a material.
+    CTMaterialRamp wide(materials, 25, -2000, 2000);
+    CHECK(wide.GetMaterial(-3000) == air);
+
+    return CheckResult();
+}
@@ -0,0 +1,59 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef CHECK_HH
+#define CHECK_HH
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+
+// Each test is a small program that runs its checks and exits non-zero
+// if any of them failed. Files are written to the directory given as
+// the first argument, ctest passes the build directory.
+static int check_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            check_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_CLOSE(a, b, tolerance) CHECK(std::fabs((a) - (b)) <= (tolerance))
+
+static std::string TestPath(int argc, char** argv, std::string name) {
+    std::string directory = argc > 1 ? argv[1] : "/tmp";
+    return directory + "/" + name;
+}
+
+static int CheckResult() {
+    if (check_failures > 0) {
+        std::cerr << check_failures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+#endif /* CHECK_HH */
@@ -0,0 +1,118 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+#include "TestRecord.hh"
+
+#include "CompressedPhasespaceWriter.hh"
+#include "CompressedPhasespaceReader.hh"
+#include "PhasespaceRecord.hh"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+
+static void CheckRoundTrip(std::string filename, G4double position_step) {
+    int count = 1000;
+
+    // Small blocks, so reading and seeking cross block boundaries.
+    CompressedPhasespaceWriter writer(filename, 3, true, position_step, 0, 0, 64);
+    for (int i=0; i<count; i++)
+        writer.Write(MakeRecord(i));
+    writer.Close();
+
+    CompressedPhasespaceReader reader(filename);
+    CHECK(reader.GetRecordCount() == count);
+    CHECK(reader.GetNumberOfBlocks() == (count + 63)/64);
+
+    // Lossless files give back the floats that were written, quantised
+    // ones are within half a step of them.
+    G4double tolerance = position_step > 0 ? position_step/2 + 1e-4 : 0;
+
+    PhasespaceRecord record;
+    int read = 0;
+    while (reader.Read(record)) {
+        PhasespaceRecord expected = MakeRecord(read);
+        CHECK_CLOSE(record.position_x, (float) expected.position_x, tolerance);
+        CHECK_CLOSE(record.position_y, (float) expected.position_y, tolerance);
+        CHECK(record.kinetic_energy == (float) expected.kinetic_energy);
+        CHECK(record.particle_type == expected.particle_type);
+        CHECK(record.new_history == expected.new_history);
+        read++;
+    }
+    CHECK(read == count);
+
+    CHECK(reader.Seek(700));
+    CHECK(reader.Read(record));
+    CHECK_CLOSE(record.position_x, (float) MakeRecord(700).position_x, tolerance);
+}
+
+int main(int argc, char** argv) {
+    CheckRoundTrip(TestPath(argc, argv, "lossless.phsp"), 0);
+    CheckRoundTrip(TestPath(argc, argv, "quantised.phsp"), 0.01);
+
+    // Positions too far out for the quantised range stick to its ends
+    // and keep their sign.
+    std::string filename = TestPath(argc, argv, "clamped.phsp");
+    CompressedPhasespaceWriter writer(filename, 3, true, 0.01, 0, 0);
+    PhasespaceRecord far = MakeRecord(0);
+    far.position_x = 1e12;
+    far.position_y = -1e12;
+    writer.Write(far);
+    writer.Close();
+
+    CompressedPhasespaceReader reader(filename);
+    PhasespaceRecord record;
+    CHECK(reader.Read(record));
+    G4double limit = 0.01*std::numeric_limits<int32_t>::max();
+    CHECK_CLOSE(record.position_x, limit, 1e-6*limit);
+    CHECK_CLOSE(record.position_y, -limit, 1e-6*limit);
+
+    // A file in keV: the energy is scaled to MeV and the momentum follows
+    // from the scaled energy, it is not scaled again.
+    filename = TestPath(argc, argv, "lossless.phsp");
+    FILE* file = std::fopen(filename.c_str(), "r+b");
+    CHECK(file != NULL);
+    if (file == NULL)
+        return CheckResult();
+    PhasespaceHeader header;
+    CHECK(std::fread(&header, sizeof(header), 1, file) == 1);
+    header.energy_unit = keV;
+    std::rewind(file);
+    std::fwrite(&header, sizeof(header), 1, file);
+    std::fclose(file);
+
+    CompressedPhasespaceReader scaled(filename);
+    int read = 0;
+    while (scaled.Read(record)) {
+        PhasespaceRecord expected = MakeRecord(read);
+        G4double energy = (float) expected.kinetic_energy*keV;
+        G4double mass = expected.particle_type == 0 ? 0 : electron_mass_c2;
+        G4double momentum = std::sqrt(energy*(energy + 2*mass));
+        CHECK_CLOSE(record.kinetic_energy, energy, 1e-6*energy);
+        CHECK_CLOSE(record.GetMomentum().mag(), momentum, 1e-6*momentum);
+        read++;
+    }
+    CHECK(read == 1000);
+
+    return CheckResult();
+}
@@ -0,0 +1,136 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+
+#include "DoseGrid.hh"
+
+#include "boost/bind.hpp"
+#include "boost/thread.hpp"
+#include "boost/python.hpp"
+
+#include <cstdlib>
+
+
+static const int WORKERS = 4;
+static const int HISTORIES = 20000;
+
+// The dose of the next history of a worker, from its own seed.
+static G4double HistoryDose(unsigned int& seed) {
+    return rand_r(&seed)%100;
+}
+
+// Every history leaves its dose in three steps in voxel 0 or 1, and a
+// unit of dose in voxel 7.
+static void Score(DoseGrid* grid, G4int worker) {
+    DoseGridBuffer* buffer = grid->GetLocalBuffer();
+    unsigned int seed = worker + 1;
+
+    for (int h=0; h<HISTORIES; h++) {
+        grid->BeginHistory(buffer);
+        G4double dose = HistoryDose(seed);
+        for (int step=0; step<3; step++)
+            grid->Add(buffer, h%5 == 0 ? 1 : 0, dose/3, 1);
+        grid->Add(buffer, 7, 1, 1);
+        grid->EndHistory(buffer);
+    }
+}
+
+static void CheckGrid(G4bool atomic) {
+    DoseGrid grid(2, 2, 2);
+    grid.SetAtomic(atomic);
+
+    boost::thread_group workers;
+    for (int i=0; i<WORKERS; i++)
+        workers.create_thread(boost::bind(Score, &grid, i));
+    workers.join_all();
+    grid.Reduce(2);
+
+    G4double energy[2] = {0, 0};
+    G4double energysq[2] = {0, 0};
+    for (int i=0; i<WORKERS; i++) {
+        unsigned int seed = i + 1;
+        for (int h=0; h<HISTORIES; h++) {
+            G4double dose = HistoryDose(seed);
+            energy[h%5 == 0 ? 1 : 0] += dose;
+            energysq[h%5 == 0 ? 1 : 0] += dose*dose;
+        }
+    }
+
+    // Energy squared is summed per history, not per step.
+    CHECK(grid.GetHistories() == WORKERS*HISTORIES);
+    for (int v=0; v<2; v++) {
+        CHECK_CLOSE(grid.GetEnergyAt(v), energy[v], 1e-9*energy[v]);
+        CHECK_CLOSE(grid.energysq_histogram[v], energysq[v], 1e-9*energysq[v]);
+    }
+    CHECK(grid.counts_histogram[0] + grid.counts_histogram[1] == 3*WORKERS*HISTORIES);
+
+    // The same dose every history has no uncertainty.
+    CHECK(grid.GetEnergyAt(7) == WORKERS*HISTORIES);
+    CHECK(grid.energysq_histogram[7] == WORKERS*HISTORIES);
+    CHECK(grid.GetEnergyAt(3) == 0);
+
+    // A second run carries on from the first.
+    Score(&grid, 0);
+    grid.Reduce();
+    CHECK(grid.GetHistories() == (WORKERS + 1)*HISTORIES);
+    CHECK(grid.GetEnergyAt(7) == (WORKERS + 1)*HISTORIES);
+
+    grid.Zero();
+    CHECK(grid.GetHistories() == 0);
+    CHECK(grid.GetEnergyAt(7) == 0);
+}
+
+// Runs summed only once at the end, as a worker process does with its
+// chunks, score the same as runs summed one by one.
+static void CheckUnreducedRuns(G4bool atomic) {
+    DoseGrid each(2, 2, 2);
+    each.SetAtomic(atomic);
+    DoseGrid once(2, 2, 2);
+    once.SetAtomic(atomic);
+
+    for (int run=0; run<3; run++) {
+        Score(&each, run);
+        each.Reduce();
+        Score(&once, run);
+    }
+    once.Reduce();
+
+    CHECK(once.GetHistories() == each.GetHistories());
+    for (int v=0; v<8; v++) {
+        CHECK_CLOSE(once.GetEnergyAt(v), each.GetEnergyAt(v), 1e-9*each.GetEnergyAt(v));
+        CHECK_CLOSE(once.energysq_histogram[v], each.energysq_histogram[v],
+                1e-9*each.energysq_histogram[v]);
+    }
+}
+
+int main(int, char**) {
+    // The histograms are numpy arrays.
+    Py_Initialize();
+    boost::python::import("pyublas");
+
+    CheckGrid(false);
+    CheckGrid(true);
+    CheckUnreducedRuns(false);
+    CheckUnreducedRuns(true);
+
+    return CheckResult();
+}
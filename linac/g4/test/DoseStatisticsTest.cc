@@ -0,0 +1,139 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+
+#include "DoseStatistics.hh"
+#include "SensitiveDetector.hh"
+
+#include "boost/python.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+
+static const int X = 20;
+static const int Y = 13;
+static const int Z = 9;
+
+// A detector where voxel i got a dose of i%50 from a single history,
+// scored only inside `labels` if `masked`.
+static SensitiveDetector* MakeDetector(const std::vector<uint8_t>& labels, G4bool masked) {
+    SensitiveDetector* detector = SensitiveDetector::Create("test", "dose");
+    detector->SetVoxelData(X, Y, Z, std::vector<G4double>(X*Y*Z, 1.));
+    if (masked)
+        detector->SetScoringMask(labels);
+
+    DoseGrid* grid = detector->dose_grid;
+    DoseGridBuffer* buffer = grid->GetLocalBuffer();
+    grid->BeginHistory(buffer);
+    for (int i=0; i<X*Y*Z; i++) {
+        if (masked && labels[i] == 0)
+            continue;
+
+        G4int index = masked ? detector->GetScoringMask()->GetCompactIndex(i)
+            : grid->GetIndex(i/(Y*Z), (i/Z)%Y, i%Z);
+        grid->Add<false, false>(buffer, index, i%50, 1);
+    }
+    grid->EndHistory(buffer);
+    grid->Reduce();
+
+    return detector;
+}
+
+static void CheckStatistics(SensitiveDetector* detector, const std::vector<uint8_t>& labels) {
+    std::vector<G4double> doses;
+    for (int i=0; i<X*Y*Z; i++) {
+        if (labels[i] == 2)
+            doses.push_back(i%50);
+    }
+    std::sort(doses.begin(), doses.end());
+
+    G4double sum = 0;
+    G4int above = 0;
+    for (unsigned int i=0; i<doses.size(); i++) {
+        sum += doses[i];
+        if (doses[i] >= 25)
+            above++;
+    }
+
+    DoseStatistics statistics(detector, labels, 2, 3);
+    CHECK(statistics.GetVoxelCount() == (G4int) doses.size());
+    CHECK_CLOSE(statistics.GetMean(), sum/doses.size(), 1e-9);
+    CHECK(statistics.GetMinimum() == doses.front());
+    CHECK(statistics.GetMaximum() == doses.back());
+    CHECK_CLOSE(statistics.GetVolume(25), (G4double) above/doses.size(), 1e-9);
+    CHECK(statistics.GetDose(1) == doses.front());
+
+    // The differential histogram covers the whole structure, and the
+    // cumulative one starts from all of it.
+    pyublas::numpy_vector<G4double> differential = statistics.GetDifferential(10, 0);
+    pyublas::numpy_vector<G4double> cumulative = statistics.GetCumulative(10, 0);
+    G4double total = 0;
+    for (int i=0; i<10; i++)
+        total += differential[i];
+    CHECK_CLOSE(total, 1, 1e-9);
+    CHECK_CLOSE(cumulative[0], 1, 1e-9);
+    for (int i=1; i<10; i++)
+        CHECK(cumulative[i] <= cumulative[i - 1]);
+}
+
+int main(int, char**) {
+    // The histograms are numpy arrays.
+    Py_Initialize();
+    boost::python::import("pyublas");
+
+    std::vector<uint8_t> labels(X*Y*Z);
+    unsigned int seed = 7;
+    for (int i=0; i<X*Y*Z; i++)
+        labels[i] = rand_r(&seed)%3;
+
+    // The same structure whether the whole grid or only the mask is scored.
+    SensitiveDetector* full = MakeDetector(labels, false);
+    SensitiveDetector* masked = MakeDetector(labels, true);
+    CheckStatistics(full, labels);
+    CheckStatistics(masked, labels);
+
+    // Labels of another shape, and quantities other than dose, are refused.
+    G4bool thrown = false;
+    try {
+        DoseStatistics statistics(full, std::vector<uint8_t>(10, 2), 2);
+    } catch (std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    SensitiveDetector* fluence = SensitiveDetector::Create("fluence", "fluence");
+    fluence->SetVoxelData(X, Y, Z, std::vector<G4double>(X*Y*Z, 1.));
+    thrown = false;
+    try {
+        DoseStatistics statistics(fluence, labels, 2);
+    } catch (std::invalid_argument&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    delete full;
+    delete masked;
+    delete fluence;
+    return CheckResult();
+}
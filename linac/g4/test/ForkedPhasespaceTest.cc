@@ -0,0 +1,107 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+#include "TestRecord.hh"
+
+#include "AsyncPhasespaceWriter.hh"
+#include "PackedPhasespaceWriter.hh"
+#include "PhasespaceReader.hh"
+#include "PhasespaceRecord.hh"
+#include "PrefetchPhasespaceReader.hh"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+int main(int argc, char** argv) {
+    std::string source = TestPath(argc, argv, "forked_source.phsp");
+    std::string filename = TestPath(argc, argv, "forked.phsp");
+
+    int count = 100000;
+    PackedPhasespaceWriter source_writer(source);
+    for (int i=0; i<count; i++)
+        source_writer.Write(MakeRecord(i));
+    source_writer.Close();
+
+    // Both with their threads running: the ring is much smaller than the
+    // file, and some blocks are still queued.
+    PrefetchPhasespaceReader* reader =
+        new PrefetchPhasespaceReader(PhasespaceReader::Open(source), 1024);
+    PhasespaceRecord record;
+    for (int i=0; i<10; i++)
+        reader->Read(record);
+
+    int written = 250;
+    AsyncPhasespaceWriter* writer = new AsyncPhasespaceWriter(
+            new PackedPhasespaceWriter(filename), 100, 2);
+    for (int i=0; i<written; i++)
+        writer->Write(MakeRecord(i));
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Killed rather than left waiting on a thread it does not have.
+        alarm(10);
+
+        // What a worker does with the source and phasespaces it inherits.
+        delete reader;
+        delete writer;
+
+        PrefetchPhasespaceReader own(PhasespaceReader::Open(source), 1024);
+        int read = 0;
+        while (own.Read(record))
+            read++;
+
+        _exit(read == count ? 0 : 1);
+    }
+
+    int status;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // The parent reads on from where it was.
+    int read = 10;
+    int out_of_order = 0;
+    while (reader->Read(record)) {
+        if (record.position_x != read)
+            out_of_order++;
+        read++;
+    }
+    CHECK(read == count);
+    CHECK(out_of_order == 0);
+    delete reader;
+
+    // Every record the parent queued is written once, by the parent.
+    delete writer;
+    PhasespaceReader* written_reader = PhasespaceReader::Open(filename);
+    CHECK(written_reader != NULL);
+    if (written_reader == NULL)
+        return CheckResult();
+    CHECK(written_reader->GetRecordCount() == written);
+
+    read = 0;
+    while (written_reader->Read(record))
+        read++;
+    CHECK(read == written);
+
+    delete written_reader;
+    return CheckResult();
+}
@@ -0,0 +1,108 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+
+#include "IAEAPhasespaceWriter.hh"
+#include "IAEAPhasespaceReader.hh"
+#include "PartitionedPhasespaceReader.hh"
+#include "PhasespaceRecord.hh"
+
+#include <cstdio>
+
+
+// Our records are the type byte, seven floats and the history increment.
+static const int RECORD_LENGTH = 1 + 7*sizeof(float) + sizeof(int32_t);
+static const char IAEA_NEUTRON = 4;
+
+int main(int argc, char** argv) {
+    std::string filename = TestPath(argc, argv, "test.IAEAphsp");
+
+    // Histories 2, 4, 5 and 6 leave nothing behind, the increments still
+    // have to add up to the last history.
+    int64_t histories[] = {1, 1, 3, 7, 7, 8};
+    int count = 6;
+
+    IAEAPhasespaceWriter writer(filename);
+    for (int i=0; i<count; i++) {
+        PhasespaceRecord record;
+        record.position_x = i*cm;
+        record.position_y = 0;
+        record.position_z = 0;
+        record.momentum_x = 0;
+        record.momentum_y = 0;
+        record.momentum_z = -1;
+        record.kinetic_energy = 1*MeV;
+        record.weight = 1;
+        record.particle_type = 0;
+        record.history = histories[i];
+        record.new_history = i == 0 || histories[i] != histories[i - 1];
+        writer.Write(record);
+    }
+    writer.SetOriginalHistories(10);
+    writer.Close();
+
+    IAEAPhasespaceReader reader(filename);
+    CHECK(reader.GetRecordCount() == count);
+    CHECK(reader.GetOriginalHistories() == 10);
+
+    PhasespaceRecord record;
+    int64_t history = 0;
+    int read = 0;
+    while (reader.Read(record)) {
+        history += reader.GetExtraLongs()[0];
+        CHECK(history == histories[read]);
+        CHECK_CLOSE(record.position_x, read*cm, 1e-4);
+        CHECK(record.momentum_z < 0);
+        read++;
+    }
+    CHECK(read == count);
+    CHECK(reader.GetSkippedCount() == 0);
+
+    // Turn the second record into a neutron, which we cannot replay.
+    FILE* file = std::fopen(filename.c_str(), "r+b");
+    CHECK(file != NULL);
+    if (file == NULL)
+        return CheckResult();
+    std::fseek(file, RECORD_LENGTH, SEEK_SET);
+    std::fwrite(&IAEA_NEUTRON, 1, 1, file);
+    std::fclose(file);
+
+    IAEAPhasespaceReader skipping(filename);
+    read = 0;
+    while (skipping.Read(record))
+        read++;
+    CHECK(read == count - 1);
+    CHECK(skipping.GetSkippedCount() == 1);
+    CHECK(skipping.GetRecordCount() == count);
+
+    // The skipped record still counts towards the range of a partition.
+    PartitionedPhasespaceReader partition(new IAEAPhasespaceReader(filename), 0, 3);
+    read = 0;
+    while (partition.Read(record))
+        read++;
+    CHECK(read == 2);
+
+    IAEAPhasespaceReader searching(filename);
+    CHECK(searching.FindHistoryStart(1) == 2);
+
+    return CheckResult();
+}
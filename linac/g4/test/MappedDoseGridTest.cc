@@ -0,0 +1,107 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+
+#include "DoseGrid.hh"
+
+#include "boost/python.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+
+static void Score(DoseGrid* grid, G4int histories) {
+    DoseGridBuffer* buffer = grid->GetLocalBuffer();
+    for (int h=0; h<histories; h++) {
+        grid->BeginHistory(buffer);
+        grid->Add(buffer, grid->GetIndex(h%20, 3, 4), 1, 1);
+        grid->EndHistory(buffer);
+    }
+}
+
+int main(int argc, char** argv) {
+    // The histograms are numpy arrays.
+    Py_Initialize();
+    boost::python::import("pyublas");
+
+    // Start from nothing, whatever an earlier run of the test left.
+    std::string prefix = TestPath(argc, argv, "checkpoint");
+    const char* suffixes[] = {"_energy.npy", "_energy2.npy", "_counts.npy", "_histories.npy"};
+    for (int i=0; i<4; i++)
+        std::remove((prefix + suffixes[i]).c_str());
+
+    {
+        DoseGrid grid(20, 13, 9);
+        CHECK(grid.Map(prefix));
+        CHECK(grid.IsMapped());
+        Score(&grid, 100);
+        grid.Checkpoint();
+    }
+
+    // The files are plain .npy files.
+    FILE* file = std::fopen((prefix + "_energy.npy").c_str(), "rb");
+    CHECK(file != NULL);
+    if (file != NULL) {
+        char magic[6];
+        CHECK(std::fread(magic, 1, 6, file) == 6);
+        CHECK(std::memcmp(magic, "\x93NUMPY", 6) == 0);
+        std::fclose(file);
+    }
+
+    // A grid of the same shape carries on from the checkpoint.
+    {
+        DoseGrid grid(20, 13, 9);
+        CHECK(grid.Map(prefix));
+        CHECK(grid.GetHistories() == 100);
+        CHECK(grid.GetEnergyAt(grid.GetIndex(0, 3, 4)) == 5);
+
+        Score(&grid, 100);
+        grid.Reduce();
+        CHECK(grid.GetHistories() == 200);
+        CHECK(grid.GetEnergyAt(grid.GetIndex(0, 3, 4)) == 10);
+        CHECK(grid.GetCounts()[grid.GetIndex(19, 3, 4)] == 10);
+        grid.Checkpoint();
+    }
+
+    // Other shapes and tiled grids cannot use the files.
+    DoseGrid other(20, 13, 8);
+    CHECK(!other.Map(prefix));
+
+    DoseGrid tiled(20, 13, 9, true);
+    CHECK(!tiled.Map(prefix));
+
+    // Zeroing a mapped grid zeroes the files too.
+    {
+        DoseGrid grid(20, 13, 9);
+        CHECK(grid.Map(prefix));
+        CHECK(grid.GetHistories() == 200);
+        grid.Zero();
+        grid.Checkpoint();
+    }
+
+    DoseGrid zeroed(20, 13, 9);
+    CHECK(zeroed.Map(prefix));
+    CHECK(zeroed.GetHistories() == 0);
+    CHECK(zeroed.GetEnergyAt(zeroed.GetIndex(0, 3, 4)) == 0);
+
+    return CheckResult();
+}
@@ -0,0 +1,102 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+#include "TestRecord.hh"
+
+#include "PackedPhasespaceWriter.hh"
+#include "PhasespaceReader.hh"
+#include "PhasespaceRecord.hh"
+
+#include <cmath>
+#include <cstdio>
+
+
+int main(int argc, char** argv) {
+    std::string filename = TestPath(argc, argv, "packed.phsp");
+    int count = 1000;
+
+    PackedPhasespaceWriter writer(filename);
+    for (int i=0; i<count; i++)
+        writer.Write(MakeRecord(i));
+    writer.Close();
+
+    PhasespaceReader* reader = PhasespaceReader::Open(filename);
+    CHECK(reader != NULL);
+    if (reader == NULL)
+        return CheckResult();
+    CHECK(reader->GetRecordCount() == count);
+
+    PhasespaceRecord record;
+    int read = 0;
+    while (reader->Read(record)) {
+        PhasespaceRecord expected = MakeRecord(read);
+        CHECK(record.position_x == expected.position_x);
+        CHECK(record.position_y == expected.position_y);
+        CHECK_CLOSE(record.GetMomentum().unit().z(), -1, 1e-6);
+        CHECK_CLOSE(record.kinetic_energy, expected.kinetic_energy, 1e-6*expected.kinetic_energy);
+        CHECK(record.particle_type == expected.particle_type);
+        CHECK(record.new_history == expected.new_history);
+        read++;
+    }
+    CHECK(read == count);
+
+    // Records are fixed width, so any record can be reached directly.
+    CHECK(reader->Seek(517));
+    CHECK(reader->Read(record));
+    CHECK(record.position_x == 517);
+    CHECK(reader->FindHistoryStart(517) == 520);
+
+    delete reader;
+
+    // A file in keV: the energy is scaled to MeV and the momentum follows
+    // from the scaled energy, it is not scaled again.
+    FILE* file = std::fopen(filename.c_str(), "r+b");
+    CHECK(file != NULL);
+    if (file == NULL)
+        return CheckResult();
+    PhasespaceHeader header;
+    CHECK(std::fread(&header, sizeof(header), 1, file) == 1);
+    header.energy_unit = keV;
+    std::rewind(file);
+    std::fwrite(&header, sizeof(header), 1, file);
+    std::fclose(file);
+
+    reader = PhasespaceReader::Open(filename);
+    CHECK(reader != NULL);
+    if (reader == NULL)
+        return CheckResult();
+
+    read = 0;
+    while (reader->Read(record)) {
+        PhasespaceRecord expected = MakeRecord(read);
+        G4double energy = expected.kinetic_energy*keV;
+        G4double mass = expected.particle_type == 0 ? 0 : electron_mass_c2;
+        CHECK_CLOSE(record.kinetic_energy, energy, 1e-6*energy);
+        G4double momentum = std::sqrt(energy*(energy + 2*mass));
+        CHECK_CLOSE(record.GetMomentum().mag(), momentum, 1e-6*momentum);
+        read++;
+    }
+    CHECK(read == count);
+
+    delete reader;
+    return CheckResult();
+}
@@ -0,0 +1,94 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+
+#include "PackedPhasespaceWriter.hh"
+#include "PartitionedPhasespaceReader.hh"
+#include "PhasespaceReader.hh"
+#include "PhasespaceRecord.hh"
+
+#include <cstdlib>
+
+
+int main(int argc, char** argv) {
+    std::string filename = TestPath(argc, argv, "partitioned.phsp");
+    int count = 100003;
+
+    // Histories of a few records each, of random length.
+    PackedPhasespaceWriter writer(filename);
+    unsigned int seed = 11;
+    for (int i=0; i<count; i++) {
+        PhasespaceRecord record;
+        record.position_x = 0;
+        record.position_y = 0;
+        record.position_z = 0;
+        record.momentum_x = 0;
+        record.momentum_y = 0;
+        record.momentum_z = -1;
+        record.kinetic_energy = i;
+        record.weight = 1;
+        record.particle_type = 0;
+        record.new_history = i == 0 || rand_r(&seed)%5 == 0;
+        writer.Write(record);
+    }
+    writer.Close();
+
+    // Partitions aligned to histories cover every record once, in order,
+    // and each starts with a new history.
+    int partitions = 7;
+    int64_t expected = 0;
+    int out_of_order = 0;
+    int split_histories = 0;
+    for (int p=0; p<partitions; p++) {
+        PhasespaceReader* file = PhasespaceReader::Open(filename);
+        int64_t begin, end;
+        CHECK(file->GetPartition(p, partitions, true, begin, end));
+        CHECK(begin == expected);
+
+        PartitionedPhasespaceReader partition(file, begin, end);
+        CHECK(partition.GetRecordCount() == end - begin);
+
+        PhasespaceRecord record;
+        int64_t read = 0;
+        while (partition.Read(record)) {
+            if ((int64_t) record.GetKineticEnergy() != expected)
+                out_of_order++;
+            if (read == 0 && !record.IsNewHistory())
+                split_histories++;
+            expected++;
+            read++;
+        }
+        CHECK(read == end - begin);
+
+        // Seek is relative to the start of the partition.
+        if (end > begin) {
+            CHECK(partition.Seek(0));
+            CHECK(partition.Read(record));
+            CHECK(record.GetKineticEnergy() == begin);
+        }
+    }
+    CHECK(expected == count);
+    CHECK(out_of_order == 0);
+    CHECK(split_histories == 0);
+
+    return CheckResult();
+}
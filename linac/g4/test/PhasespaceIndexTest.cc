@@ -0,0 +1,103 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+#include "TestRecord.hh"
+
+#include "IndexingPhasespaceWriter.hh"
+#include "MappedPhasespaceReader.hh"
+#include "PackedPhasespaceWriter.hh"
+#include "PhasespaceIndex.hh"
+#include "PhasespaceReader.hh"
+#include "PhasespaceRecord.hh"
+
+
+int main(int argc, char** argv) {
+    std::string filename = TestPath(argc, argv, "indexed.phsp");
+    int count = 150000;
+    int64_t photons = 0;
+
+    IndexingPhasespaceWriter writer(new PackedPhasespaceWriter(filename), filename);
+    for (int i=0; i<count; i++) {
+        // Only photons in the first block.
+        PhasespaceRecord record = MakeRecord(i);
+        record.particle_type = i < 70000 ? 0 : i%3 - 1;
+        if (record.particle_type == 0)
+            photons++;
+        writer.Write(record);
+    }
+    writer.SetOriginalHistories(42);
+    writer.Close();
+
+    // The index is picked up with the file and matches its contents.
+    PhasespaceReader* reader = PhasespaceReader::Open(filename);
+    CHECK(reader != NULL);
+    if (reader == NULL)
+        return CheckResult();
+
+    PhasespaceIndex* index = reader->GetIndex();
+    CHECK(index != NULL);
+    if (index == NULL)
+        return CheckResult();
+
+    CHECK(index->GetRecordCount() == count);
+    CHECK(index->GetOriginalHistories() == 42);
+    CHECK(index->GetParticleCount(-1) + index->GetParticleCount(0) +
+            index->GetParticleCount(1) == count);
+    CHECK(index->GetParticleCount(0) == photons);
+    CHECK_CLOSE(index->GetMinimum(INDEX_KINETIC_ENERGY), 0.001, 1e-9);
+    CHECK_CLOSE(index->GetMaximum(INDEX_KINETIC_ENERGY), 0.001*count, 1e-5);
+
+    CHECK(index->GetNumberOfBlocks() == 3);
+    CHECK(index->GetBlock(1).first_record == 65536);
+    CHECK(index->GetBlock(0).particle_count[0] == 0);
+    CHECK(index->GetBlock(2).record_count == count - 2*65536);
+
+    // Building an index by reading the file gives the same summary.
+    PhasespaceIndex* built = PhasespaceIndex::Build(reader);
+    CHECK(built->GetRecordCount() == count);
+    CHECK(built->GetParticleCount(1) == index->GetParticleCount(1));
+    CHECK(built->GetNumberOfBlocks() == index->GetNumberOfBlocks());
+    delete built;
+    delete reader;
+
+    // A mapped reader limited to a range counts and seeks within it.
+    MappedPhasespaceReader mapped(filename);
+    CHECK(mapped.IsMapped());
+    CHECK(mapped.GetRecordCount() == count);
+    CHECK(mapped.SetRange(100, 200));
+    CHECK(mapped.GetRecordCount() == 100);
+
+    PhasespaceRecord record;
+    CHECK(mapped.Read(record));
+    CHECK(record.position_x == 100);
+    CHECK(mapped.Seek(10));
+    CHECK(mapped.Read(record));
+    CHECK(record.position_x == 110);
+
+    int read = 1;
+    while (mapped.Read(record))
+        read++;
+    CHECK(read == 90);
+    CHECK(record.position_x == 199);
+
+    return CheckResult();
+}
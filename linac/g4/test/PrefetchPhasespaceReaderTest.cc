@@ -0,0 +1,79 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+
+#include "PackedPhasespaceWriter.hh"
+#include "PhasespaceReader.hh"
+#include "PhasespaceRecord.hh"
+#include "PrefetchPhasespaceReader.hh"
+
+
+int main(int argc, char** argv) {
+    std::string filename = TestPath(argc, argv, "prefetch.phsp");
+    int count = 200000;
+
+    PackedPhasespaceWriter writer(filename);
+    for (int i=0; i<count; i++) {
+        PhasespaceRecord record;
+        record.position_x = 0;
+        record.position_y = 0;
+        record.position_z = 0;
+        record.momentum_x = 0;
+        record.momentum_y = 0;
+        record.momentum_z = -1;
+        record.kinetic_energy = i;
+        record.weight = 1;
+        record.particle_type = 0;
+        record.new_history = true;
+        writer.Write(record);
+    }
+    writer.Close();
+
+    // A ring much smaller than the file, so it is refilled many times.
+    PrefetchPhasespaceReader reader(PhasespaceReader::Open(filename), 1024);
+    CHECK(reader.GetRecordCount() == count);
+
+    // Records come out in file order, across a seek part way through.
+    PhasespaceRecord record;
+    int64_t expected = 0;
+    int out_of_order = 0;
+    while (reader.Read(record)) {
+        if ((int64_t) record.GetKineticEnergy() != expected)
+            out_of_order++;
+        expected++;
+
+        if (expected == 1000) {
+            CHECK(reader.Seek(150000));
+            expected = 150000;
+        }
+    }
+    CHECK(out_of_order == 0);
+    CHECK(expected == count);
+    CHECK(reader.IsExhausted());
+
+    // Seeking back starts over from there.
+    CHECK(reader.Seek(10));
+    CHECK(reader.Read(record));
+    CHECK(record.GetKineticEnergy() == 10);
+
+    return CheckResult();
+}
@@ -0,0 +1,111 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+
+#include "DoseGrid.hh"
+
+#include "boost/python.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+
+// Not a multiple of the brick size, so the bricks on the far sides hang
+// over the edges of the grid.
+static const int X = 20;
+static const int Y = 13;
+static const int Z = 9;
+
+// Each history leaves dose in a few voxels near the middle of the grid,
+// most voxels are never scored.
+static void Score(DoseGrid* grid) {
+    DoseGridBuffer* buffer = grid->GetLocalBuffer();
+    unsigned int seed = 3;
+
+    for (int h=0; h<2000; h++) {
+        grid->BeginHistory(buffer);
+        for (int step=0; step<4; step++) {
+            G4int x = 8 + rand_r(&seed)%4;
+            G4int y = 5 + rand_r(&seed)%3;
+            G4int z = 3 + rand_r(&seed)%3;
+            grid->Add(buffer, grid->GetIndex(x, y, z), 1 + rand_r(&seed)%10, 1);
+        }
+        grid->EndHistory(buffer);
+    }
+    grid->Reduce();
+}
+
+// The mean relative error over the scored voxels of the dense grid with
+// at least `threshold` times the largest dose, worked out by hand.
+static G4double Expected(DoseGrid* grid, G4double threshold) {
+    G4double n = grid->GetHistories();
+    G4double maximum = 0;
+    for (G4int i=0; i<grid->GetSize(); i++)
+        maximum = std::max(maximum, grid->energy_histogram[i]);
+
+    G4double total = 0;
+    G4int voxels = 0;
+    for (G4int i=0; i<grid->GetSize(); i++) {
+        G4double sum = grid->energy_histogram[i];
+        if (sum <= 0 || sum < threshold*maximum)
+            continue;
+
+        G4double mean = sum/n;
+        G4double variance = (grid->energysq_histogram[i]/n - mean*mean)/(n - 1);
+        total += std::sqrt(variance)/mean;
+        voxels++;
+    }
+    return total/voxels;
+}
+
+int main(int, char**) {
+    // The histograms are numpy arrays.
+    Py_Initialize();
+    boost::python::import("pyublas");
+
+    DoseGrid dense(X, Y, Z);
+    DoseGrid tiled(X, Y, Z, true);
+
+    // Nothing scored yet.
+    CHECK(dense.GetRegionUncertainty(0.5) < 0);
+    CHECK(tiled.GetRegionUncertainty(0.5) < 0);
+
+    Score(&dense);
+    Score(&tiled);
+
+    // Unscored voxels, and the overhang of the edge bricks, never count,
+    // so a zero threshold is the mean over every scored voxel and both
+    // storages agree.
+    G4double thresholds[] = {0, 0.25, 0.5, 1};
+    for (int t=0; t<4; t++) {
+        G4double expected = Expected(&dense, thresholds[t]);
+        CHECK(expected > 0);
+        CHECK_CLOSE(dense.GetRegionUncertainty(thresholds[t]), expected, 1e-12);
+        CHECK_CLOSE(tiled.GetRegionUncertainty(thresholds[t]), expected, 1e-12);
+    }
+
+    // Above the maximum no voxel is left.
+    CHECK(dense.GetRegionUncertainty(2) < 0);
+    CHECK(tiled.GetRegionUncertainty(2) < 0);
+
+    return CheckResult();
+}
@@ -0,0 +1,83 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+
+#include "ScoringMask.hh"
+
+#include "boost/python.hpp"
+
+#include <cstdlib>
+
+
+int main(int, char**) {
+    // Expand works on numpy arrays.
+    Py_Initialize();
+    boost::python::import("pyublas");
+
+    // Not a multiple of 64 voxels, so the last word is partly used.
+    G4int x = 13, y = 7, z = 11;
+    G4int size = x*y*z;
+
+    std::vector<uint8_t> labels(size);
+    unsigned int seed = 5;
+    for (G4int i=0; i<size; i++)
+        labels[i] = rand_r(&seed)%3 == 0 ? 1 + i%4 : 0;
+
+    ScoringMask mask(x, y, z, labels);
+    CHECK(mask.GetSize() == size);
+
+    // Scored voxels are numbered in order of their flat index.
+    G4int scored = 0;
+    G4int differences = 0;
+    for (G4int i=0; i<size; i++) {
+        if (mask.Contains(i) != (labels[i] != 0))
+            differences++;
+        if (mask.GetLabel(i) != labels[i])
+            differences++;
+
+        if (labels[i] != 0) {
+            if (mask.GetCompactIndex(i) != scored || mask.GetVoxels()[scored] != i)
+                differences++;
+            scored++;
+        }
+    }
+    CHECK(differences == 0);
+    CHECK(mask.GetVoxelCount() == scored);
+
+    // Expanding a compact histogram puts each value back at its voxel.
+    pyublas::numpy_vector<G4double> compact(scored);
+    for (G4int i=0; i<scored; i++)
+        compact[i] = i + 1;
+
+    pyublas::numpy_vector<G4double> full = mask.Expand(compact);
+    CHECK((G4int) full.size() == size);
+
+    differences = 0;
+    for (G4int i=0; i<size; i++) {
+        G4double expected = labels[i] != 0 ? mask.GetCompactIndex(i) + 1 : 0;
+        if (full[i] != expected)
+            differences++;
+    }
+    CHECK(differences == 0);
+
+    return CheckResult();
+}
@@ -0,0 +1,96 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+#include "TestRecord.hh"
+
+#include "CompressedPhasespaceReader.hh"
+#include "CompressedPhasespaceWriter.hh"
+#include "PackedPhasespaceWriter.hh"
+#include "ShardedPhasespaceReader.hh"
+#include "PhasespaceRecord.hh"
+
+#include <cstdio>
+
+
+// Shard s holds records [10*s, 10*s + 10).
+static void WriteShards(G4String filename, G4int shards, G4bool compressed) {
+    for (int s=0; s<shards; s++) {
+        G4String shard = ShardedPhasespaceReader::GetShardFilename(filename, s);
+        PhasespaceWriter* writer;
+        if (compressed)
+            writer = new CompressedPhasespaceWriter(shard, 3, true, 0.01, 0, 0);
+        else
+            writer = new PackedPhasespaceWriter(shard);
+        for (int i=0; i<10; i++)
+            writer->Write(MakeRecord(10*s + i));
+        writer->Close();
+        delete writer;
+    }
+}
+
+int main(int argc, char** argv) {
+    // The shards read back as one file, in order.
+    G4String packed = TestPath(argc, argv, "sharded.phsp");
+    WriteShards(packed, 3, false);
+
+    std::vector<G4String> shards = ShardedPhasespaceReader::FindShards(packed);
+    CHECK(shards.size() == 3);
+
+    ShardedPhasespaceReader reader(shards);
+    CHECK(reader.GetRecordCount() == 30);
+
+    PhasespaceRecord record;
+    int read = 0;
+    while (reader.Read(record)) {
+        CHECK(record.position_x == read);
+        read++;
+    }
+    CHECK(read == 30);
+
+    CHECK(reader.Seek(15));
+    CHECK(reader.Read(record));
+    CHECK(record.position_x == 15);
+
+    // A missing shard in the middle gives no shards at all.
+    std::remove(ShardedPhasespaceReader::GetShardFilename(packed, 1).c_str());
+    CHECK(ShardedPhasespaceReader::FindShards(packed).empty());
+
+    // Compressed shards merge into a compressed file with their steps.
+    G4String compressed = TestPath(argc, argv, "merged.phsp");
+    WriteShards(compressed, 2, true);
+    CHECK(ShardedPhasespaceReader::Merge(compressed, true));
+    CHECK(ShardedPhasespaceReader::FindShards(compressed).empty());
+
+    CompressedPhasespaceReader merged(compressed);
+    CHECK(merged.GetRecordCount() == 20);
+    CHECK(merged.GetCompressedHeader().encoding & PHASESPACE_ENCODING_QUANTIZED);
+    CHECK_CLOSE(merged.GetCompressedHeader().position_step, 0.01, 1e-6);
+
+    read = 0;
+    while (merged.Read(record)) {
+        CHECK_CLOSE(record.position_x, read, 0.005);
+        read++;
+    }
+    CHECK(read == 20);
+
+    return CheckResult();
+}
@@ -0,0 +1,48 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef TESTRECORD_HH
+#define TESTRECORD_HH
+
+#include "PhasespaceRecord.hh"
+
+
+// Record `i` of the phasespaces written by the tests: every field is set,
+// and position x, kinetic energy, particle type and the start of a
+// history change from record to record. Tests that need something else
+// change the fields they care about.
+static PhasespaceRecord MakeRecord(int i) {
+    PhasespaceRecord record;
+    record.position_x = i;
+    record.position_y = -0.5*i;
+    record.position_z = 100;
+    record.momentum_x = 0;
+    record.momentum_y = 0;
+    record.momentum_z = -1;
+    record.kinetic_energy = 0.001*(i + 1);
+    record.weight = 1;
+    record.particle_type = i%3 - 1;
+    record.new_history = i%4 == 0;
+    record.history = 0;
+    return record;
+}
+
+#endif /* TESTRECORD_HH */
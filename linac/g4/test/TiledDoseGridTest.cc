@@ -0,0 +1,133 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+
+#include "DoseGrid.hh"
+
+#include "boost/python.hpp"
+
+#include <cstdlib>
+#include <set>
+
+
+static const int X = 20;
+static const int Y = 13;
+static const int Z = 9;
+
+// Deposits in a corner of the grid only, so most bricks stay empty.
+static void Score(DoseGrid* grid, std::set<G4int>* bricks) {
+    DoseGridBuffer* buffer = grid->GetLocalBuffer();
+    unsigned int seed = 7;
+
+    for (int h=0; h<5000; h++) {
+        grid->BeginHistory(buffer);
+        for (int step=0; step<5; step++) {
+            G4int x = rand_r(&seed)%10;
+            G4int y = rand_r(&seed)%Y;
+            G4int z = rand_r(&seed)%Z;
+            G4double energy = rand_r(&seed)%100;
+
+            if (grid->HasEnergySq())
+                grid->Add(buffer, grid->GetIndex(x, y, z), energy, 1);
+            else
+                grid->Add<false, false>(buffer, grid->GetIndex(x, y, z), energy, 1);
+
+            if (bricks)
+                bricks->insert(((x/8)*2 + y/8)*2 + z/8);
+        }
+        grid->EndHistory(buffer);
+    }
+}
+
+int main(int, char**) {
+    // The histograms are numpy arrays.
+    Py_Initialize();
+    boost::python::import("pyublas");
+
+    DoseGrid dense(X, Y, Z);
+    DoseGrid tiled(X, Y, Z, true);
+    DoseGrid bare(X, Y, Z, true, false, false);
+
+    std::set<G4int> bricks;
+    Score(&dense, NULL);
+    Score(&tiled, &bricks);
+    Score(&bare, NULL);
+    dense.Reduce();
+    tiled.Reduce();
+    bare.Reduce();
+
+    // Only the bricks that saw dose are allocated.
+    CHECK(tiled.GetBrickCount() == (G4int) bricks.size());
+    CHECK(tiled.GetBrickCount() < 3*2*2);
+    CHECK(tiled.GetHistories() == dense.GetHistories());
+
+    // Tiled grids give back the same dense histograms.
+    pyublas::numpy_vector<G4double> energy = dense.GetEnergy();
+    pyublas::numpy_vector<G4double> energysq = dense.GetEnergySq();
+    pyublas::numpy_vector<G4double> counts = dense.GetCounts();
+
+    pyublas::numpy_vector<G4double> tiled_energy = tiled.GetEnergy();
+    pyublas::numpy_vector<G4double> tiled_energysq = tiled.GetEnergySq();
+    pyublas::numpy_vector<G4double> tiled_counts = tiled.GetCounts();
+
+    pyublas::numpy_vector<G4double> bare_energy = bare.GetEnergy();
+    pyublas::numpy_vector<G4double> bare_energysq = bare.GetEnergySq();
+
+    CHECK(tiled_energy.size() == energy.size());
+    CHECK(bare_energysq.size() == energy.size());
+
+    int differences = 0;
+    for (int x=0; x<X; x++) {
+        for (int y=0; y<Y; y++) {
+            for (int z=0; z<Z; z++) {
+                G4int i = (x*Y + y)*Z + z;
+                if (tiled_energy[i] != energy[i] || tiled_energysq[i] != energysq[i]
+                        || tiled_counts[i] != counts[i])
+                    differences++;
+                if (tiled.GetEnergyAt(tiled.GetIndex(x, y, z)) != energy[i])
+                    differences++;
+
+                // Without energy squared and counts only the energy is kept.
+                if (bare_energy[i] != energy[i] || bare_energysq[i] != 0)
+                    differences++;
+            }
+        }
+    }
+    CHECK(differences == 0);
+
+    // Merging dense histograms into a tiled grid adds them voxel by voxel.
+    tiled.Merge(energy, energysq, counts, dense.GetHistories());
+    CHECK(tiled.GetHistories() == 2*dense.GetHistories());
+    tiled_energy = tiled.GetEnergy();
+    differences = 0;
+    for (G4int i=0; i<dense.GetSize(); i++) {
+        if (tiled_energy[i] != 2*energy[i])
+            differences++;
+    }
+    CHECK(differences == 0);
+
+    tiled.Zero();
+    CHECK(tiled.GetHistories() == 0);
+    CHECK(tiled.GetEnergyAt(tiled.GetIndex(1, 1, 1)) == 0);
+
+    return CheckResult();
+}
@@ -0,0 +1,92 @@
+//////////////////////////////////////////////////////////////////////////
+// License & Copyright
+// ===================
+// 
+// Copyright 2013 Christopher M Poole <mail@christopherpoole.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "Check.hh"
+
+#include "XoshiroEngine.hh"
+
+#include <algorithm>
+
+
+int main(int argc, char** argv) {
+    // First numbers for seed 12345, from an independent implementation
+    // of SplitMix64 seeding and xoshiro256**.
+    XoshiroEngine engine(12345);
+    CHECK(engine.flat() == 0.5652781325052542);
+    CHECK(engine.flat() == 0.4089957087586281);
+    CHECK(engine.flat() == 0.7412884670095555);
+
+    // The same seeds give the same sequence, neighbouring ones do not.
+    long seeds[3] = {12345, 678, 0};
+    long neighbours[3] = {12345, 679, 0};
+    XoshiroEngine first, second, third;
+    first.setSeeds(seeds, -1);
+    second.setSeeds(seeds, -1);
+    third.setSeeds(neighbours, -1);
+
+    int same = 0;
+    int different = 0;
+    for (int i=0; i<1000; i++) {
+        double value = first.flat();
+        if (value == second.flat())
+            same++;
+        if (value != third.flat())
+            different++;
+    }
+    CHECK(same == 1000);
+    CHECK(different == 1000);
+    CHECK(first.getSeed() == 12345);
+
+    // Uniform on (0, 1).
+    int count = 1000000;
+    double sum = 0;
+    double minimum = 1;
+    double maximum = 0;
+    for (int i=0; i<count; i++) {
+        double value = engine.flat();
+        sum += value;
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+    }
+    CHECK(minimum > 0);
+    CHECK(maximum < 1);
+    CHECK_CLOSE(sum/count, 0.5, 0.002);
+
+    // A saved status carries on from where it was saved.
+    std::string filename = TestPath(argc, argv, "Xoshiro.conf");
+    engine.saveStatus(filename.c_str());
+    double saved[10];
+    engine.flatArray(10, saved);
+
+    engine.restoreStatus(filename.c_str());
+    double restored[10];
+    engine.flatArray(10, restored);
+    for (int i=0; i<10; i++)
+        CHECK(restored[i] == saved[i]);
+
+    // A file without a status leaves the engine as it was.
+    engine.restoreStatus(filename.c_str());
+    engine.restoreStatus(TestPath(argc, argv, "missing.conf").c_str());
+    engine.flatArray(10, restored);
+    CHECK(restored[0] == saved[0]);
+
+    return CheckResult();
+}
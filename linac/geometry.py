@@ -302,6 +302,7 @@ class Linac(object):
         vacuum: Vacuum parts Mother volume
         phasespaces: All phasespace files used or created
         gun: The particle gun configuration
+        random: The random engine configuration, may be empty
     """
     def __init__(self, filename):
         self.config = yaml.load(file(filename))
@@ -310,6 +311,7 @@ class Linac(object):
         self.phasespaces = self.config['phasespaces']
 
         self.gun = self.config["gun"]
+        self.random = self.config.get("random", {})
 
     def rounded_leaf_position(self, leaf_radius, radius_position,
             field_size, iso_position=1000.):
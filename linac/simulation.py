@@ -1,5 +1,11 @@
 # Standard Library
+import atexit
+import multiprocessing
+import os
 import random
+import shutil
+import tempfile
+import time
 
 # GEANT4
 import Geant4
@@ -17,9 +23,16 @@ class Simulation(object):
     """The base GEANT4 application
 
     The simulation proper is initialised here, along with the geometry described
-    by the world `Volume` and each daughter `Volume` within.
+    by the world `Volume` and each daughter `Volume` within. With more than one of
+    `threads` events are run on that many worker threads, all scoring into the one set
+    of histograms, when Geant4 is built with multithreading. Workers write their own
+    shard of each phasespace, put back together by `merge_phasespace`.
+
+    Geant4 allows one run manager per process, made as `linac` is first imported. Set
+    LINAC_THREADS above one in the environment before then for a multithreaded one, any
+    number of `threads` can then be asked for.
     """
-    def __init__(self, name, config, phsp_dir='.', run_id=0):
+    def __init__(self, name, config, phsp_dir='.', run_id=0, threads=1, seed=None):
         self.name = name
         self.run_id = run_id
 
@@ -31,7 +44,20 @@ class Simulation(object):
         self.phsp_dir = phsp_dir
 
         self.source = None
+        self.source_mmap = False
+        self.source_partition = (0, 1)
+        self.source_range = (0, -1)
         self.phasespaces = []
+        self.meshes = []
+        self.checkpoint_prefix = None
+
+        self.run_manager = g4.GetRunManager(threads)
+        self.multithreaded = g4.IsMultithreaded()
+        self.threads = g4.GetNumberOfThreads()
+
+        if self.threads != threads:
+            raise RuntimeError("%i threads asked for, but the run manager is sequential. Set "
+                "LINAC_THREADS before linac or Geant4 is first imported." % threads)
 
         self.detector_construction = g4.DetectorConstruction()
 
@@ -40,28 +66,48 @@ class Simulation(object):
         self.detector_construction.SetWorldMaterial(self.config.world.material)
         self.detector_construction.SetWorldColour(self.config.world.color)
 
-        Geant4.gRunManager.SetUserInitialization(self.detector_construction)
+        self.run_manager.SetUserInitialization(self.detector_construction)
 
         self.physics_list = g4.PhysicsList()
-        Geant4.gRunManager.SetUserInitialization(self.physics_list)
+        self.run_manager.SetUserInitialization(self.physics_list)
 
         self.primary_generator = g4.PrimaryGeneratorAction()
-        Geant4.gRunManager.SetUserAction(self.primary_generator)
 
-        self.event_action = g4.EventAction()
-        Geant4.gRunManager.SetUserAction(self.event_action)
+        if self.multithreaded:
+            # Each worker builds its own actions, its generator copies the
+            # settings of this one before every run.
+            g4.SetActionInitialization(self.primary_generator)
+        else:
+            self.run_manager.SetUserAction(self.primary_generator)
+
+            self.event_action = g4.EventAction()
+            self.run_manager.SetUserAction(self.event_action)
+
+            self.stepping_action = g4.SteppingAction()
+            self.run_manager.SetUserAction(self.stepping_action)
+
+            # Sums the dose scored by each worker at the end of every run.
+            self.run_action = g4.RunAction()
+            self.run_manager.SetUserAction(self.run_action)
 
-        self.stepping_action = g4.SteppingAction()
-        Geant4.gRunManager.SetUserAction(self.stepping_action)
+        self.set_random_engine(self.config.random.get("engine", "ranlux64"))
 
-        self.rand_engine= Geant4.Ranlux64Engine()
-        Geant4.HepRandom.setTheEngine(self.rand_engine)
-        self.seed = random.randint(0, 2**32)
+        # Every event is reseeded from this and its run and event numbers,
+        # give the same seed to get the same events back.
+        if seed is None:
+            seed = random.randint(1, 2**31 - 1)
+        self.seed = seed
         Geant4.HepRandom.setTheSeed(self.seed)
+        self.runs = 0
+        self.run = 0
 
-        Geant4.gRunManager.Initialize()
+        self.run_manager.Initialize()
 
         self.build_geometry()
+
+        # Phasespaces are written from a background thread, make sure
+        # anything still buffered reaches the disk.
+        atexit.register(self.close_phasespaces)
     
     ## Primary generator ##
 
@@ -74,14 +120,23 @@ class Simulation(object):
         """
         self.primary_generator.Reset()
 
-    def enable_phasespace_source(self, name):
+    def enable_phasespace_source(self, name, mmap=False, partition=None, record_range=None):
         """Set the primary generator action source to draw from an existing phasespace file. If
         the nominated phasespace file is open for recoding, it will be disabled automatically.
+        With `mmap` a packed phasespace file is memory mapped and read in place.
+
+        Parallel workers can each replay their own share of the file, either by giving
+        `partition` as an (index, count) pair, which splits the file on history boundaries,
+        or an explicit `record_range` of (begin, end) records, with an end of -1 meaning the
+        end of the file.
         """
         if name in self.phasespaces:
             self.disable_phasespace(name)
 
         self.source = name
+        self.source_mmap = mmap
+        self.source_partition = partition or (0, 1)
+        self.source_range = record_range or (0, -1)
 
     def disable_phasespace_source(self):
         """Remove any phasespace set as the primary generator action source, defaults to
@@ -89,6 +144,17 @@ class Simulation(object):
         """
         self.source = None
 
+    ## Random numbers ##
+
+    def set_random_engine(self, name):
+        """Draw random numbers from engine `name`: "ranlux64", "ranlux", "james", "ranecu",
+        "mtwist", "mixmax" or "xoshiro". Worker threads switch over at the start of the next
+        run. Every event is reseeded, so a change of engine needs no new seed.
+        """
+        if not g4.UseRandomEngine(name):
+            raise ValueError("Unknown random engine: %s" % name)
+        self.random_engine = name
+
     ## Physics ##
 
     def set_cuts(self, gamma=1., electron=1.):
@@ -147,9 +213,18 @@ class Simulation(object):
 
     ## Scoring ##
 
-    def save_histograms(self, directory, name, runid):
+    def save_histograms(self, directory, name, runid, sparse=False):
         """Dump the saved `numpy` array histograms, that align with the voxel data,to disk.
+
+        With `sparse`, only the scored voxels are written, to a single `.npz` of flat
+        `index`, `energy`, `energy2` and `counts` arrays.
         """
+        if sparse:
+            index, energy, energy2, counts = self.detector_construction.GetSparseHistograms()
+            numpy.savez("%s/sparse_%s_%s_%s" % (directory, self.name, name, runid),
+                index=index, energy=energy, energy2=energy2, counts=counts)
+            return
+
         energy_data = self.detector_construction.GetEnergyHistogram()
         numpy.save("%s/energy_%s_%s_%s" % (directory, self.name, name, runid), energy_data)
 
@@ -159,6 +234,164 @@ class Simulation(object):
         counts_data = self.detector_construction.GetCountsHistogram()
         numpy.save("%s/counts_%s_%s_%s" % (directory, self.name, name, runid), counts_data)
 
+        uncertainty_data = self.detector_construction.GetUncertaintyHistogram()
+        numpy.save("%s/uncertainty_%s_%s_%s" % (directory, self.name, name, runid), uncertainty_data)
+
+        # Quantities scored into several grids get one file for each.
+        if self.detector_construction.GetHistogramCount() > 1:
+            for quantity, data in self.get_histograms().iteritems():
+                numpy.save("%s/%s_%s_%s_%s" % (directory, quantity, self.name, name, runid), data)
+
+    def use_checkpoints(self, prefix, events=0, seconds=600):
+        """Keep the histograms in memory mapped `<prefix>_energy.npy` (`_energy2`, `_counts`,
+        `_histories`) files, brought up to date every `events` events or `seconds` seconds
+        and at the end of every run. If the files are already there from an earlier run of
+        the same grid, accumulation carries on from them, so a crashed run can be resumed
+        in a new process. Must be set before the first event.
+        """
+        self.detector_construction.SetCheckpoint(prefix, events, seconds)
+        self.checkpoint_prefix = prefix
+
+    @staticmethod
+    def load_checkpoint(prefix):
+        """Read checkpointed histograms without copying them, as read only memory maps.
+        Safe to call from another process while the simulation is running.
+        """
+        histograms = {}
+        for quantity in ("energy", "energy2", "counts"):
+            filename = "%s_%s.npy" % (prefix, quantity)
+            if os.path.exists(filename):
+                histograms[quantity] = numpy.load(filename, mmap_mode="r")
+        histograms["histories"] = int(numpy.load("%s_histories.npy" % prefix)[0])
+
+        return histograms
+
+    def set_scoring_mask(self, labels):
+        """Score only inside a region of interest: `labels` is a volume the shape of the CT
+        (or phantom grid) where zero is outside and any other label, up to 255, is scored.
+        Only the labelled voxels are kept, the histograms read back at full shape with
+        zeros outside. Must be set before the first event.
+        """
+        labels = numpy.ascontiguousarray(labels, dtype=numpy.uint8)
+        self.detector_construction.SetScoringMask(labels)
+
+    def set_structures(self, labels):
+        """Label the structures `get_dose_statistics` looks at, a volume the shape of the CT
+        with zero for no structure and labels up to 255. Defaults to the scoring mask.
+        """
+        labels = numpy.ascontiguousarray(labels, dtype=numpy.uint8)
+        self.detector_construction.SetStructures(labels)
+
+    def get_dose_statistics(self, label, bins=100, maximum=0, volumes=(0.02, 0.5, 0.95, 0.98),
+            doses=()):
+        """Dose volume histograms and statistics of the structure `label`, computed by the
+        detector across all cores rather than from the full histograms in numpy. Returns a
+        dict of "voxels", "volume", "mean", "minimum", "maximum", the `bins` bin "edges" up to
+        `maximum` (zero for the largest dose) with the "differential" and "cumulative"
+        histograms as volume fractions, "D" the dose to each fraction in `volumes` (D98 for
+        0.98) and "V" the fraction getting at least each of `doses`. Dose split by particle
+        is summed first. Raises ValueError if the scoring quantity is not a dose or the labels
+        are not shaped like the detector.
+        """
+        return self.detector_construction.GetDoseStatistics(label, bins, maximum,
+            numpy.asarray(volumes, dtype=numpy.float64),
+            numpy.asarray(doses, dtype=numpy.float64))
+
+    def use_scoring_quantity(self, quantity):
+        """Choose what the phantom or CT detector scores, before it is set up: "dose" alone,
+        "dose_uncertainty" (dose, energy squared and counts, the default), "fluence",
+        "kerma", "particle_dose" or "let". Only the arrays the quantity needs are kept.
+        """
+        self.detector_construction.SetScoringQuantity(quantity)
+
+    def set_mass_energy_absorption(self, energies, coefficients):
+        """Photon mass energy absorption coefficients (Geant4 units) against energy, for
+        scoring kerma.
+        """
+        self.detector_construction.SetMassEnergyAbsorption(
+            numpy.asarray(energies, dtype=numpy.float64),
+            numpy.asarray(coefficients, dtype=numpy.float64))
+
+    def get_histograms(self):
+        """The histogram of each grid the scoring quantity uses, by name. For "let" the dose
+        averaged LET itself is added as `let`.
+        """
+        histograms = {}
+        for i in range(self.detector_construction.GetHistogramCount()):
+            name = self.detector_construction.GetHistogramName(i)
+            histograms[name] = self.detector_construction.GetHistogram(i)
+
+        if histograms.has_key("let_weighted"):
+            energy = histograms["energy"]
+            histograms["let"] = numpy.where(energy > 0,
+                histograms["let_weighted"]/numpy.where(energy > 0, energy, 1), 0)
+
+        return histograms
+
+    def add_scoring_mesh(self, name, size, bins, shape="box", translation=(0, 0, 0),
+            rotation=(0, 0, 0), quantity="dose"):
+        """Score into a mesh of its own in the parallel world, independent of the phantom
+        or CT. A box of `size` (mm) is binned in x, y and z, a cylinder of `size` (radius,
+        unused, length) in r, phi and z. `quantity` is "dose" or "energy". Each step is
+        shared out between the bins it passes through, in proportion to its length in each.
+        """
+        if name in self.meshes:
+            raise ValueError("There is already a scoring mesh called %s." % name)
+
+        self.detector_construction.AddScoringMesh(name, shape,
+            G4ThreeVector(*[s*mm for s in size]), bins[0], bins[1], bins[2],
+            G4ThreeVector(*[t*mm for t in translation]), G4ThreeVector(*rotation), quantity)
+        self.meshes.append(name)
+
+    def add_depth_dose(self, name, depth, bins, width=10., translation=(0, 0, 0)):
+        """A 1D tally along z, of `width` (mm) square, for a depth dose curve.
+        """
+        self.add_scoring_mesh(name, (width, width, depth), (1, 1, bins),
+            translation=translation)
+
+    def add_profile(self, name, length, bins, width=2., translation=(0, 0, 0), axis="x"):
+        """A 1D tally across the beam along `axis`, `width` (mm) square in the other two.
+        """
+        if axis == "x":
+            self.add_scoring_mesh(name, (length, width, width), (bins, 1, 1),
+                translation=translation)
+        else:
+            self.add_scoring_mesh(name, (width, length, width), (1, bins, 1),
+                translation=translation)
+
+    def add_plane(self, name, side, bins, thickness=2., translation=(0, 0, 0)):
+        """A 2D tally of `bins` by `bins` across the beam, `thickness` (mm) deep.
+        """
+        self.add_scoring_mesh(name, (side, side, thickness), (bins, bins, 1),
+            translation=translation)
+
+    def remove_scoring_mesh(self, name):
+        self.detector_construction.RemoveScoringMesh(name)
+        self.meshes.remove(name)
+
+    def save_scoring_mesh(self, directory, name, runid):
+        """Dump the histograms of a scoring mesh to disk, squeezed down to its 1D or 2D shape.
+        """
+        mesh = self.detector_construction.GetScoringMesh(name)
+        numpy.save("%s/energy_%s_%s_%s" % (directory, self.name, name, runid),
+            numpy.squeeze(mesh.GetEnergyHistogram()))
+        numpy.save("%s/uncertainty_%s_%s_%s" % (directory, self.name, name, runid),
+            numpy.squeeze(mesh.GetUncertaintyHistogram()))
+        numpy.save("%s/counts_%s_%s_%s" % (directory, self.name, name, runid),
+            numpy.squeeze(mesh.GetCountsHistogram()))
+
+    def use_atomic_scoring(self, atomic=True):
+        """Have every worker score into the one set of histograms with atomic adds, instead
+        of keeping a private copy of the grid each. Slower, but needs a single grid of memory.
+        """
+        self.detector_construction.SetAtomicScoring(atomic)
+
+    def use_tiled_scoring(self, tiled=True):
+        """Keep the histograms in 8x8x8 bricks allocated only where dose is scored, so
+        memory follows the irradiated volume rather than the size of the grid.
+        """
+        self.detector_construction.SetTiledScoring(tiled)
+
     def zero_histograms(self):
         """Zero all historams without regard for their content.
         """
@@ -237,15 +470,25 @@ class Simulation(object):
 
         self.build_phasespaces() 
 
-        run_manager = Geant4.G4RunManager.GetRunManager()
-        run_manager.GeometryHasBeenModified()
+        self.run_manager.GeometryHasBeenModified()
 
     ## Phasespace files ##
 
     def get_phasespace_filename(self, name):
         """Generate a filename from the name of the phasespace as in the `Linac` configuration
+
+        A `filename` in the phasespace configuration is used as is (a vendor supplied IAEA
+        phasespace for example), and `format: iaea` writes an IAEA header/phsp pair.
         """
-        return "%s/%s_%s_%s.phsp" % (self.phsp_dir, name, self.name, self.run_id)
+        ps = self.config.phasespaces[name]
+        if ps.has_key("filename"):
+            return ps["filename"]
+
+        extension = "phsp"
+        if ps.get("format") == "iaea":
+            extension = "IAEAphsp"
+
+        return "%s/%s_%s_%s.%s" % (self.phsp_dir, name, self.name, self.run_id, extension)
   
     def enable_phasespace(self, name):
         self.phasespaces.append(name)
@@ -259,23 +502,349 @@ class Simulation(object):
     def disable_all_phasespaces(self):
         map(self.disable_phasespace, self.phasespaces)
 
+    def close_phasespaces(self):
+        """Flush and close every open phasespace file.
+        """
+        self.detector_construction.ClosePhasespace()
+
+    def merge_phasespace(self, name, remove_shards=True):
+        """Concatenate the shards written by each worker for a phasespace into the one file.
+        Unmerged shards can also be read directly as a phasespace source.
+        """
+        return g4.MergePhasespaceShards(self.get_phasespace_filename(name), remove_shards)
+
     def build_phasespaces(self):
         """Create an empty phasespace file to write into, and insert it into the geometry.
         """ 
         for phasespace in self.phasespaces:
             ps = self.config.phasespaces[phasespace]
-            self.detector_construction.AddPhasespace(self.get_phasespace_filename(phasespace),
+            filename = self.get_phasespace_filename(phasespace)
+            self.detector_construction.AddPhasespace(filename,
                     ps["radius"], ps["z_position"], ps["kill"])
 
+            # Optional block compression, steps of zero are lossless.
+            if ps.has_key("compression"):
+                c = ps["compression"]
+                self.detector_construction.SetPhasespaceCompression(filename,
+                        c.get("level", 3), c.get("delta", True),
+                        c.get("position_step", 0.), c.get("direction_step", 0.),
+                        c.get("energy_step", 0.))
+
     ## Run ##
+
+    def get_source_histories(self):
+        """The number of events needed to replay the phasespace source exactly once.
+        """
+        if self.source is None:
+            raise ValueError("Only a phasespace source has a natural run length.")
+
+        records = self.primary_generator.GetSourceRecordCount()
+        if records < 0:
+            raise RuntimeError("Phasespace source has no record count, build an index for it.")
+
+        if self.config.gun.get("batch_recycling", False):
+            return records
+        return records*(self.config.gun["recycling_number"] + 1)
  
-    def beam_on(self, histories, fwhm=2.0*mm, energy=6*MeV):
+    def beam_on(self, histories=None, fwhm=2.0*mm, energy=6*MeV, prefetch_depth=65536):
         """Shoot particles from the primary generator into the geometry. Here we automatically
-        select between a bare source, or phasespace if one is specified.
+        select between a bare source, or phasespace if one is specified. Phasespace records
+        are read `prefetch_depth` records ahead of the event loop, zero reads them on demand.
+        Without `histories` a phasespace source is replayed exactly once, which needs a
+        format or sidecar index that knows its record count.
+        Returns False if the phasespace source ran out of particles before the run finished.
+        """
+        self.set_up_source(fwhm, energy, prefetch_depth)
+        self.start_run()
+
+        if histories is None:
+            histories = self.get_source_histories()
+
+        self.shoot(histories)
+
+        if self.source is not None:
+            self.primary_generator.PrintSourceStatistics()
+            return not self.primary_generator.IsSourceExhausted()
+
+        return True
+
+    def beam_on_until(self, uncertainty, threshold=0.5, chunk=100000, max_histories=None,
+            max_seconds=None, fwhm=2.0*mm, energy=6*MeV, prefetch_depth=65536):
+        """Run in chunks of `chunk` histories until the mean relative uncertainty of the voxels
+        above `threshold` times the maximum dose falls to `uncertainty`, or `max_histories` or
+        `max_seconds` is reached. A phasespace source is opened once and read on through the
+        chunks, and the chunks are seeded as the one run, so they give the same events as a
+        single `beam_on` would. Needs a scoring quantity that keeps the energy squared,
+        "dose_uncertainty". Returns the uncertainty reached, negative if nothing was scored.
+        Raises ValueError unless 0 < `threshold` <= 1.
+        """
+        if not 0 < threshold <= 1:
+            raise ValueError("The threshold must be in (0, 1], not %s." % threshold)
+
+        self.set_up_source(fwhm, energy, prefetch_depth)
+        self.start_run()
+
+        start = time.time()
+        histories = 0
+        reached = -1.
+
+        while True:
+            if max_histories is not None:
+                if histories >= max_histories:
+                    break
+                run = min(chunk, max_histories - histories)
+            else:
+                run = chunk
+
+            self.shoot(run, histories)
+            histories += run
+
+            reached = self.detector_construction.GetRegionUncertainty(threshold)
+
+            if 0 <= reached <= uncertainty:
+                break
+            if max_seconds is not None and time.time() - start >= max_seconds:
+                break
+            if self.source is not None and self.primary_generator.IsSourceExhausted():
+                break
+
+        if self.source is not None:
+            self.primary_generator.PrintSourceStatistics()
+
+        return reached
+
+    def beam_on_parallel(self, histories=None, processes=2, directory=None, chunk_time=1.,
+            fwhm=2.0*mm, energy=6*MeV, prefetch_depth=65536):
+        """Split a run over `processes` worker processes forked from this one, once the
+        geometry is built, so they share everything already set up. Each worker runs its own
+        range of the event numbers, so with a bare gun source the dose is the same whatever
+        the number of workers, replays its own partition of a phasespace source and writes
+        its own shard of each phasespace. The dose grids and scoring meshes
+        of the workers are summed back into this simulation and the phasespace shards merged
+        once they have all finished. The workers pass their histograms through temporary files
+        in `directory`, by default the system temporary directory. Without `histories` a
+        phasespace source is replayed exactly once over all workers.
+
+        With a bare gun source the workers take chunks of events from a shared counter
+        rather than an equal share each, see `shoot_chunks`, so a worker that draws costly
+        events does not hold up the rest at the end of the run. `chunk_time` is how long in
+        seconds a chunk should take, each chunk is a run of its own, but the dose of a worker
+        is only summed once all its chunks are done.
+        Returns False if any worker failed. Checkpoints cannot be used, every worker would
+        add its dose to the same files.
+        """
+        if self.multithreaded:
+            raise RuntimeError("Run either on worker threads or worker processes, not both.")
+        if self.checkpoint_prefix is not None:
+            raise RuntimeError("Checkpoints cannot be combined with worker processes.")
+
+        # The workers get none of the helper threads of this process, so stop the source
+        # prefetching and write out whatever an earlier run left queued for the phasespaces
+        # before forking. The workers open their own source, and `update_geometry` gives
+        # them phasespaces not yet written to.
+        self.primary_generator.SetSource(None)
+        self.close_phasespaces()
+
+        self.update_geometry()
+        self.start_run()
+
+        scratch = tempfile.mkdtemp(prefix="linac_", dir=directory)
+
+        # Shared by the workers, the first event not yet handed out.
+        counter = None
+        if histories is not None and self.source is None:
+            counter = multiprocessing.Value("l", 0)
+
+        children = []
+        first_event = 0
+        for worker in range(processes):
+            if counter is not None:
+                # All of them, as many as this worker gets to.
+                share = histories
+            elif histories is None:
+                # The length of each partition is only known to its worker, keep
+                # the event numbers of the workers well apart instead.
+                share = None
+                first_event = worker*2**32
+            else:
+                share = histories/processes + (1 if worker < histories % processes else 0)
+
+            pid = os.fork()
+            if pid == 0:
+                # Never return into the caller, whatever happens here.
+                status = 1
+                try:
+                    self.run_worker(worker, processes, share, first_event, scratch, fwhm,
+                        energy, prefetch_depth, counter, chunk_time)
+                    status = 0
+                finally:
+                    os._exit(status)
+
+            children.append(pid)
+            if counter is None and share is not None:
+                first_event += share
+
+        failed = 0
+        for pid in children:
+            _, status = os.waitpid(pid, 0)
+            if status != 0:
+                failed += 1
+
+        grids = self.get_dose_grids()
+        for worker in range(processes):
+            for i, grid in enumerate(grids):
+                prefix = "%s/%i_%i" % (scratch, worker, i)
+                if not os.path.exists(prefix + "_histories.npy"):
+                    continue
+
+                grid.Merge(numpy.load(prefix + "_energy.npy"),
+                    numpy.load(prefix + "_energy2.npy"), numpy.load(prefix + "_counts.npy"),
+                    int(numpy.load(prefix + "_histories.npy")))
+
+        shutil.rmtree(scratch)
+
+        # This process never tracks a particle, its own shard is left empty.
+        for name in self.phasespaces:
+            self.detector_construction.SetPhasespaceShard(
+                self.get_phasespace_filename(name), processes)
+        self.close_phasespaces()
+        for name in self.phasespaces:
+            self.merge_phasespace(name)
+
+        return failed == 0
+
+    def run_worker(self, worker, workers, histories, first_event, scratch, fwhm, energy,
+            prefetch_depth, counter=None, chunk_time=1.):
+        """The part of `beam_on_parallel` run in worker process `worker`. With a `counter`
+        the worker takes chunks of all `histories` from it, otherwise it runs `histories`
+        events numbered from `first_event`.
+        """
+        if self.source is not None:
+            index, count = self.source_partition
+            self.source_partition = (index*workers + worker, count*workers)
+
+        self.set_up_source(fwhm, energy, prefetch_depth)
+
+        if self.source is not None and self.primary_generator.GetSourceRecordCount() < 0:
+            raise RuntimeError("Phasespace source has no record count, build an index for it.")
+
+        for name in self.phasespaces:
+            self.detector_construction.SetPhasespaceShard(
+                self.get_phasespace_filename(name), worker)
+
+        if histories is None:
+            histories = self.get_source_histories()
+
+        if counter is None:
+            self.shoot(histories, first_event)
+        else:
+            self.shoot_chunks(counter, histories, workers, chunk_time)
+        self.close_phasespaces()
+
+        for i, grid in enumerate(self.get_dose_grids()):
+            prefix = "%s/%i_%i" % (scratch, worker, i)
+            numpy.save(prefix + "_energy.npy", grid.GetEnergy())
+            numpy.save(prefix + "_energy2.npy", grid.GetEnergySq())
+            numpy.save(prefix + "_counts.npy", grid.GetCounts())
+            # Written last, the others are complete once it is there.
+            numpy.save(prefix + "_histories.npy", numpy.int64(grid.GetHistories()))
+
+    def shoot_chunks(self, counter, histories, workers, chunk_time):
+        """Run chunks of events taken from `counter`, shared by all `workers`, until all
+        `histories` have been handed out. Chunks are sized to take `chunk_time` seconds by
+        the cost of the events so far, and are never more than half of what is left shared
+        over the workers, so they shrink as the run ends. Events are seeded by number, which
+        worker runs them makes no difference. The dose is only summed once, after the last
+        chunk, rather than at the end of each chunk's run.
+        """
+        self.detector_construction.SetReduceEachRun(False)
+        try:
+            cost = None
+            while True:
+                with counter.get_lock():
+                    first_event = counter.value
+                    remaining = histories - first_event
+                    if remaining <= 0:
+                        break
+
+                    # One event to start with, to find out what they cost.
+                    chunk = 1
+                    if cost is not None:
+                        chunk = min(remaining/(2*workers), int(chunk_time/max(cost, 1e-9)))
+                    chunk = max(1, chunk)
+
+                    counter.value = first_event + chunk
+
+                start = time.time()
+                self.shoot(chunk, first_event)
+                elapsed = (time.time() - start)/chunk
+
+                cost = elapsed if cost is None else 0.75*cost + 0.25*elapsed
+        finally:
+            self.detector_construction.SetReduceEachRun(True)
+            self.detector_construction.ReduceHistograms()
+
+    def get_dose_grids(self):
+        """Every grid scored into, those of the phantom or CT followed by the scoring meshes.
+        """
+        grids = [self.detector_construction.GetDoseGrid(i)
+            for i in range(self.detector_construction.GetHistogramCount())]
+        grids += [self.detector_construction.GetScoringMesh(name).GetDoseGrid()
+            for name in self.meshes]
+        return grids
+
+    def replay_event(self, run, event, fwhm=2.0*mm, energy=6*MeV):
+        """Run event `event` of run `run` on its own, with the random numbers it had the first
+        time round, to look into a single slow or odd event. With a bare gun source the event
+        is the same, a phasespace source gives it the next record read instead of its own.
+        Runs are numbered from zero by every `beam_on`, `beam_on_until` and `beam_on_parallel`.
+        The dose grids and scoring meshes are put back as they were, so the replayed event
+        adds nothing to them, but particles reaching a phasespace are written to it as usual.
+        """
+        # Copies, the grids hand back their own memory where they can.
+        saved = [(grid, numpy.array(grid.GetEnergy()), numpy.array(grid.GetEnergySq()),
+            numpy.array(grid.GetCounts()), grid.GetHistories()) for grid in self.get_dose_grids()]
+
+        self.set_up_source(fwhm, energy, 0)
+        self.run = run
+        self.shoot(1, event)
+
+        for grid, energy_histogram, energysq_histogram, counts_histogram, histories in saved:
+            grid.Zero()
+            grid.Merge(energy_histogram, energysq_histogram, counts_histogram, histories)
+
+    def set_chunk_time(self, seconds):
+        """How long in seconds each chunk of events handed to a worker thread should take.
+        Shorter chunks even out the finishing times of the workers at the end of every run,
+        longer ones cost fewer trips to the shared event counter. Only with `threads` > 1,
+        raises RuntimeError otherwise.
+        """
+        if not g4.SetChunkTime(seconds):
+            raise RuntimeError("Chunks of events are only handed out to worker threads.")
+
+    def start_run(self):
+        """Take the next run number, which seeds the events of the run.
+        """
+        self.run = self.runs
+        self.runs += 1
+
+    def shoot(self, histories, first_event=0):
+        """Run `histories` events of the current run, numbered on from `first_event`.
+        """
+        self.primary_generator.SetEventSeeding(self.seed, self.run, first_event)
+        self.run_manager.BeamOn(int(histories))
+
+    def set_up_source(self, fwhm=2.0*mm, energy=6*MeV, prefetch_depth=65536):
+        """Point the primary generator at the phasespace source or the bare gun, ahead of
+        one or more runs.
         """
         self.update_geometry()
 
         if self.source is not None: 
+            self.primary_generator.SetMemoryMapped(self.source_mmap)
+            self.primary_generator.SetPrefetchDepth(prefetch_depth)
+            self.primary_generator.SetPartition(*self.source_partition)
+            self.primary_generator.SetRecordRange(*self.source_range)
             self.primary_generator.SetSource(self.get_phasespace_filename(self.source))
 
             z = self.config.phasespaces[self.source]["z_position"]
@@ -283,6 +852,7 @@ class Simulation(object):
             self.primary_generator.SetPhasespaceLimits(-200, 200, -200, 200, z-0.1, z+0.1) 
             self.primary_generator.SetRedistribute(self.config.phasespaces[self.source]["redistribute"])
             self.primary_generator.SetRecyclingNumber(self.config.gun["recycling_number"])       
+            self.primary_generator.SetBatchRecycling(self.config.gun.get("batch_recycling", False))
         else:
             self.primary_generator.SetSource(None)
 
@@ -291,6 +861,4 @@ class Simulation(object):
             self.primary_generator.SetPosition(G4ThreeVector(0., 0., 1050.))
             self.primary_generator.SetDirection(G4ThreeVector(0, 0, -1))
 
-        Geant4.gRunManager.BeamOn(int(histories))
-
 
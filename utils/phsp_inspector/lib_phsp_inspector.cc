@@ -21,9 +21,13 @@
 // Standard Template Library //
 #include <vector>
 #include <iostream>
+#include <algorithm>
 
 // linac //
 #include "PhasespaceRecord.hh"
+#include "PhasespaceReader.hh"
+#include "PhasespaceIndex.hh"
+#include "CompressedPhasespaceReader.hh"
 
 // boost::python //
 #include "boost/python.hpp"
@@ -33,9 +37,9 @@
 // PyUBLAS //
 #include "pyublas/numpy.hpp"
 
-// boost::serialization //
-#include "boost/archive/binary_iarchive.hpp"
-#include "boost/archive/binary_oarchive.hpp"
+// boost::thread //
+#include "boost/thread.hpp"
+#include "boost/bind.hpp"
 
 
 using namespace boost::python;
@@ -47,27 +51,92 @@ class PhasespaceInspector {
     };
 
     void Read(std::string filename) {
-        input_file_stream = new std::ifstream(filename.c_str(), std::ios::binary);
-        phasespace_archive = new boost::archive::binary_iarchive(*input_file_stream);
+        PhasespaceReader* reader = PhasespaceReader::Open(filename);
+        if (reader == NULL)
+            return;
+
+        // Compressed blocks decode independently, spread them over all cores.
+        CompressedPhasespaceReader* compressed_reader =
+            dynamic_cast<CompressedPhasespaceReader*>(reader);
+        if (compressed_reader) {
+            ReadBlocks(compressed_reader);
+            delete reader;
+            return;
+        }
+
+        // Fixed width and indexed files know their length up front.
+        int64_t record_count = reader->GetRecordCount();
+        if (record_count > 0)
+            Reserve(this->energy.size() + record_count);
+
+        if (reader->GetIndex())
+            reader->GetIndex()->Print();
+
+        PhasespaceRecord phasespace_record;
+
+        while(reader->Read(phasespace_record)) {
+            Append(phasespace_record);
+        }
+        std::cout << "Reached end of phasespace." << std::endl;
 
+        delete reader;
+    };
+
+    // Read only particles of one type, -1 for electrons, 0 for photons
+    // and 1 for positrons. With an index, blocks without any are skipped.
+    void ReadType(std::string filename, int particle_type) {
+        PhasespaceReader* reader = PhasespaceReader::Open(filename);
+        if (reader == NULL)
+            return;
+
+        PhasespaceIndex* index = reader->GetIndex();
         PhasespaceRecord phasespace_record;
 
-        while(1) {
-            phasespace_record = PhasespaceRecord();
-            try {
-                *phasespace_archive >> phasespace_record;
-                this->energy.push_back(phasespace_record.GetKineticEnergy());
-                this->weight.push_back(phasespace_record.GetWeight());
-                this->direction_x.push_back(phasespace_record.GetMomentum().x());
-                this->direction_y.push_back(phasespace_record.GetMomentum().y());
-                this->direction_z.push_back(phasespace_record.GetMomentum().z());
-                this->position.push_back(phasespace_record.GetPosition());
-                this->particle_type.push_back(phasespace_record.GetParticleType());
-            } catch (...) {
-                std::cout << "Reached end of archive. Aborting." << std::endl;
-                break;
-            }   
+        if (index == NULL) {
+            while(reader->Read(phasespace_record)) {
+                if (phasespace_record.GetParticleType() == particle_type)
+                    Append(phasespace_record);
+            }
+            delete reader;
+            return;
         }
+
+        Reserve(this->energy.size() + index->GetParticleCount(particle_type));
+
+        int skipped = 0;
+        for (int i=0; i<index->GetNumberOfBlocks(); i++) {
+            const PhasespaceIndexBlock& block = index->GetBlock(i);
+            if (block.particle_count[particle_type + 1] == 0) {
+                skipped++;
+                continue;
+            }
+
+            reader->Seek(block.first_record);
+            for (int64_t j=0; j<block.record_count; j++) {
+                if (!reader->Read(phasespace_record))
+                    break;
+                if (phasespace_record.GetParticleType() == particle_type)
+                    Append(phasespace_record);
+            }
+        }
+        std::cout << "Skipped " << skipped << " of " << index->GetNumberOfBlocks()
+                  << " blocks." << std::endl;
+
+        delete reader;
+    };
+
+    // Write a sidecar index for a phasespace that does not have one.
+    void BuildIndex(std::string filename) {
+        PhasespaceReader* reader = PhasespaceReader::Open(filename);
+        if (reader == NULL)
+            return;
+
+        PhasespaceIndex* index = PhasespaceIndex::Build(reader);
+        index->Save(filename);
+        index->Print();
+
+        delete index;
+        delete reader;
     };
 
     pyublas::numpy_vector<float> GetEnergy() {
@@ -91,6 +160,62 @@ class PhasespaceInspector {
     };
 
   private:
+    void ReadBlocks(CompressedPhasespaceReader* reader) {
+        int block_count = reader->GetNumberOfBlocks();
+        Reserve(this->energy.size() + reader->GetRecordCount());
+
+        // Only one block per core is held decoded at a time, each batch
+        // is appended in file order so the arrays match a sequential read.
+        int thread_count = std::max(1u, boost::thread::hardware_concurrency());
+        std::vector<std::vector<PackedPhasespaceRecord> > blocks(thread_count);
+
+        for (int first=0; first<block_count; first+=thread_count) {
+            int batch = std::min(thread_count, block_count - first);
+
+            boost::thread_group threads;
+            for (int i=0; i<batch; i++) {
+                threads.create_thread(boost::bind(&PhasespaceInspector::DecodeBlock,
+                            this, reader, first + i, &blocks[i]));
+            }
+            threads.join_all();
+
+            for (int i=0; i<batch; i++) {
+                for (unsigned int j=0; j<blocks[i].size(); j++)
+                    Append(reader->Unpack(blocks[i][j]));
+                blocks[i].clear();
+            }
+        }
+        std::cout << "Read " << block_count << " compressed blocks." << std::endl;
+    };
+
+    void DecodeBlock(CompressedPhasespaceReader* reader, int block,
+            std::vector<PackedPhasespaceRecord>* records) {
+        if (!reader->ReadBlock(block, *records)) {
+            records->clear();
+            std::cout << "Could not decode block " << block << std::endl;
+        }
+    };
+
+    void Append(PhasespaceRecord phasespace_record) {
+        this->energy.push_back(phasespace_record.GetKineticEnergy());
+        this->weight.push_back(phasespace_record.GetWeight());
+        this->direction_x.push_back(phasespace_record.GetMomentum().x());
+        this->direction_y.push_back(phasespace_record.GetMomentum().y());
+        this->direction_z.push_back(phasespace_record.GetMomentum().z());
+        this->position.push_back(phasespace_record.GetPosition());
+        this->particle_type.push_back(phasespace_record.GetParticleType());
+    };
+
+    void Reserve(size_t size) {
+        this->energy.reserve(size);
+        this->weight.reserve(size);
+        this->direction_x.reserve(size);
+        this->direction_y.reserve(size);
+        this->direction_z.reserve(size);
+        this->position.reserve(size);
+        this->particle_type.reserve(size);
+    };
+
     template <typename T>
     pyublas::numpy_vector<T> Get(std::vector<T> target) {
         pyublas::numpy_vector<T> return_target(target.size());
@@ -99,9 +224,6 @@ class PhasespaceInspector {
     };
   
   private: 
-    std::ifstream* input_file_stream;
-    boost::archive::binary_iarchive* phasespace_archive;
-       
     std::vector<float> energy;
     std::vector<float> weight;
     std::vector<float> direction_x;
@@ -115,6 +237,8 @@ class PhasespaceInspector {
 BOOST_PYTHON_MODULE(libphsp_inspector) {
     class_<PhasespaceInspector, PhasespaceInspector*>("PhasespaceInspector")
         .def("Read", &PhasespaceInspector::Read)
+        .def("ReadType", &PhasespaceInspector::ReadType)
+        .def("BuildIndex", &PhasespaceInspector::BuildIndex)
         .add_property("energy", &PhasespaceInspector::GetEnergy)
         .add_property("weight", &PhasespaceInspector::GetWeight)
         .add_property("direction_x", &PhasespaceInspector::GetDirectionX)